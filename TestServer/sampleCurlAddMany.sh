@@ -0,0 +1 @@
+curl --data "{ \"jsonrpc\": \"2.0\", \"method\": \"addMany\", \"params\": [[ {\"name\": \"Jean\", \"lat\": 33.42, \"lon\": -111.93, \"ele\": 1180, \"address\": \"Tempe, AZ\"}, {\"name\": \"Torres\", \"lat\": 33.31, \"lon\": -111.67, \"ele\": 1360, \"address\": \"Mesa, AZ\"} ]], \"id\": 4}" localhost:8080
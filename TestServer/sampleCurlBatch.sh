@@ -0,0 +1 @@
+curl --data "[ { \"jsonrpc\": \"2.0\", \"method\": \"getNames\", \"params\": [ ], \"id\": 1}, { \"jsonrpc\": \"2.0\", \"method\": \"get\", \"params\": [ \"Jean\" ], \"id\": 2} ]" localhost:8080
\ No newline at end of file
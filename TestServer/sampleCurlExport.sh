@@ -0,0 +1,3 @@
+# streams every waypoint from the epoll connector, one json object per
+# line, in the form sampleCurlImport.sh sends back.
+curl -s localhost:8080/export > ${1:-waypoints.ndjson}
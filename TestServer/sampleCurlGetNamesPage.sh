@@ -0,0 +1,3 @@
+# the first page of 100 names; pass the "next" cursor it returns to get the
+# page after it, until next is null.
+curl --data "{ \"jsonrpc\": \"2.0\", \"method\": \"getNamesPage\", \"params\": [\"${1:-}\", 100], \"id\": 5}" localhost:8080
@@ -0,0 +1,3 @@
+# streams a file of waypoints, one json object per line or a json array,
+# to the epoll connector; usage: sh sampleCurlImport.sh waypoints.ndjson
+curl --data-binary @${1:-waypoints.ndjson} -H "Content-Type: application/x-ndjson" -H "Transfer-Encoding: chunked" localhost:8080/import
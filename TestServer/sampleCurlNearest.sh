@@ -0,0 +1 @@
+curl --data "{ \"jsonrpc\": \"2.0\", \"method\": \"nearest\", \"params\": [\"ASU-Poly\", 3], \"id\": 3}" localhost:8080
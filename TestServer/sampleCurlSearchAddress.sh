@@ -0,0 +1,2 @@
+curl --data "{ \"jsonrpc\": \"2.0\", \"method\": \"searchAddress\", \"params\": [\"${1:-Tempe}\", 10], \"id\": 7}" localhost:8080
+curl --data "{ \"jsonrpc\": \"2.0\", \"method\": \"searchAddressWithin\", \"params\": [\"${1:-Tempe}\", 33.4, -111.9, 50.0, 0, 10], \"id\": 8}" localhost:8080
@@ -0,0 +1 @@
+curl --data "{ \"jsonrpc\": \"2.0\", \"method\": \"searchNames\", \"params\": [\"${1:-Jea}\", 10], \"id\": 6}" localhost:8080
@@ -0,0 +1 @@
+curl --data "{ \"jsonrpc\": \"2.0\", \"method\": \"withinRadius\", \"params\": [33.4, -111.9, 50.0, 0], \"id\": 3}" localhost:8080
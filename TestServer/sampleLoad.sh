@@ -0,0 +1 @@
+./bin/waypointLoad http://localhost:8080 --threads=8 --seconds=10 --waypoints=1000 --mix=get:80,getNames:2,addNew:10,distanceAndBearing:8
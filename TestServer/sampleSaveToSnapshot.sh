@@ -0,0 +1 @@
+curl --data "{ \"jsonrpc\": \"2.0\", \"method\": \"saveToSnapshot\", \"params\": [ ], \"id\": 3}" localhost:8080
\ No newline at end of file
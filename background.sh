@@ -28,7 +28,9 @@ case $CMMD in
         if [ -f $PID_PATH_NAME ]; then
             PID=$(cat $PID_PATH_NAME);
             echo "$Stopping process with PID $PID ..."
-            kill -9 $PID;
+            kill $PID;
+            # give the server time to finish its requests and shut down
+            while kill -0 $PID 2> /dev/null; do sleep 1; done
             echo "Stopped ..."
             rm $PID_PATH_NAME
         else
@@ -39,7 +41,8 @@ case $CMMD in
         if [ -f $PID_PATH_NAME ]; then
             PID=$(cat $PID_PATH_NAME);
             echo "$Stopping process with PID $PID ...";
-            kill -9 $PID;
+            kill $PID;
+            while kill -0 $PID 2> /dev/null; do sleep 1; done
             echo "$Stopped ...";
             rm $PID_PATH_NAME
             if [ -f $START_COMMAND_FILE ]; then
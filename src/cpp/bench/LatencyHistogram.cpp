@@ -0,0 +1,128 @@
+#include "LatencyHistogram.hpp"
+
+#include <cmath>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Log-linear latency histogram.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+// values below 2^SUB_BITS get a bucket each; above, every power of two
+// range is split into HALF buckets.
+static const uint64_t HALF = 1ULL << (LatencyHistogram::SUB_BITS - 1);
+
+LatencyHistogram::LatencyHistogram()
+    : counts(indexOf(HIGHEST) + 1, 0), total(0), lowest(UINT64_MAX),
+      highest(0), sum(0){
+}
+
+/**
+* The values below 2 * HALF are their own index. Above, a value whose top
+* bit is bit b keeps its top SUB_BITS bits and drops the rest, the
+* shift = b - SUB_BITS + 1 lowest, landing in [shift * HALF + HALF,
+* shift * HALF + 2 * HALF).
+*/
+size_t LatencyHistogram::indexOf(uint64_t value){
+    if(value < 2 * HALF){
+        return value;
+    }
+    int shift = 63 - __builtin_clzll(value) - (SUB_BITS - 1);
+    return shift * HALF + (value >> shift);
+}
+
+uint64_t LatencyHistogram::highestIn(size_t index){
+    if(index < 2 * HALF){
+        return index;
+    }
+    int shift = index / HALF - 1;
+    uint64_t top = index - shift * HALF;
+    return (top << shift) + ((1ULL << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t value){
+    if(value > HIGHEST){
+        value = HIGHEST;
+    }
+    counts[indexOf(value)]++;
+    total++;
+    sum += value;
+    if(value < lowest){
+        lowest = value;
+    }
+    if(value > highest){
+        highest = value;
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other){
+    for(size_t i = 0; i < counts.size(); i++){
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    if(other.lowest < lowest){
+        lowest = other.lowest;
+    }
+    if(other.highest > highest){
+        highest = other.highest;
+    }
+}
+
+void LatencyHistogram::reset(){
+    counts.assign(counts.size(), 0);
+    total = 0;
+    lowest = UINT64_MAX;
+    highest = 0;
+    sum = 0;
+}
+
+uint64_t LatencyHistogram::min() const{
+    return total == 0 ? 0 : lowest;
+}
+
+uint64_t LatencyHistogram::max() const{
+    return highest;
+}
+
+double LatencyHistogram::mean() const{
+    return total == 0 ? 0 : sum / total;
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const{
+    if(total == 0){
+        return 0;
+    }
+    // the rank of the value asked for, at least the first one.
+    uint64_t rank = (uint64_t)std::ceil(percent / 100.0 * total);
+    if(rank < 1){
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for(size_t i = 0; i < counts.size(); i++){
+        seen += counts[i];
+        if(seen >= rank){
+            // never past what was really recorded.
+            uint64_t value = highestIn(i);
+            return value < highest ? value : highest;
+        }
+    }
+    return highest;
+}
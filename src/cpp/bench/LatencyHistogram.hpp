@@ -0,0 +1,101 @@
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Counts latencies in nanoseconds the way HdrHistogram does:
+ * every power of two range is split into the same number of linear
+ * buckets, so any value is kept to within 0.1% from a nanosecond up to
+ * about 18 minutes, in a fixed 256KB, and recording is one increment.
+ * Histograms of several threads are merged before reading percentiles.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class LatencyHistogram {
+
+    public:
+
+    /**
+    * Values from 2^SUB_BITS up are kept to SUB_BITS - 1 significant bits.
+    */
+    static const int SUB_BITS = 11;
+
+    /**
+    * Larger values are counted as this one.
+    */
+    static const uint64_t HIGHEST = (1ULL << 40) - 1;
+
+    LatencyHistogram();
+
+    /**
+    * @param A latency in nanoseconds.
+    */
+    void record(uint64_t value);
+
+    /**
+    * Adds the counts of another histogram to this one.
+    *
+    * @param The histogram to add.
+    */
+    void merge(const LatencyHistogram& other);
+
+    /**
+    * Drops every count.
+    */
+    void reset();
+
+    /**
+    * @return How many values were recorded.
+    */
+    uint64_t count() const { return total; }
+
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+
+    /**
+    * @param  A percentile, from 0 to 100.
+    * @return The smallest value that many percent of the recorded values
+    *         are at or below, rounded up to the end of its bucket; 0 when
+    *         nothing was recorded.
+    */
+    uint64_t percentile(double percent) const;
+
+    private:
+
+    vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t lowest;
+    uint64_t highest;
+    double sum;
+
+    static size_t indexOf(uint64_t value);
+
+    /**
+    * @return The largest value counted in the bucket at index.
+    */
+    static uint64_t highestIn(size_t index);
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "WaypointData.hpp"
+#include "../server/WaypointLibrary.hpp"
+#include "../server/Logger.hpp"
+
+#include <benchmark/benchmark.h>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Micro-benchmarks of the hot functions of Waypoint and
+ * WaypointLibrary, run in process on synthetic data (see WaypointData).
+ * The library benchmarks run at 1K, 100K and 1M waypoints. Built with
+ * ant build.bench, and run as
+ *
+ *     ./bin/waypointBench
+ *     ./bin/waypointBench --benchmark_filter=Library
+ *     ./bin/waypointBench --benchmark_format=json > before.json
+ *
+ * json output from two builds can be compared with the compare.py tool
+ * that comes with Google Benchmark. The files the load benchmarks read
+ * are written to a temporary directory, removed at exit.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+static const int SMALL = 1000;
+static const int MEDIUM = 100000;
+static const int LARGE = 1000000;
+
+/**
+* Libraries are costly to fill, so each size is built once and shared by
+* the benchmarks that leave it as they found it.
+*/
+static WaypointLibrary& libraryOf(size_t size){
+    static map<size_t, unique_ptr<WaypointLibrary> > libraries;
+    unique_ptr<WaypointLibrary>& library = libraries[size];
+    if(!library){
+        library.reset(new WaypointLibrary(WaypointData::generate(size)));
+    }
+    return *library;
+}
+
+static const vector<Waypoint>& waypointsOf(size_t size){
+    static map<size_t, vector<Waypoint> > waypoints;
+    vector<Waypoint>& found = waypoints[size];
+    if(found.empty()){
+        found = WaypointData::generate(size);
+    }
+    return found;
+}
+
+static string directory;
+
+/**
+* Writes the json file of a size once, in a temporary directory.
+*
+* @return The path of the file.
+*/
+static string jsonFileOf(size_t size, size_t& bytes){
+    static map<size_t, pair<string, size_t> > files;
+    pair<string, size_t>& found = files[size];
+    if(found.first.empty()){
+        if(directory.empty()){
+            char pattern[] = "/tmp/waypointBench.XXXXXX";
+            directory = mkdtemp(pattern) ? pattern : ".";
+        }
+        found.first = directory + "/waypoints-" + to_string(size) + ".json";
+        found.second = WaypointData::writeJsonFile(found.first,
+                                                   waypointsOf(size));
+    }
+    bytes = found.second;
+    return found.first;
+}
+
+/**
+* Walks the indexes of a collection in a scattered order, cheaper than a
+* random number generator and the same on every run.
+*/
+struct Scatter {
+    size_t size;
+    size_t at;
+    explicit Scatter(size_t size) : size(size), at(0) {}
+    size_t next(){
+        // odd and not a multiple of 5, so prime to the sizes used here,
+        // and so it visits every index before coming back.
+        at = (at + 2654435761ULL) % size;
+        return at;
+    }
+};
+
+/*
+* Waypoint
+*/
+
+static void BM_DistanceGCTo(benchmark::State& state){
+    const vector<Waypoint>& waypoints = waypointsOf(SMALL);
+    Scatter scatter(waypoints.size());
+    Waypoint from = waypoints[0];
+    for(auto _ : state){
+        benchmark::DoNotOptimize(
+            from.distanceGCTo(waypoints[scatter.next()], Waypoint::STATUTE));
+    }
+}
+BENCHMARK(BM_DistanceGCTo);
+
+static void BM_BearingGCInitTo(benchmark::State& state){
+    const vector<Waypoint>& waypoints = waypointsOf(SMALL);
+    Scatter scatter(waypoints.size());
+    Waypoint from = waypoints[0];
+    for(auto _ : state){
+        benchmark::DoNotOptimize(
+            from.bearingGCInitTo(waypoints[scatter.next()], Waypoint::STATUTE));
+    }
+}
+BENCHMARK(BM_BearingGCInitTo);
+
+static void BM_WaypointFromJson(benchmark::State& state){
+    const vector<Waypoint>& waypoints = waypointsOf(SMALL);
+    vector<Json::Value> objects;
+    for(size_t i = 0; i < waypoints.size(); i++){
+        objects.push_back(Waypoint(waypoints[i]).toJSONObject());
+    }
+    Scatter scatter(objects.size());
+    for(auto _ : state){
+        Waypoint made(objects[scatter.next()]);
+        benchmark::DoNotOptimize(made.lat);
+    }
+}
+BENCHMARK(BM_WaypointFromJson);
+
+static void BM_ToJSONObject(benchmark::State& state){
+    vector<Waypoint> waypoints = waypointsOf(SMALL);
+    Scatter scatter(waypoints.size());
+    for(auto _ : state){
+        Json::Value object = waypoints[scatter.next()].toJSONObject();
+        benchmark::DoNotOptimize(object);
+    }
+}
+BENCHMARK(BM_ToJSONObject);
+
+/*
+* WaypointLibrary, the argument is the number of waypoints.
+*/
+
+static void BM_LibraryGet(benchmark::State& state){
+    WaypointLibrary& library = libraryOf(state.range(0));
+    const vector<Waypoint>& waypoints = waypointsOf(state.range(0));
+    Scatter scatter(waypoints.size());
+    for(auto _ : state){
+        Json::Value found = library.get(waypoints[scatter.next()].name);
+        benchmark::DoNotOptimize(found);
+    }
+}
+BENCHMARK(BM_LibraryGet)->Arg(SMALL)->Arg(MEDIUM)->Arg(LARGE);
+
+/**
+* Times only the removal; every removed waypoint is put back untimed so
+* the library keeps its size.
+*/
+static void BM_LibraryRemove(benchmark::State& state){
+    WaypointLibrary& library = libraryOf(state.range(0));
+    const vector<Waypoint>& waypoints = waypointsOf(state.range(0));
+    Scatter scatter(waypoints.size());
+    for(auto _ : state){
+        const Waypoint& removed = waypoints[scatter.next()];
+        auto start = chrono::steady_clock::now();
+        bool done = library.remove(removed.name);
+        auto end = chrono::steady_clock::now();
+        state.SetIterationTime(chrono::duration<double>(end - start).count());
+        benchmark::DoNotOptimize(done);
+        library.add(Waypoint(removed).toJSONObject());
+    }
+}
+BENCHMARK(BM_LibraryRemove)->Arg(SMALL)->Arg(MEDIUM)->Arg(LARGE)
+    ->UseManualTime();
+
+static void BM_LibraryGetNames(benchmark::State& state){
+    WaypointLibrary& library = libraryOf(state.range(0));
+    for(auto _ : state){
+        Json::Value names = library.getNames();
+        benchmark::DoNotOptimize(names);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LibraryGetNames)->Arg(SMALL)->Arg(MEDIUM)->Arg(LARGE)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_LibraryLoadJson(benchmark::State& state){
+    size_t bytes = 0;
+    string path = jsonFileOf(state.range(0), bytes);
+    WaypointLibrary library(path);
+    for(auto _ : state){
+        if(!library.resetFromJsonFile()){
+            state.SkipWithError("could not load the json file");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LibraryLoadJson)->Arg(SMALL)->Arg(MEDIUM)->Arg(LARGE)
+    ->Unit(benchmark::kMillisecond);
+
+int main(int argc, char * argv[]) {
+    // the library logs every load at info.
+    Logger::instance().configure(Logger::WARN, 1);
+    Logger::instance().start();
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv)){
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    if(!directory.empty() && directory != "."){
+        for(int size : {SMALL, MEDIUM, LARGE}){
+            unlink((directory + "/waypoints-" + to_string(size) +
+                    ".json").c_str());
+        }
+        rmdir(directory.c_str());
+    }
+    Logger::instance().stop();
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "WaypointData.hpp"
+
+#include <cstdio>
+#include <cmath>
+#include <random>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Synthetic waypoints for the benchmarks.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+static const char* STREETS[] = {
+    "Main St", "University Dr", "Apache Blvd", "Mill Ave", "Baseline Rd",
+    "Avenida de la Constitución", "Rue de l'Église", "Power Rd",
+    "Camino del Río", "Williams Field Rd"
+};
+
+static const char* CITIES[] = {
+    "Mesa AZ", "Tempe AZ", "Phoenix AZ", "Salt Lake City UT", "Anchorage AK",
+    "Paris France", "Sevilla España", "Montréal QC", "Flagstaff AZ",
+    "Santa Fe NM"
+};
+
+vector<Waypoint> WaypointData::generate(size_t count, unsigned seed){
+    mt19937_64 random(seed);
+    // uniform in sin(lat) so the points are spread evenly over the sphere.
+    uniform_real_distribution<double> sinLat(-1, 1);
+    uniform_real_distribution<double> lon(-180, 180);
+    uniform_real_distribution<double> ele(-50, 4500);
+    uniform_int_distribution<unsigned> number(1, 99999);
+    uniform_int_distribution<unsigned> street(0, 9);
+    vector<Waypoint> waypoints;
+    waypoints.reserve(count);
+    for(size_t i = 0; i < count; i++){
+        char name[32];
+        snprintf(name, sizeof(name), "Waypoint-%07zu", i);
+        char address[128];
+        snprintf(address, sizeof(address), "%u %s, %s", number(random),
+                 STREETS[street(random)], CITIES[street(random)]);
+        double lat = std::asin(sinLat(random)) * 180.0 / 3.14159265358979323846;
+        waypoints.push_back(Waypoint(lat, lon(random), std::floor(ele(random)),
+                                     name, address));
+    }
+    return waypoints;
+}
+
+size_t WaypointData::writeJsonFile(const string& path,
+                                   const vector<Waypoint>& waypoints){
+    FILE* file = fopen(path.c_str(), "w");
+    if(file == NULL){
+        return 0;
+    }
+    // the generated names and addresses need no escaping.
+    fputs("{\n", file);
+    for(size_t i = 0; i < waypoints.size(); i++){
+        const Waypoint& w = waypoints[i];
+        fprintf(file, "   \"%s\" : {\n"
+                      "      \"address\" : \"%s\",\n"
+                      "      \"ele\" : %.17g,\n"
+                      "      \"lat\" : %.17g,\n"
+                      "      \"lon\" : %.17g,\n"
+                      "      \"name\" : \"%s\"\n"
+                      "   }%s\n",
+                w.name.c_str(), w.address.c_str(), w.ele, w.lat, w.lon,
+                w.name.c_str(), i + 1 < waypoints.size() ? "," : "");
+    }
+    fputs("}\n", file);
+    long size = ftell(file);
+    if(fclose(file) != 0 || size < 0){
+        return 0;
+    }
+    return size;
+}
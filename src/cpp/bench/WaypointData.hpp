@@ -0,0 +1,60 @@
+#ifndef WAYPOINTDATA_HPP
+#define WAYPOINTDATA_HPP
+
+#include <string>
+#include <vector>
+
+#include "../server/Waypoint.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Synthetic waypoints for the benchmarks, any number of them and
+ * always the same ones for the same seed. Names are unique, positions
+ * spread over the whole globe, and addresses are street addresses of
+ * varying length, some with accented letters so the escaping paths of
+ * the json writers get their share.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WaypointData {
+
+    public:
+
+    /**
+    * @param  How many waypoints to make.
+    * @param  Seeds the positions and addresses.
+    * @return The waypoints, named Waypoint-0000000 and up.
+    */
+    static vector<Waypoint> generate(size_t count, unsigned seed = 1);
+
+    /**
+    * Writes waypoints as a library json file, in the layout saveToJsonFile
+    * writes and resetFromJsonFile reads.
+    *
+    * @param  The path of the file.
+    * @param  The waypoints to write.
+    * @return The size of the file in bytes, 0 if it could not be written.
+    */
+    static size_t writeJsonFile(const string& path,
+                                const vector<Waypoint>& waypoints);
+};
+
+#endif
@@ -0,0 +1,429 @@
+#include "LatencyHistogram.hpp"
+#include "../client/FramedSocketClient.hpp"
+
+#include <jsonrpccpp/client/connectors/httpclient.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Load generator for a running waypointRPCServer. Each thread
+ * has a connection of its own and calls a random mix of get, getNames,
+ * addNew and distanceAndBearing on it, one call at a time, over the same
+ * connectors the clients use: http urls through json-rpc-cpp, tcp:// and
+ * unix: through FramedSocketClient.
+ *
+ * Closed loop (the default) sends the next call as soon as the reply to
+ * the last one is in, and measures how much the server can take. Open
+ * loop (--rate) sends calls on a fixed schedule and measures each one
+ * from the time it was due rather than the time it went out, so a server
+ * that stalls is charged for every call that had to wait behind the
+ * stall, not just the one that hit it.
+ *
+ * Before the run the library is filled with --waypoints synthetic
+ * waypoints named load-N, which the calls then use; addNew updates them
+ * with new positions so the library keeps its size. They are removed
+ * again at the end unless --keep is given.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+enum Method { GET, GET_NAMES, ADD_NEW, DISTANCE_AND_BEARING, METHODS };
+
+static const char* METHOD_NAMES[METHODS] = {
+    "get", "getNames", "addNew", "distanceAndBearing"
+};
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+    string url;
+    FramedSocketClient::Framing framing;
+    unsigned threads;
+    double seconds;
+    double warmup;
+    double rate;
+    unsigned waypoints;
+    unsigned weights[METHODS];
+    bool keep;
+    unsigned seed;
+};
+
+/**
+* What one thread measured.
+*/
+struct Measured {
+    LatencyHistogram latency[METHODS];
+    uint64_t errors[METHODS];
+
+    Measured(){
+        for(int m = 0; m < METHODS; m++){
+            errors[m] = 0;
+        }
+    }
+};
+
+static jsonrpc::IClientConnector* connect(const Options& options){
+    if(FramedSocketClient::handles(options.url)){
+        return new FramedSocketClient(options.url, options.framing);
+    }
+    return new jsonrpc::HttpClient(options.url);
+}
+
+static string waypointName(unsigned i){
+    char name[32];
+    snprintf(name, sizeof(name), "load-%06u", i);
+    return name;
+}
+
+/**
+* Writes the request for a call, with random waypoints from the pool.
+* The names and numbers written need no json escaping.
+*/
+static void writeRequest(Method method, uint64_t id, unsigned waypoints,
+                         mt19937_64& random, string& request){
+    uniform_int_distribution<unsigned> pick(0, waypoints - 1);
+    char text[256];
+    switch(method){
+        case GET:
+            snprintf(text, sizeof(text),
+                     "{\"jsonrpc\":\"2.0\",\"id\":%llu,\"method\":\"get\","
+                     "\"params\":[\"%s\"]}", (unsigned long long)id,
+                     waypointName(pick(random)).c_str());
+            break;
+        case GET_NAMES:
+            snprintf(text, sizeof(text),
+                     "{\"jsonrpc\":\"2.0\",\"id\":%llu,\"method\":\"getNames\","
+                     "\"params\":[]}", (unsigned long long)id);
+            break;
+        case ADD_NEW: {
+            uniform_real_distribution<double> lat(-80, 80);
+            uniform_real_distribution<double> lon(-180, 180);
+            uniform_real_distribution<double> ele(0, 4000);
+            unsigned i = pick(random);
+            snprintf(text, sizeof(text),
+                     "{\"jsonrpc\":\"2.0\",\"id\":%llu,\"method\":\"addNew\","
+                     "\"params\":[\"%.6f\",\"%.6f\",\"%.1f\",\"%s\","
+                     "\"%u Load Test Rd\"]}", (unsigned long long)id,
+                     lat(random), lon(random), ele(random),
+                     waypointName(i).c_str(), i);
+            break;
+        }
+        default:
+            snprintf(text, sizeof(text),
+                     "{\"jsonrpc\":\"2.0\",\"id\":%llu,"
+                     "\"method\":\"distanceAndBearing\","
+                     "\"params\":[\"%s\",\"%s\"]}", (unsigned long long)id,
+                     waypointName(pick(random)).c_str(),
+                     waypointName(pick(random)).c_str());
+    }
+    request = text;
+}
+
+/**
+* Sends a request, false if it failed or was answered with an error.
+*/
+static bool call(jsonrpc::IClientConnector& connector, const string& request,
+                 string& reply){
+    try{
+        reply.clear();
+        connector.SendRPCMessage(request, reply);
+    }catch(jsonrpc::JsonRpcException& e){
+        return false;
+    }
+    // the server writes its keys sorted, so an error comes first.
+    return !reply.empty() && reply.compare(0, 9, "{\"error\":") != 0;
+}
+
+/**
+* Adds (or with remove, removes) the synthetic waypoints, split over the
+* threads.
+*
+* @return False if any call failed.
+*/
+static bool fillLibrary(const Options& options, bool remove){
+    atomic<bool> ok(true);
+    vector<thread> threads;
+    for(unsigned t = 0; t < options.threads; t++){
+        threads.push_back(thread([&options, &ok, remove, t](){
+            unique_ptr<jsonrpc::IClientConnector> connector(connect(options));
+            mt19937_64 random(options.seed + t);
+            uniform_real_distribution<double> lat(-80, 80);
+            uniform_real_distribution<double> lon(-180, 180);
+            string request;
+            string reply;
+            for(unsigned i = t; i < options.waypoints && ok;
+                i += options.threads){
+                char text[256];
+                if(remove){
+                    snprintf(text, sizeof(text),
+                             "{\"jsonrpc\":\"2.0\",\"id\":%u,"
+                             "\"method\":\"remove\",\"params\":[\"%s\"]}",
+                             i, waypointName(i).c_str());
+                }else{
+                    snprintf(text, sizeof(text),
+                             "{\"jsonrpc\":\"2.0\",\"id\":%u,"
+                             "\"method\":\"addNew\",\"params\":[\"%.6f\","
+                             "\"%.6f\",\"0\",\"%s\",\"%u Load Test Rd\"]}",
+                             i, lat(random), lon(random),
+                             waypointName(i).c_str(), i);
+                }
+                request = text;
+                if(!call(*connector, request, reply)){
+                    ok = false;
+                }
+            }
+        }));
+    }
+    for(size_t t = 0; t < threads.size(); t++){
+        threads[t].join();
+    }
+    return ok;
+}
+
+/**
+* Body of one load thread: calls until the end of the run, recording the
+* calls due after the warmup.
+*/
+static void load(const Options& options, unsigned t, Clock::time_point start,
+                 Measured& measured){
+    unique_ptr<jsonrpc::IClientConnector> connector(connect(options));
+    mt19937_64 random(options.seed * 7919 + t);
+    unsigned totalWeight = 0;
+    for(int m = 0; m < METHODS; m++){
+        totalWeight += options.weights[m];
+    }
+    uniform_int_distribution<unsigned> pickWeight(0, totalWeight - 1);
+    Clock::time_point measureFrom = start + chrono::duration_cast<Clock::duration>(
+        chrono::duration<double>(options.warmup));
+    Clock::time_point end = measureFrom + chrono::duration_cast<Clock::duration>(
+        chrono::duration<double>(options.seconds));
+    // each thread takes an equal share of the rate, its calls evenly spaced
+    // and staggered against the other threads.
+    Clock::duration interval = Clock::duration::zero();
+    Clock::time_point due = start;
+    if(options.rate > 0){
+        interval = chrono::duration_cast<Clock::duration>(
+            chrono::duration<double>(options.threads / options.rate));
+        due += interval * t / options.threads;
+    }
+    string request;
+    string reply;
+    uint64_t id = 0;
+    while(true){
+        Clock::time_point now = Clock::now();
+        if(options.rate > 0){
+            if(due >= end){
+                break;
+            }
+            if(due > now){
+                this_thread::sleep_until(due);
+            }
+        }else{
+            if(now >= end){
+                break;
+            }
+            due = now;
+        }
+        unsigned weight = pickWeight(random);
+        int method = 0;
+        while(weight >= options.weights[method]){
+            weight -= options.weights[method];
+            method++;
+        }
+        writeRequest((Method)method, ++id, options.waypoints, random, request);
+        bool ok = call(*connector, request, reply);
+        Clock::time_point done = Clock::now();
+        if(due >= measureFrom){
+            if(ok){
+                measured.latency[method].record(
+                    chrono::duration_cast<chrono::nanoseconds>(done - due).count());
+            }else{
+                measured.errors[method]++;
+            }
+        }
+        due += interval;
+    }
+}
+
+/**
+* Prints one line of the report, latencies in microseconds.
+*/
+static void report(const string& name, const LatencyHistogram& latency,
+                   uint64_t errors, double seconds){
+    cout << left << setw(20) << name << right << setw(10) << latency.count()
+         << setw(8) << errors << fixed << setprecision(1)
+         << setw(11) << latency.count() / seconds
+         << setw(10) << latency.mean() / 1000.0;
+    const double PERCENTILES[] = {50, 90, 99, 99.9};
+    for(int p = 0; p < 4; p++){
+        cout << setw(10) << latency.percentile(PERCENTILES[p]) / 1000.0;
+    }
+    cout << setw(11) << latency.max() / 1000.0 << endl;
+}
+
+/**
+* Reads a mix such as get:80,addNew:10 into weights; methods left out
+* get no calls.
+*/
+static bool parseMix(const string& mix, unsigned* weights){
+    for(int m = 0; m < METHODS; m++){
+        weights[m] = 0;
+    }
+    stringstream entries(mix);
+    string entry;
+    while(getline(entries, entry, ',')){
+        size_t colon = entry.find(':');
+        string name = entry.substr(0, colon);
+        int m = 0;
+        while(m < METHODS && name != METHOD_NAMES[m]){
+            m++;
+        }
+        if(m == METHODS || colon == string::npos){
+            return false;
+        }
+        weights[m] = atoi(entry.substr(colon + 1).c_str());
+    }
+    return weights[GET] + weights[GET_NAMES] + weights[ADD_NEW] +
+           weights[DISTANCE_AND_BEARING] > 0;
+}
+
+int main(int argc, char * argv[]) {
+    // invoke with ./bin/waypointLoad [url] [--threads=N] [--seconds=S]
+    //            [--warmup=S] [--rate=R] [--waypoints=N]
+    //            [--mix=get:80,getNames:2,addNew:10,distanceAndBearing:8]
+    //            [--framing=length|line] [--keep] [--seed=N]
+    // The url is http://host:port, tcp://host:port or unix:path, as for the
+    // client; --framing must match the server's for tcp and unix. --rate
+    // is the total calls per second over all threads, 0 for closed loop.
+    Options options;
+    options.url = "http://127.0.0.1:8080";
+    options.framing = FramedSocketClient::LENGTH_PREFIXED;
+    options.threads = 8;
+    options.seconds = 10;
+    options.warmup = 2;
+    options.rate = 0;
+    options.waypoints = 1000;
+    options.keep = false;
+    options.seed = 1;
+    parseMix("get:80,getNames:2,addNew:10,distanceAndBearing:8",
+             options.weights);
+    for(int i = 1; i < argc; i++){
+        string arg(argv[i]);
+        if(arg.compare(0, 10, "--threads=") == 0){
+            options.threads = atoi(arg.substr(10).c_str());
+        }else if(arg.compare(0, 10, "--seconds=") == 0){
+            options.seconds = atof(arg.substr(10).c_str());
+        }else if(arg.compare(0, 9, "--warmup=") == 0){
+            options.warmup = atof(arg.substr(9).c_str());
+        }else if(arg.compare(0, 7, "--rate=") == 0){
+            options.rate = atof(arg.substr(7).c_str());
+        }else if(arg.compare(0, 12, "--waypoints=") == 0){
+            options.waypoints = atoi(arg.substr(12).c_str());
+        }else if(arg.compare(0, 6, "--mix=") == 0){
+            if(!parseMix(arg.substr(6), options.weights)){
+                cout << "Bad mix " << arg.substr(6) << endl;
+                return 1;
+            }
+        }else if(arg.compare(0, 10, "--framing=") == 0){
+            string framing = arg.substr(10);
+            if(framing == "length"){
+                options.framing = FramedSocketClient::LENGTH_PREFIXED;
+            }else if(framing == "line"){
+                options.framing = FramedSocketClient::NEWLINE;
+            }else{
+                cout << "Unknown framing " << framing << endl;
+                return 1;
+            }
+        }else if(arg == "--keep"){
+            options.keep = true;
+        }else if(arg.compare(0, 7, "--seed=") == 0){
+            options.seed = atoi(arg.substr(7).c_str());
+        }else{
+            options.url = arg;
+        }
+    }
+    if(options.threads == 0 || options.waypoints == 0 || options.seconds <= 0){
+        cout << "--threads, --waypoints and --seconds must be above 0" << endl;
+        return 1;
+    }
+
+    cout << "Adding " << options.waypoints << " waypoints to " << options.url
+         << endl;
+    if(!fillLibrary(options, false)){
+        cout << "Could not add the waypoints to " << options.url << endl;
+        return 1;
+    }
+    cout << options.threads << " threads, "
+         << (options.rate > 0 ? "open loop at " + to_string((long)options.rate)
+                                + " calls/s"
+                              : string("closed loop"))
+         << ", " << options.warmup << "s warmup, " << options.seconds
+         << "s measured" << endl;
+
+    vector<Measured> measured(options.threads);
+    vector<thread> threads;
+    Clock::time_point start = Clock::now();
+    for(unsigned t = 0; t < options.threads; t++){
+        threads.push_back(thread(load, std::cref(options), t, start,
+                                 std::ref(measured[t])));
+    }
+    for(size_t t = 0; t < threads.size(); t++){
+        threads[t].join();
+    }
+
+    cout << left << setw(20) << "method" << right << setw(10) << "calls"
+         << setw(8) << "errors" << setw(11) << "calls/s" << setw(10) << "mean"
+         << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99"
+         << setw(10) << "p99.9" << setw(11) << "max" << endl;
+    LatencyHistogram all;
+    uint64_t allErrors = 0;
+    for(int m = 0; m < METHODS; m++){
+        LatencyHistogram latency;
+        uint64_t errors = 0;
+        for(unsigned t = 0; t < options.threads; t++){
+            latency.merge(measured[t].latency[m]);
+            errors += measured[t].errors[m];
+        }
+        if(options.weights[m] > 0){
+            report(METHOD_NAMES[m], latency, errors, options.seconds);
+        }
+        all.merge(latency);
+        allErrors += errors;
+    }
+    report("all", all, allErrors, options.seconds);
+    cout << "latencies in microseconds" << endl;
+
+    if(!options.keep && !fillLibrary(options, true)){
+        cout << "Could not remove the waypoints from " << options.url << endl;
+    }
+    return allErrors > 0 ? 2 : 0;
+}
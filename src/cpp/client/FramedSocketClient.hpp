@@ -0,0 +1,241 @@
+#ifndef FRAMEDSOCKETCLIENT_HPP
+#define FRAMEDSOCKETCLIENT_HPP
+
+#include <string>
+#include <mutex>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <jsonrpccpp/client.h>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Client connector for the framed socket transport of the
+ * waypoint server (--connector=tcp or unix), used in place of HttpClient:
+ *
+ *     FramedSocketClient connector("tcp://127.0.0.1:8080");
+ *     waypointlibrarystub library(connector);
+ *
+ * The address is tcp://host:port or unix:path. One connection is opened
+ * on the first call and kept for the next ones; calls from several
+ * threads take turns on it. If the connection fails it is opened again
+ * on the next call.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class FramedSocketClient : public jsonrpc::IClientConnector {
+
+    public:
+
+    /**
+    * Must match the --framing of the server.
+    */
+    enum Framing { LENGTH_PREFIXED, NEWLINE };
+
+    /**
+    * @param  An address.
+    * @return True if the address is one for this connector rather than an
+    *         http url.
+    */
+    static bool handles(const string& address){
+        return address.compare(0, 6, "tcp://") == 0 ||
+               address.compare(0, 5, "unix:") == 0;
+    }
+
+    /**
+    * @param The address of the server, tcp://host:port or unix:path.
+    * @param How requests and replies are framed.
+    */
+    FramedSocketClient(const string& address,
+                       Framing framing = LENGTH_PREFIXED)
+        : address(address), framing(framing), fd(-1) {}
+
+    virtual ~FramedSocketClient(){
+        this->disconnect();
+    }
+
+    virtual void SendRPCMessage(const std::string& message,
+                                std::string& result)
+                                throw (jsonrpc::JsonRpcException){
+        lock_guard<mutex> guard(lock);
+        if(fd < 0){
+            this->connect();
+        }
+        string frame;
+        if(framing == LENGTH_PREFIXED){
+            uint32_t length = message.size();
+            frame += (char)(length >> 24);
+            frame += (char)(length >> 16);
+            frame += (char)(length >> 8);
+            frame += (char)length;
+            frame += message;
+        }else{
+            // json-rpc-cpp ends its requests with a newline, keep just one.
+            size_t last = message.find_last_not_of(" \t\r\n");
+            frame.assign(message, 0, last == string::npos ? 0 : last + 1);
+            frame += '\n';
+        }
+        if(!this->sendAll(frame) || !this->receive(result)){
+            this->disconnect();
+            throw jsonrpc::JsonRpcException(
+                jsonrpc::Errors::ERROR_CLIENT_CONNECTOR,
+                "Lost the connection to " + address);
+        }
+    }
+
+    private:
+
+    string address;
+    Framing framing;
+    int fd;
+    /**
+    * Received past the end of the last reply.
+    */
+    string pending;
+    mutex lock;
+
+    FramedSocketClient(const FramedSocketClient&) = delete;
+    FramedSocketClient& operator=(const FramedSocketClient&) = delete;
+
+    void connect() throw (jsonrpc::JsonRpcException){
+        if(address.compare(0, 5, "unix:") == 0){
+            string path = address.substr(5);
+            struct sockaddr_un to;
+            memset(&to, 0, sizeof(to));
+            to.sun_family = AF_UNIX;
+            strncpy(to.sun_path, path.c_str(), sizeof(to.sun_path) - 1);
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if(fd >= 0 && ::connect(fd, (struct sockaddr*)&to,
+                                    sizeof(to)) != 0){
+                ::close(fd);
+                fd = -1;
+            }
+        }else{
+            string hostPort = address.substr(6);
+            size_t colon = hostPort.rfind(':');
+            string host = hostPort.substr(0, colon);
+            string port = colon == string::npos ? "8080"
+                                                : hostPort.substr(colon + 1);
+            struct addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            struct addrinfo* found = NULL;
+            if(getaddrinfo(host.c_str(), port.c_str(), &hints, &found) == 0){
+                for(struct addrinfo* a = found; a != NULL && fd < 0;
+                    a = a->ai_next){
+                    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+                    if(fd >= 0 && ::connect(fd, a->ai_addr,
+                                            a->ai_addrlen) != 0){
+                        ::close(fd);
+                        fd = -1;
+                    }
+                }
+                freeaddrinfo(found);
+            }
+            if(fd >= 0){
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            }
+        }
+        if(fd < 0){
+            throw jsonrpc::JsonRpcException(
+                jsonrpc::Errors::ERROR_CLIENT_CONNECTOR,
+                "Could not connect to " + address);
+        }
+        pending.clear();
+    }
+
+    void disconnect(){
+        if(fd >= 0){
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool sendAll(const string& data){
+        size_t sent = 0;
+        while(sent < data.size()){
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent,
+                             MSG_NOSIGNAL);
+            if(n < 0 && errno == EINTR){
+                continue;
+            }
+            if(n <= 0){
+                return false;
+            }
+            sent += n;
+        }
+        return true;
+    }
+
+    /**
+    * Reads until pending holds at least size bytes.
+    */
+    bool fill(size_t size){
+        char buffer[16384];
+        while(pending.size() < size){
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if(n < 0 && errno == EINTR){
+                continue;
+            }
+            if(n <= 0){
+                return false;
+            }
+            pending.append(buffer, n);
+        }
+        return true;
+    }
+
+    bool receive(string& result){
+        if(framing == LENGTH_PREFIXED){
+            if(!this->fill(4)){
+                return false;
+            }
+            const unsigned char* p = (const unsigned char*)pending.data();
+            size_t length = (size_t)p[0] << 24 | (size_t)p[1] << 16 |
+                            (size_t)p[2] << 8 | (size_t)p[3];
+            if(!this->fill(4 + length)){
+                return false;
+            }
+            result.assign(pending, 4, length);
+            pending.erase(0, 4 + length);
+            return true;
+        }
+        size_t end;
+        while((end = pending.find('\n')) == string::npos){
+            if(!this->fill(pending.size() + 1)){
+                return false;
+            }
+        }
+        result.assign(pending, 0, end);
+        pending.erase(0, end + 1);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef WAYPOINTBATCH_HPP
+#define WAYPOINTBATCH_HPP
+
+#include <string>
+#include <vector>
+#include <jsonrpccpp/client.h>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Collects waypoint library calls and sends them as a single
+ * JSON-RPC 2.0 batch, so they cost one round trip instead of one each.
+ * Each call returns an id that picks its result once the batch is sent:
+ *
+ *     WaypointBatch batch(*library);
+ *     int names = batch.getNames();
+ *     int first = batch.get("Tempe");
+ *     batch.send();
+ *     Json::Value tempe = batch.result(first);
+ *
+ * The server runs consecutive read only calls of a batch in parallel
+ * and everything else in order.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WaypointBatch {
+
+    public:
+
+    /**
+    * @param The client the batch is sent through, such as the
+    *        waypointlibrarystub.
+    */
+    WaypointBatch(jsonrpc::Client& client) : client(client) {}
+
+    /**
+    * Queues any method of the library.
+    *
+    * @param  The method name.
+    * @param  The positional parameters, a json array.
+    * @return The id of the call.
+    */
+    int call(const string& method, const Json::Value& params){
+        return calls.addCall(method, params);
+    }
+
+    int get(const string& name){
+        Json::Value params(Json::arrayValue);
+        params.append(name);
+        return this->call("get", params);
+    }
+
+    int getNames(){
+        return this->call("getNames", Json::Value(Json::arrayValue));
+    }
+
+    int distanceAndBearing(const string& waypoint1, const string& waypoint2){
+        Json::Value params(Json::arrayValue);
+        params.append(waypoint1);
+        params.append(waypoint2);
+        return this->call("distanceAndBearing", params);
+    }
+
+    int remove(const string& name){
+        Json::Value params(Json::arrayValue);
+        params.append(name);
+        return this->call("remove", params);
+    }
+
+    int resetFromJsonFile(){
+        return this->call("resetFromJsonFile", Json::Value(Json::arrayValue));
+    }
+
+    /**
+    * Sends every queued call in one request.
+    */
+    void send() throw (jsonrpc::JsonRpcException){
+        responses = client.CallProcedures(calls);
+    }
+
+    /**
+    * @param  The id a call returned.
+    * @return The result of that call, null if it failed.
+    */
+    Json::Value result(int id){
+        return responses.getResult(id);
+    }
+
+    /**
+    * Fetches several waypoints in a single round trip.
+    *
+    * @param  The client to send through.
+    * @param  The names of the waypoints.
+    * @return The waypoints, in the order of the names.
+    */
+    static vector<Json::Value> getMany(jsonrpc::Client& client,
+                                       const vector<string>& names)
+                                       throw (jsonrpc::JsonRpcException){
+        WaypointBatch batch(client);
+        vector<int> ids;
+        for(size_t i = 0; i < names.size(); i++){
+            ids.push_back(batch.get(names[i]));
+        }
+        vector<Json::Value> waypoints;
+        if(names.empty()){
+            return waypoints;
+        }
+        batch.send();
+        for(size_t i = 0; i < ids.size(); i++){
+            waypoints.push_back(batch.result(ids[i]));
+        }
+        return waypoints;
+    }
+
+    private:
+
+    jsonrpc::Client& client;
+    jsonrpc::BatchCall calls;
+    jsonrpc::BatchResponse responses;
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "WaypointGUI.cpp"
 #include "waypointlibrarystub.h"
+#include "WaypointBatch.hpp"
+#include "FramedSocketClient.hpp"
 #include "../server/WaypointLibrary.hpp"
 
 #include <FL/Fl.H>
@@ -58,7 +60,7 @@ using namespace std;
 class WaypointClient : public WaypointGUI {
 
    waypointlibrarystub * library;
-   HttpClient * httpclient;
+   IClientConnector * httpclient;
 
    /** ClickedX is one of the callbacks for GUI controls.
     * Callbacks need to be static functions. But, static functions
@@ -172,10 +174,14 @@ class WaypointClient : public WaypointGUI {
       std::cout << "You clicked the restore button"
                 << std::endl;
       
-      anInstance->library->resetFromJsonFile();
+      // restore and fetch the names back in one round trip.
+      WaypointBatch batch(*anInstance->library);
+      batch.resetFromJsonFile();
+      int namesCall = batch.getNames();
+      batch.send();
       std::cout << "Tried to send restore from file request"
                 << std::endl;
-      Json::Value names = anInstance->library->getNames();
+      Json::Value names = batch.result(namesCall);
       for(Json::Value::iterator i= names.begin(); i != names.end(); i++){
         int size = theWPChoice->menubutton()->size();
         bool alreadyIn = false;
@@ -254,7 +260,12 @@ class WaypointClient : public WaypointGUI {
 
 public:
    WaypointClient(const char * name = 0, string host= "http://127.0.0.1:8080") : WaypointGUI(name) {
-      httpclient = new HttpClient(host);
+      // tcp://host:port and unix:path skip HTTP, see FramedSocketClient.
+      if(FramedSocketClient::handles(host)){
+         httpclient = new FramedSocketClient(host);
+      }else{
+         httpclient = new HttpClient(host);
+      }
       library = new waypointlibrarystub(*httpclient);
       Json::Value names = library->getNames();
       for(Json::Value::iterator i= names.begin(); i != names.end(); i++){
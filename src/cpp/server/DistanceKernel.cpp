@@ -0,0 +1,120 @@
+#include "DistanceKernel.hpp"
+#include "Waypoint.hpp"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DISTANCEKERNEL_X86 1
+#endif
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Bulk great circle distances.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+void DistanceKernel::Points::add(double lat, double lon){
+    double latRad = Waypoint::toRadians(lat);
+    double lonRad = Waypoint::toRadians(lon);
+    double cosLat = std::cos(latRad);
+    x.push_back(cosLat * std::cos(lonRad));
+    y.push_back(cosLat * std::sin(lonRad));
+    z.push_back(std::sin(latRad));
+}
+
+/**
+* Squared chord lengths from (ox, oy, oz) to each of the n vectors.
+*/
+static void chordsScalar(const double* x, const double* y, const double* z,
+                         size_t n, double ox, double oy, double oz,
+                         double* out){
+    for(size_t j = 0; j < n; j++){
+        double dx = x[j] - ox;
+        double dy = y[j] - oy;
+        double dz = z[j] - oz;
+        out[j] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+#ifdef DISTANCEKERNEL_X86
+__attribute__((target("avx2,fma")))
+static void chordsAvx2(const double* x, const double* y, const double* z,
+                       size_t n, double ox, double oy, double oz,
+                       double* out){
+    __m256d vx = _mm256_set1_pd(ox);
+    __m256d vy = _mm256_set1_pd(oy);
+    __m256d vz = _mm256_set1_pd(oz);
+    size_t j = 0;
+    for(; j + 4 <= n; j += 4){
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), vx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), vy);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + j), vz);
+        __m256d sum = _mm256_mul_pd(dx, dx);
+        sum = _mm256_fmadd_pd(dy, dy, sum);
+        sum = _mm256_fmadd_pd(dz, dz, sum);
+        _mm256_storeu_pd(out + j, sum);
+    }
+    chordsScalar(x + j, y + j, z + j, n - j, ox, oy, oz, out + j);
+}
+
+static bool hasAvx2(){
+    static const bool supported = __builtin_cpu_supports("avx2") &&
+                                  __builtin_cpu_supports("fma");
+    return supported;
+}
+#endif
+
+void DistanceKernel::row(const Points& from, size_t origin, const Points& to,
+                         int scale, double* out){
+    size_t n = to.size();
+    if(n == 0){
+        return;
+    }
+    double ox = from.x[origin];
+    double oy = from.y[origin];
+    double oz = from.z[origin];
+#ifdef DISTANCEKERNEL_X86
+    if(hasAvx2()){
+        chordsAvx2(&to.x[0], &to.y[0], &to.z[0], n, ox, oy, oz, out);
+    }else{
+        chordsScalar(&to.x[0], &to.y[0], &to.z[0], n, ox, oy, oz, out);
+    }
+#else
+    chordsScalar(&to.x[0], &to.y[0], &to.z[0], n, ox, oy, oz, out);
+#endif
+    // haversine a = chord^2 / 4, so the central angle is 2 asin(chord / 2).
+    double factor = 2.0 * Waypoint::toScale(Waypoint::radiusE, scale);
+    for(size_t j = 0; j < n; j++){
+        double half = 0.5 * std::sqrt(out[j]);
+        out[j] = factor * std::asin(std::min(half, 1.0));
+    }
+}
+
+void DistanceKernel::matrix(const Points& from, const Points& to, int scale,
+                            vector<double>& out){
+    out.resize(from.size() * to.size());
+    if(out.empty()){
+        return;
+    }
+    for(size_t i = 0; i < from.size(); i++){
+        row(from, i, to, scale, &out[0] + i * to.size());
+    }
+}
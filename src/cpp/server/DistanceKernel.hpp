@@ -0,0 +1,79 @@
+#ifndef DISTANCEKERNEL_HPP
+#define DISTANCEKERNEL_HPP
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Bulk great circle distances. Positions are converted once into
+ * columns of unit vector coordinates; the haversine term of a pair is then
+ * a quarter of the squared chord between their vectors, which needs no
+ * trigonometry per pair and vectorizes. On x86 the chord pass uses AVX2
+ * when the cpu has it and plain loops otherwise.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class DistanceKernel {
+
+    public:
+
+    /**
+    * Positions as structure of arrays unit vectors.
+    */
+    struct Points {
+        vector<double> x;
+        vector<double> y;
+        vector<double> z;
+
+        /**
+        * Appends a position given in degrees.
+        */
+        void add(double lat, double lon);
+
+        size_t size() const { return x.size(); }
+    };
+
+    /**
+    * Distances from one position to every position in to.
+    *
+    * @param The origins.
+    * @param The index in from of the origin.
+    * @param The destinations.
+    * @param Waypoint::STATUTE, Waypoint::NAUTICAL or Waypoint::KMETER.
+    * @param Where to write to.size() distances.
+    */
+    static void row(const Points& from, size_t origin, const Points& to,
+                    int scale, double* out);
+
+    /**
+    * Distances from every position in from to every position in to, row
+    * major.
+    *
+    * @param The origins.
+    * @param The destinations.
+    * @param Waypoint::STATUTE, Waypoint::NAUTICAL or Waypoint::KMETER.
+    * @param Resized to from.size() * to.size() and filled.
+    */
+    static void matrix(const Points& from, const Points& to, int scale,
+                       vector<double>& out);
+};
+
+#endif
@@ -0,0 +1,441 @@
+#include "EpollHttpServer.hpp"
+
+#ifdef __linux__
+
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
+#include <strings.h>
+
+#include "Logger.hpp"
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: JSON-RPC over HTTP/1.1 on the epoll connector.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+// set in Connection::flags once 100 Continue went out for the request at
+// the head of the input.
+static const unsigned CONTINUE_SENT = 1;
+
+// longest chunk size line of a chunked body, extensions included.
+static const size_t MAX_CHUNK_LINE = 1024;
+
+/**
+* A body being streamed to its handler, kept on the connection between
+* reads.
+*/
+struct EpollHttpServer::Upload : public EpollServer::Stream {
+    // where in the body the next byte is: in a chunk size line, in data,
+    // at the line end after a chunk, or in the trailer after the last.
+    enum State { SIZE, DATA, DATA_END, TRAILER };
+    unique_ptr<BodyHandler> handler;
+    State state;
+    // bytes of data left, in the body or the current chunk.
+    unsigned long long left;
+    bool chunked;
+    bool closeAfter;
+};
+
+/**
+* A reply being streamed from its source, kept on the connection until
+* the last piece is out.
+*/
+struct EpollHttpServer::Download : public EpollServer::Stream {
+    unique_ptr<BodySource> source;
+    // HTTP/1.0 clients get the body unchunked, ended by closing.
+    bool chunked;
+    bool closeAfter;
+};
+
+EpollHttpServer::EpollHttpServer(int port, unsigned threads)
+    : EpollServer(threads), port(port){
+}
+
+void EpollHttpServer::streamPath(const string& path,
+                                 const function<BodyHandler*()>& make){
+    streamed.push_back(make_pair(path, make));
+}
+
+void EpollHttpServer::sourcePath(const string& path, const string& contentType,
+                                 const function<BodySource*()>& make){
+    Source source;
+    source.path = path;
+    source.contentType = contentType;
+    source.make = make;
+    sources.push_back(source);
+}
+
+/**
+* Adds the next piece of the reply being streamed, if any, once the one
+* before it went out, and goes on with the requests behind it once the
+* last one did.
+*/
+bool EpollHttpServer::onDrained(Connection& c){
+    Download* download = dynamic_cast<Download*>(c.stream.get());
+    if(download == NULL){
+        return true;
+    }
+    thread_local string piece;
+    piece.clear();
+    bool more = true;
+    while(more && piece.empty()){
+        more = download->source->next(piece);
+    }
+    if(download->chunked && !piece.empty()){
+        char size[24];
+        snprintf(size, sizeof(size), "%zx\r\n", piece.size());
+        c.out += size;
+        c.out += piece;
+        c.out += "\r\n";
+    }else{
+        c.out += piece;
+    }
+    if(more){
+        return true;
+    }
+    if(download->chunked){
+        c.out += "0\r\n\r\n";
+    }
+    c.closeAfter = download->closeAfter;
+    c.stream.reset();
+    return c.in.empty() || this->onData(c);
+}
+
+EpollHttpServer::~EpollHttpServer(){
+    // the threads call back into this object, stop them while it is whole.
+    this->StopListening();
+}
+
+int EpollHttpServer::openListener(){
+    return listenTcp(port);
+}
+
+/**
+* Hands the body bytes at pos in c.in to the handler of the upload on the
+* connection, decoding chunks as they come.
+*
+* @return 0 while more of the body is to come, 200 once it is complete,
+*         400 if the chunked encoding is broken.
+*/
+int EpollHttpServer::feed(Connection& c, size_t& pos){
+    Upload& u = static_cast<Upload&>(*c.stream);
+    const string& in = c.in;
+    while(true){
+        if(u.state == Upload::DATA){
+            size_t n = in.size() - pos;
+            if(n > u.left){
+                n = u.left;
+            }
+            if(n > 0){
+                u.handler->data(in.data() + pos, n);
+                pos += n;
+                u.left -= n;
+            }
+            if(u.left > 0){
+                return 0;
+            }
+            if(!u.chunked){
+                return 200;
+            }
+            u.state = Upload::DATA_END;
+        }
+        if(u.state == Upload::DATA_END){
+            if(in.size() - pos < 2){
+                return 0;
+            }
+            if(in.compare(pos, 2, "\r\n") != 0){
+                return 400;
+            }
+            pos += 2;
+            u.state = Upload::SIZE;
+        }
+        size_t lineEnd = in.find("\r\n", pos);
+        if(lineEnd == string::npos){
+            return in.size() - pos > MAX_CHUNK_LINE ? 400 : 0;
+        }
+        if(u.state == Upload::TRAILER){
+            // trailer fields are ignored, an empty line ends them.
+            bool last = lineEnd == pos;
+            pos = lineEnd + 2;
+            if(last){
+                return 200;
+            }
+            continue;
+        }
+        if(!isxdigit((unsigned char)in[pos])){
+            return 400;
+        }
+        u.left = strtoull(in.c_str() + pos, NULL, 16);
+        u.state = u.left == 0 ? Upload::TRAILER : Upload::DATA;
+        pos = lineEnd + 2;
+    }
+}
+
+/**
+* Starts streaming the reply to a GET of a source path, writing its head.
+*
+* @return False if no source is registered for the path.
+*/
+bool EpollHttpServer::startDownload(Connection& c, const string& path,
+                                    bool http10){
+    for(size_t i = 0; i < sources.size(); i++){
+        if(sources[i].path != path){
+            continue;
+        }
+        Download* download = new Download();
+        download->source.reset(sources[i].make());
+        download->chunked = !http10;
+        download->closeAfter = c.closeAfter || http10;
+        c.out += http10 ? "HTTP/1.0 200 OK" : "HTTP/1.1 200 OK";
+        c.out += "\r\nContent-Type: " + sources[i].contentType +
+                 "\r\nAccess-Control-Allow-Origin: *";
+        if(download->chunked){
+            c.out += "\r\nTransfer-Encoding: chunked";
+        }
+        if(download->closeAfter){
+            c.out += "\r\nConnection: close";
+        }
+        c.out += "\r\n\r\n";
+        // kept open until the last piece is out.
+        c.closeAfter = false;
+        c.stream.reset(download);
+        return true;
+    }
+    return false;
+}
+
+static const char* reason(int status){
+    switch(status){
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        default: return "Error";
+    }
+}
+
+void EpollHttpServer::reply(Connection& c, int status, const string& body){
+    string& out = c.out;
+    out += "HTTP/1.1 ";
+    out += to_string(status);
+    out += ' ';
+    out += reason(status);
+    out += "\r\nContent-Type: application/json"
+           "\r\nAccess-Control-Allow-Origin: *"
+           "\r\nContent-Length: ";
+    out += to_string(body.size());
+    if(c.closeAfter){
+        out += "\r\nConnection: close";
+    }
+    out += "\r\n\r\n";
+    out += body;
+}
+
+/**
+* @return True if the size characters at text are name, ignoring case.
+*/
+static bool is(const char* text, size_t size, const char* name){
+    return size == strlen(name) && strncasecmp(text, name, size) == 0;
+}
+
+/**
+* @return True if value contains token, ignoring case, as in
+*         "Connection: keep-alive, Upgrade".
+*/
+static bool hasToken(const string& value, const char* token){
+    size_t length = strlen(token);
+    for(size_t i = 0; i + length <= value.size(); i++){
+        if(strncasecmp(value.c_str() + i, token, length) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EpollHttpServer::onData(Connection& c){
+    // reused by every request the thread handles.
+    thread_local string body;
+    thread_local string response;
+    const string& in = c.in;
+    size_t pos = 0;
+    while(!c.closeAfter && (pos < in.size() || c.stream)){
+        if(dynamic_cast<Download*>(c.stream.get()) != NULL){
+            // the rest waits until the reply being streamed is out.
+            break;
+        }
+        if(c.stream){
+            int status = this->feed(c, pos);
+            if(status == 0){
+                break;
+            }
+            Upload& u = static_cast<Upload&>(*c.stream);
+            string report = u.handler->end();
+            c.closeAfter = status != 200 || u.closeAfter;
+            this->reply(c, status, report);
+            c.stream.reset();
+            continue;
+        }
+        size_t headerEnd = in.find("\r\n\r\n", pos);
+        if(headerEnd == string::npos ? in.size() - pos > MAX_HEADER
+                                     : headerEnd - pos > MAX_HEADER){
+            c.closeAfter = true;
+            this->reply(c, 431, "");
+            break;
+        }
+        if(headerEnd == string::npos){
+            break;
+        }
+
+        // request line: method target version
+        size_t lineEnd = in.find("\r\n", pos);
+        size_t methodEnd = in.find(' ', pos);
+        if(methodEnd == string::npos || methodEnd > lineEnd){
+            c.closeAfter = true;
+            this->reply(c, 400, "");
+            break;
+        }
+        string method = in.substr(pos, methodEnd - pos);
+        size_t targetEnd = in.find(' ', methodEnd + 1);
+        string path = targetEnd < lineEnd
+                      ? in.substr(methodEnd + 1, targetEnd - methodEnd - 1)
+                      : string();
+        path = path.substr(0, path.find('?'));
+        bool http10 = lineEnd - pos > 8 &&
+                      in.compare(lineEnd - 8, 8, "HTTP/1.0") == 0;
+
+        size_t contentLength = 0;
+        unsigned long long declaredLength = 0;
+        bool badLength = false;
+        bool chunked = false;
+        bool expectContinue = false;
+        string connection;
+        size_t line = lineEnd + 2;
+        while(line < headerEnd + 2){
+            size_t end = in.find("\r\n", line);
+            size_t colon = in.find(':', line);
+            if(colon != string::npos && colon < end){
+                size_t value = in.find_first_not_of(" \t", colon + 1);
+                if(value > end){
+                    value = end;
+                }
+                const char* name = in.data() + line;
+                size_t nameSize = colon - line;
+                if(is(name, nameSize, "Content-Length")){
+                    char* stop = NULL;
+                    unsigned long long n = strtoull(in.c_str() + value, &stop,
+                                                    10);
+                    badLength = stop == in.c_str() + value ||
+                                in[value] == '-';
+                    declaredLength = n;
+                    contentLength = n > MAX_BODY ? MAX_BODY + 1 : n;
+                }else if(is(name, nameSize, "Transfer-Encoding")){
+                    chunked = true;
+                }else if(is(name, nameSize, "Expect")){
+                    expectContinue = hasToken(in.substr(value, end - value),
+                                              "100-continue");
+                }else if(is(name, nameSize, "Connection")){
+                    connection = in.substr(value, end - value);
+                }
+            }
+            line = end + 2;
+        }
+
+        if(badLength){
+            c.closeAfter = true;
+            this->reply(c, 400, "");
+            break;
+        }
+        bool closing = http10 ? !hasToken(connection, "keep-alive")
+                              : hasToken(connection, "close");
+        const function<BodyHandler*()>* make = NULL;
+        for(size_t i = 0; i < streamed.size() && method == "POST"; i++){
+            if(streamed[i].first == path){
+                make = &streamed[i].second;
+            }
+        }
+        if(make != NULL){
+            LOG_DEBUG("Streaming the body of POST " << path);
+            Upload* upload = new Upload();
+            upload->handler.reset((*make)());
+            upload->state = chunked ? Upload::SIZE : Upload::DATA;
+            upload->left = chunked ? 0 : declaredLength;
+            upload->chunked = chunked;
+            upload->closeAfter = closing;
+            c.stream.reset(upload);
+            if(expectContinue){
+                c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+            }
+            pos = headerEnd + 4;
+            continue;
+        }
+        if(chunked){
+            c.closeAfter = true;
+            this->reply(c, 501, "");
+            break;
+        }
+        if(contentLength > MAX_BODY){
+            c.closeAfter = true;
+            this->reply(c, 413, "");
+            break;
+        }
+        size_t bodyStart = headerEnd + 4;
+        if(in.size() - bodyStart < contentLength){
+            if(expectContinue && !(c.flags & CONTINUE_SENT)){
+                c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+                c.flags |= CONTINUE_SENT;
+            }
+            break;
+        }
+        c.flags &= ~CONTINUE_SENT;
+
+        c.closeAfter = closing;
+        if(method == "POST"){
+            body.assign(in, bodyStart, contentLength);
+            response.clear();
+            if(this->ProcessRequest(body, response)){
+                this->reply(c, 200, response);
+            }else{
+                this->reply(c, 500, "");
+            }
+        }else if(method == "GET" && this->startDownload(c, path, http10)){
+            LOG_DEBUG("Streaming the reply to GET " << path);
+        }else if(method == "OPTIONS"){
+            c.out += "HTTP/1.1 200 OK"
+                     "\r\nAccess-Control-Allow-Origin: *"
+                     "\r\nAccess-Control-Allow-Methods: POST, OPTIONS"
+                     "\r\nAccess-Control-Allow-Headers: Content-Type"
+                     "\r\nContent-Length: 0\r\n\r\n";
+        }else{
+            LOG_DEBUG("Refused " << method << " request");
+            this->reply(c, 405, "");
+        }
+        pos = bodyStart + contentLength;
+    }
+    c.in.erase(0, pos);
+    return true;
+}
+
+#endif
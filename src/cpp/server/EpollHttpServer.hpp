@@ -0,0 +1,148 @@
+#ifndef EPOLLHTTPSERVER_HPP
+#define EPOLLHTTPSERVER_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "EpollServer.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: JSON-RPC over HTTP/1.1 on the epoll connector, a drop in for
+ * the libmicrohttpd HttpServer of json-rpc-cpp. Connections are kept
+ * alive and requests may be pipelined; the replies go back in order.
+ * Each request is a POST whose body is the JSON-RPC request, as the
+ * HttpClient of json-rpc-cpp and the Java proxy send it. OPTIONS is
+ * answered for CORS, every other method gets 405, and chunked bodies are
+ * not supported.
+ *
+ * A path registered with streamPath is the exception: a POST to it is not
+ * JSON-RPC, and its body, sized by Content-Length or chunked, is handed to
+ * a BodyHandler piece by piece as it arrives rather than held in memory,
+ * so it may be of any size. What the handler ends with is the reply.
+ * Likewise a GET to a path registered with sourcePath is answered with a
+ * chunked body a BodySource writes a piece at a time, each piece only
+ * once the one before it was sent, so a reply of any size takes no more
+ * memory than a piece. Requests pipelined behind it wait until it ends.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class EpollHttpServer : public EpollServer {
+
+    public:
+
+    /**
+    * Largest request header accepted.
+    */
+    static const size_t MAX_HEADER = 16 << 10;
+    /**
+    * Largest request body accepted.
+    */
+    static const size_t MAX_BODY = 64 << 20;
+
+    /**
+    * Receives the body of one request to a streamed path. Only one thread
+    * at a time calls it.
+    */
+    class BodyHandler {
+        public:
+        virtual ~BodyHandler() {}
+        /**
+        * Takes the next bytes of the body.
+        */
+        virtual void data(const char* bytes, size_t size) = 0;
+        /**
+        * Called once the body is complete.
+        *
+        * @return The json body of the reply.
+        */
+        virtual string end() = 0;
+    };
+
+    /**
+    * Writes the body of the reply to one request to a source path. Only
+    * one thread at a time calls it.
+    */
+    class BodySource {
+        public:
+        virtual ~BodySource() {}
+        /**
+        * Appends the next piece of the body.
+        *
+        * @return False once that was the last piece.
+        */
+        virtual bool next(string& out) = 0;
+    };
+
+    /**
+    * @param The port to listen on.
+    * @param How many threads serve connections, 0 for one per cpu.
+    */
+    EpollHttpServer(int port, unsigned threads);
+    virtual ~EpollHttpServer();
+
+    /**
+    * Streams the bodies of POST requests to a path to handlers, instead
+    * of processing them as JSON-RPC. Call before StartListening.
+    *
+    * @param The path, as in "/import".
+    * @param Makes the handler of each request.
+    */
+    void streamPath(const string& path, const function<BodyHandler*()>& make);
+
+    /**
+    * Answers GET requests to a path with a body streamed from a source.
+    * Call before StartListening.
+    *
+    * @param The path, as in "/export".
+    * @param The content type of the body.
+    * @param Makes the source of each reply.
+    */
+    void sourcePath(const string& path, const string& contentType,
+                    const function<BodySource*()>& make);
+
+    protected:
+
+    virtual int openListener();
+    virtual bool onData(Connection& c);
+    virtual bool onDrained(Connection& c);
+
+    private:
+
+    int port;
+    vector<pair<string, function<BodyHandler*()> > > streamed;
+    struct Source {
+        string path;
+        string contentType;
+        function<BodySource*()> make;
+    };
+    vector<Source> sources;
+
+    struct Upload;
+    struct Download;
+
+    void reply(Connection& c, int status, const string& body);
+    int feed(Connection& c, size_t& pos);
+    bool startDownload(Connection& c, const string& path, bool http10);
+};
+
+#endif
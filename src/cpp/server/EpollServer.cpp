@@ -0,0 +1,332 @@
+#include "EpollServer.hpp"
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "Logger.hpp"
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Base for the connectors built on epoll.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+// events handed to a thread per wait; small so busy connections spread.
+static const int EVENTS_PER_WAIT = 16;
+static const size_t READ_CHUNK = 16384;
+// read per turn at most, so a client streaming a large body is handled a
+// piece at a time instead of buffered whole; the socket stays readable,
+// so re-arming it brings the connection straight back.
+static const size_t READ_PER_TURN = 1 << 20;
+// likewise the most a streamed reply adds to the output per turn.
+static const size_t WRITE_PER_TURN = 1 << 20;
+
+EpollServer::EpollServer(unsigned threads)
+    : threadCount(threads), epollFd(-1), wakeFd(-1), listening(NULL),
+      running(false){
+    if(threadCount == 0){
+        threadCount = std::max(1u, thread::hardware_concurrency());
+    }
+}
+
+EpollServer::~EpollServer(){
+    this->StopListening();
+}
+
+int EpollServer::listenTcp(int port){
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if(bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+       listen(fd, SOMAXCONN) != 0){
+        LOG_ERROR("Cannot listen on port " << port << ": " << strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool EpollServer::StartListening(){
+    if(running){
+        return true;
+    }
+    int fd = this->openListener();
+    if(fd < 0){
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    listening = new Connection(fd);
+    listening->listener = true;
+
+    // the wake up descriptor is level triggered and never read, so once it
+    // is written every thread sees it and leaves.
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = listening;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+
+    running = true;
+    for(unsigned i = 0; i < threadCount; i++){
+        threads.push_back(thread(&EpollServer::run, this));
+    }
+    return true;
+}
+
+bool EpollServer::StopListening(){
+    if(!running){
+        return true;
+    }
+    running = false;
+    uint64_t one = 1;
+    if(write(wakeFd, &one, sizeof(one)) < 0){
+        LOG_ERROR("Cannot wake the connection threads: " << strerror(errno));
+    }
+    for(size_t i = 0; i < threads.size(); i++){
+        threads[i].join();
+    }
+    threads.clear();
+    for(unordered_set<Connection*>::iterator i = connections.begin();
+        i != connections.end(); i++){
+        close((*i)->fd);
+        delete *i;
+    }
+    connections.clear();
+    close(listening->fd);
+    delete listening;
+    listening = NULL;
+    this->closedListener();
+    close(wakeFd);
+    close(epollFd);
+    return true;
+}
+
+void EpollServer::run(){
+    struct epoll_event events[EVENTS_PER_WAIT];
+    while(true){
+        int n = epoll_wait(epollFd, events, EVENTS_PER_WAIT, -1);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            LOG_ERROR("epoll_wait failed: " << strerror(errno));
+            return;
+        }
+        for(int i = 0; i < n; i++){
+            Connection* c = (Connection*)events[i].data.ptr;
+            if(c == NULL){
+                return;
+            }
+            if(c->listener){
+                this->acceptAll();
+            }else if(!this->serve(c)){
+                this->drop(c);
+            }
+        }
+    }
+}
+
+void EpollServer::acceptAll(){
+    while(true){
+        int fd = accept4(listening->fd, NULL, NULL,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                LOG_WARN("accept failed: " << strerror(errno));
+            }
+            break;
+        }
+        // replies are written whole, waiting to coalesce them only adds
+        // latency. Fails harmlessly on unix sockets.
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        Connection* c = new Connection(fd);
+        {
+            lock_guard<mutex> guard(connectionsLock);
+            connections.insert(c);
+        }
+        c->turns.fetch_add(1, memory_order_release);
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLONESHOT;
+        event.data.ptr = c;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+    this->arm(listening, EPOLLIN);
+}
+
+/**
+* Sends as much of the pending output as the socket takes.
+*
+* @return False if the connection failed.
+*/
+bool EpollServer::flush(Connection* c){
+    while(c->sent < c->out.size()){
+        ssize_t n = send(c->fd, c->out.data() + c->sent,
+                         c->out.size() - c->sent, MSG_NOSIGNAL);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c->sent += n;
+    }
+    // keep the capacity, the next reply reuses it.
+    c->out.clear();
+    c->sent = 0;
+    return true;
+}
+
+/**
+* Sends the pending output, and the pieces of a streamed reply after it
+* as the socket takes them.
+*
+* @return False if the connection failed.
+*/
+bool EpollServer::pump(Connection* c){
+    size_t added = 0;
+    while(true){
+        if(!this->flush(c)){
+            return false;
+        }
+        if(!c->out.empty()){
+            return true;
+        }
+        if(!this->onDrained(*c)){
+            return false;
+        }
+        // left unsent past the cap, so the connection is armed for
+        // output and comes back for the rest.
+        added += c->out.size();
+        if(c->out.empty() || added >= WRITE_PER_TURN){
+            return true;
+        }
+    }
+}
+
+/**
+* Handles whatever woke the connection up: first the output still pending,
+* then what there is to read, up to READ_PER_TURN, then the requests it
+* completes. While output is pending nothing more is read, so a client
+* that does not read its replies cannot make the server buffer without
+* end.
+*
+* @return False if the connection is to be dropped.
+*/
+bool EpollServer::serve(Connection* c){
+    c->turns.load(memory_order_acquire);
+    if(!this->pump(c)){
+        return false;
+    }
+    if(!c->out.empty()){
+        this->arm(c, EPOLLOUT);
+        return true;
+    }
+    if(c->closeAfter){
+        return false;
+    }
+    bool peerClosed = false;
+    size_t received = 0;
+    while(received < READ_PER_TURN){
+        size_t used = c->in.size();
+        c->in.resize(used + READ_CHUNK);
+        ssize_t n = recv(c->fd, &c->in[used], READ_CHUNK, 0);
+        c->in.resize(used + (n > 0 ? n : 0));
+        if(n > 0){
+            received += n;
+            continue;
+        }
+        if(n == 0){
+            peerClosed = true;
+            break;
+        }
+        if(errno == EINTR){
+            continue;
+        }
+        if(errno == EAGAIN || errno == EWOULDBLOCK){
+            break;
+        }
+        return false;
+    }
+    if(!c->in.empty() && !this->onData(*c)){
+        return false;
+    }
+    if(!this->pump(c)){
+        return false;
+    }
+    if(!c->out.empty()){
+        this->arm(c, EPOLLOUT);
+        return true;
+    }
+    if(c->closeAfter || peerClosed){
+        return false;
+    }
+    this->arm(c, EPOLLIN);
+    return true;
+}
+
+void EpollServer::arm(Connection* c, unsigned events){
+    struct epoll_event event;
+    event.events = events | EPOLLONESHOT;
+    if(!c->listener){
+        event.events |= EPOLLRDHUP | EPOLLET;
+    }
+    event.data.ptr = c;
+    int fd = c->fd;
+    // c may be served by another thread the moment it is armed.
+    c->turns.fetch_add(1, memory_order_release);
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void EpollServer::drop(Connection* c){
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    {
+        lock_guard<mutex> guard(connectionsLock);
+        connections.erase(c);
+    }
+    delete c;
+}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef EPOLLSERVER_HPP
+#define EPOLLSERVER_HPP
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <unordered_set>
+#include <jsonrpccpp/server.h>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Base for the connectors built on epoll, Linux only. A fixed
+ * set of threads share one edge triggered epoll instance; every socket
+ * is armed one shot, so a connection is only ever handled by one thread
+ * at a time and is re-armed once that thread is done with it. Sockets
+ * are non blocking and stay open between requests, and each connection
+ * keeps its input and output buffers for its whole life.
+ *
+ * Subclasses open the listening socket and turn the bytes received on a
+ * connection into requests for ProcessRequest and the replies back into
+ * bytes; everything else, accepting, reading, writing and closing, is
+ * done here.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class EpollServer : public jsonrpc::AbstractServerConnector {
+
+    public:
+
+    /**
+    * @param How many threads serve connections, 0 for one per cpu.
+    */
+    EpollServer(unsigned threads);
+    virtual ~EpollServer();
+
+    virtual bool StartListening();
+    virtual bool StopListening();
+
+    protected:
+
+    /**
+    * Protocol state a connection keeps across reads, such as a request
+    * body still being received; deleted with the connection.
+    */
+    struct Stream {
+        virtual ~Stream() {}
+    };
+
+    /**
+    * One client connection. Only the thread currently serving it touches
+    * it.
+    */
+    struct Connection {
+        int fd;
+        bool listener;
+        /**
+        * Bytes received and not consumed yet.
+        */
+        string in;
+        /**
+        * Bytes to send, of which the first sent already went out.
+        */
+        string out;
+        size_t sent;
+        /**
+        * Close once out is sent, and read nothing more.
+        */
+        bool closeAfter;
+        /**
+        * Free for the protocol to keep state between reads.
+        */
+        unsigned flags;
+        unique_ptr<Stream> stream;
+        /**
+        * Bumped each time the connection is armed. epoll hands it to the
+        * next thread in the kernel, out of sight of the memory model;
+        * releasing and acquiring this makes that handoff visible.
+        */
+        atomic<unsigned> turns;
+
+        Connection(int fd) : fd(fd), listener(false), sent(0),
+                             closeAfter(false), flags(0), turns(0) {}
+    };
+
+    /**
+    * Opens the socket to accept connections on.
+    *
+    * @return The listening socket, or -1 if it could not be opened.
+    */
+    virtual int openListener() = 0;
+
+    /**
+    * Called once the listening socket is closed, to clean up after it.
+    */
+    virtual void closedListener() {}
+
+    /**
+    * Consumes the complete requests at the start of c.in, handles them
+    * and appends their replies to c.out. An incomplete request is left
+    * in c.in for the next call.
+    *
+    * @param  The connection that received data.
+    * @return False to drop the connection at once.
+    */
+    virtual bool onData(Connection& c) = 0;
+
+    /**
+    * Called each time everything in c.out went out, so a reply streamed
+    * in pieces can append its next one; nothing appended means there is
+    * nothing more to send.
+    *
+    * @param  The connection that sent its output.
+    * @return False to drop the connection at once.
+    */
+    virtual bool onDrained(Connection&) { return true; }
+
+    /**
+    * Opens a TCP socket listening on every interface.
+    *
+    * @param  The port.
+    * @return The socket, or -1 if it could not be opened.
+    */
+    static int listenTcp(int port);
+
+    private:
+
+    unsigned threadCount;
+    int epollFd;
+    int wakeFd;
+    Connection* listening;
+    atomic<bool> running;
+    vector<thread> threads;
+    mutex connectionsLock;
+    unordered_set<Connection*> connections;
+
+    EpollServer(const EpollServer&) = delete;
+    EpollServer& operator=(const EpollServer&) = delete;
+
+    void run();
+    void acceptAll();
+    bool serve(Connection* c);
+    bool flush(Connection* c);
+    bool pump(Connection* c);
+    void arm(Connection* c, unsigned events);
+    void drop(Connection* c);
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include "FramedSocketServer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Logger.hpp"
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Framed JSON-RPC over TCP and Unix domain sockets.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+bool FramedSocketServer::parseFraming(const string& name, Framing& framing){
+    if(name == "length"){
+        framing = LENGTH_PREFIXED;
+    }else if(name == "line"){
+        framing = NEWLINE;
+    }else{
+        return false;
+    }
+    return true;
+}
+
+// the connector itself is built on epoll.
+#ifdef __linux__
+
+FramedSocketServer::FramedSocketServer(int port, Framing framing,
+                                       unsigned threads)
+    : EpollServer(threads), port(port), framing(framing){
+}
+
+FramedSocketServer::FramedSocketServer(const string& socketPath,
+                                       Framing framing, unsigned threads)
+    : EpollServer(threads), port(-1), socketPath(socketPath),
+      framing(framing){
+}
+
+FramedSocketServer::~FramedSocketServer(){
+    // the threads call back into this object, stop them while it is whole.
+    this->StopListening();
+}
+
+int FramedSocketServer::openListener(){
+    if(socketPath.empty()){
+        return listenTcp(port);
+    }
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(address.sun_path)){
+        LOG_ERROR("Socket path too long: " << socketPath);
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        return -1;
+    }
+    // left behind by a server that did not stop cleanly.
+    unlink(socketPath.c_str());
+    if(bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+       listen(fd, SOMAXCONN) != 0){
+        LOG_ERROR("Cannot listen on " << socketPath << ": " << strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void FramedSocketServer::closedListener(){
+    if(!socketPath.empty()){
+        unlink(socketPath.c_str());
+    }
+}
+
+bool FramedSocketServer::onData(Connection& c){
+    // reused by every request the thread handles.
+    thread_local string request;
+    thread_local string response;
+    const string& in = c.in;
+    size_t pos = 0;
+    while(pos < in.size()){
+        if(framing == LENGTH_PREFIXED){
+            if(in.size() - pos < 4){
+                break;
+            }
+            const unsigned char* p = (const unsigned char*)in.data() + pos;
+            size_t length = (size_t)p[0] << 24 | (size_t)p[1] << 16 |
+                            (size_t)p[2] << 8 | (size_t)p[3];
+            if(length > MAX_FRAME){
+                LOG_WARN("Dropped a connection sending a frame of "
+                         << length << " bytes");
+                return false;
+            }
+            if(in.size() - pos - 4 < length){
+                break;
+            }
+            request.assign(in, pos + 4, length);
+            pos += 4 + length;
+        }else{
+            size_t end = in.find('\n', pos);
+            if(end == string::npos){
+                if(in.size() - pos > MAX_FRAME){
+                    LOG_WARN("Dropped a connection sending a line over "
+                             << MAX_FRAME << " bytes");
+                    return false;
+                }
+                break;
+            }
+            request.assign(in, pos, end - pos);
+            pos = end + 1;
+            if(request.find_first_not_of(" \t\r") == string::npos){
+                continue;
+            }
+        }
+
+        response.clear();
+        if(!this->ProcessRequest(request, response)){
+            return false;
+        }
+        // the handler ends its replies with a newline; frames carry none.
+        size_t last = response.find_last_not_of(" \t\r\n");
+        response.resize(last == string::npos ? 0 : last + 1);
+        if(framing == LENGTH_PREFIXED){
+            uint32_t length = response.size();
+            c.out += (char)(length >> 24);
+            c.out += (char)(length >> 16);
+            c.out += (char)(length >> 8);
+            c.out += (char)length;
+            c.out += response;
+        }else{
+            c.out += response;
+            c.out += '\n';
+        }
+    }
+    c.in.erase(0, pos);
+    return true;
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef FRAMEDSOCKETSERVER_HPP
+#define FRAMEDSOCKETSERVER_HPP
+
+#include <string>
+
+#include "EpollServer.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: JSON-RPC straight over a TCP or Unix domain socket, for
+ * callers on the same host that have no use for HTTP. Each request is
+ * one frame and gets exactly one frame back, in order, empty for a
+ * notification. A frame is either
+ *
+ *     LENGTH_PREFIXED  a 4 byte big endian length, then that many bytes
+ *     NEWLINE          one line of compact json ending in \n
+ *
+ * Connections stay open for any number of requests, which may be sent
+ * without waiting for the replies.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class FramedSocketServer : public EpollServer {
+
+    public:
+
+    enum Framing { LENGTH_PREFIXED, NEWLINE };
+
+    /**
+    * Largest frame accepted; a longer one drops the connection.
+    */
+    static const size_t MAX_FRAME = 64 << 20;
+
+    /**
+    * Listens on TCP.
+    *
+    * @param The port.
+    * @param How requests and replies are framed.
+    * @param How many threads serve connections, 0 for one per cpu.
+    */
+    FramedSocketServer(int port, Framing framing, unsigned threads);
+
+    /**
+    * Listens on a Unix domain socket. A stale socket file at the path is
+    * replaced, and the file is removed again when the server stops.
+    *
+    * @param The path of the socket.
+    * @param How requests and replies are framed.
+    * @param How many threads serve connections, 0 for one per cpu.
+    */
+    FramedSocketServer(const string& socketPath, Framing framing,
+                       unsigned threads);
+    virtual ~FramedSocketServer();
+
+    /**
+    * @param  "length" or "line".
+    * @param  Set to the framing named.
+    * @return False if the name is not a framing.
+    */
+    static bool parseFraming(const string& name, Framing& framing);
+
+    protected:
+
+    virtual int openListener();
+    virtual void closedListener();
+    virtual bool onData(Connection& c);
+
+    private:
+
+    int port;
+    string socketPath;
+    Framing framing;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "Geodesic.hpp"
+#include "Waypoint.hpp"
+#include <cmath>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Distances between positions at three precisions.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+constexpr double Geodesic::FAST_ERROR;
+constexpr double Geodesic::FAST_MAX_KM;
+constexpr double Geodesic::FAST_MAX_LAT;
+constexpr double Geodesic::SPHERE_ERROR;
+constexpr double Geodesic::AXIS_KM;
+constexpr double Geodesic::FLATTENING;
+const int Geodesic::MAX_ITERATIONS;
+
+static const double radians = Waypoint::pi / 180.0;
+
+double Geodesic::distanceKm(Precision precision, double lat1, double lon1,
+                            double lat2, double lon2){
+    switch(precision){
+    case FAST:
+        return fastKm(lat1, lon1, lat2, lon2);
+    case ELLIPSOID:
+        return ellipsoidKm(lat1, lon1, lat2, lon2);
+    default:
+        return sphereKm(lat1, lon1, lat2, lon2);
+    }
+}
+
+/**
+* Equirectangular approximation, the longitude difference taken the short
+* way around.
+*/
+double Geodesic::fastKm(double lat1, double lon1, double lat2, double lon2){
+    double deltaLon = lon2 - lon1;
+    if(deltaLon > 180.0){
+        deltaLon -= 360.0;
+    }else if(deltaLon < -180.0){
+        deltaLon += 360.0;
+    }
+    double x = deltaLon * std::cos((lat1 + lat2) * (0.5 * radians));
+    double y = lat2 - lat1;
+    return Waypoint::radiusE * radians * std::sqrt(x * x + y * y);
+}
+
+double Geodesic::sphereKm(double lat1, double lon1, double lat2, double lon2){
+    return Waypoint::distanceGC(lat1, lon1, lat2, lon2, Waypoint::KMETER);
+}
+
+/**
+* Vincenty's inverse solution on WGS-84, falling back to the sphere when
+* it does not converge.
+*/
+double Geodesic::ellipsoidKm(double lat1, double lon1,
+                             double lat2, double lon2){
+    const double a = AXIS_KM;
+    const double f = FLATTENING;
+    const double b = (1.0 - f) * a;
+    double deltaLon = std::remainder(lon2 - lon1, 360.0) * radians;
+    // reduced latitudes.
+    double u1 = std::atan((1.0 - f) * std::tan(lat1 * radians));
+    double u2 = std::atan((1.0 - f) * std::tan(lat2 * radians));
+    double sinU1 = std::sin(u1), cosU1 = std::cos(u1);
+    double sinU2 = std::sin(u2), cosU2 = std::cos(u2);
+
+    double lambda = deltaLon;
+    double sinSigma = 0, cosSigma = 0, sigma = 0;
+    double cosSqAlpha = 0, cos2SigmaM = 0;
+    int i = 0;
+    for(; i < MAX_ITERATIONS; i++){
+        double sinLambda = std::sin(lambda);
+        double cosLambda = std::cos(lambda);
+        double p = cosU2 * sinLambda;
+        double q = cosU1 * sinU2 - sinU1 * cosU2 * cosLambda;
+        sinSigma = std::sqrt(p * p + q * q);
+        if(sinSigma == 0.0){
+            // the same point.
+            return 0.0;
+        }
+        cosSigma = sinU1 * sinU2 + cosU1 * cosU2 * cosLambda;
+        sigma = std::atan2(sinSigma, cosSigma);
+        double sinAlpha = cosU1 * cosU2 * sinLambda / sinSigma;
+        cosSqAlpha = 1.0 - sinAlpha * sinAlpha;
+        // on the equator cos2SigmaM is not used.
+        cos2SigmaM = cosSqAlpha != 0.0
+                         ? cosSigma - 2.0 * sinU1 * sinU2 / cosSqAlpha
+                         : 0.0;
+        double c = f / 16.0 * cosSqAlpha * (4.0 + f * (4.0 - 3.0 * cosSqAlpha));
+        double previous = lambda;
+        lambda = deltaLon + (1.0 - c) * f * sinAlpha *
+                 (sigma + c * sinSigma *
+                  (cos2SigmaM + c * cosSigma *
+                   (-1.0 + 2.0 * cos2SigmaM * cos2SigmaM)));
+        if(std::fabs(lambda - previous) < 1e-12){
+            break;
+        }
+    }
+    if(i == MAX_ITERATIONS || std::fabs(lambda) > Waypoint::pi){
+        return sphereKm(lat1, lon1, lat2, lon2);
+    }
+    double uSq = cosSqAlpha * (a * a - b * b) / (b * b);
+    double bigA = 1.0 + uSq / 16384.0 *
+                  (4096.0 + uSq * (-768.0 + uSq * (320.0 - 175.0 * uSq)));
+    double bigB = uSq / 1024.0 *
+                  (256.0 + uSq * (-128.0 + uSq * (74.0 - 47.0 * uSq)));
+    double deltaSigma = bigB * sinSigma *
+        (cos2SigmaM + bigB / 4.0 *
+         (cosSigma * (-1.0 + 2.0 * cos2SigmaM * cos2SigmaM) -
+          bigB / 6.0 * cos2SigmaM * (-3.0 + 4.0 * sinSigma * sinSigma) *
+          (-3.0 + 4.0 * cos2SigmaM * cos2SigmaM)));
+    return b * bigA * (sigma - deltaSigma);
+}
+
+bool Geodesic::parse(const string& name, Precision& out){
+    for(int p = FAST; p <= ELLIPSOID; p++){
+        if(name == nameOf((Precision)p)){
+            out = (Precision)p;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* Geodesic::nameOf(Precision precision){
+    switch(precision){
+    case FAST:
+        return "fast";
+    case ELLIPSOID:
+        return "ellipsoid";
+    default:
+        return "sphere";
+    }
+}
+
+/**
+* A position inside is at most reach from the center on the sphere: the
+* radius itself, widened by the error of whichever precision the radius is
+* measured with. Where a position within reach keeps FAST within
+* FAST_ERROR, one whose FAST distance is past reach widened by that error
+* can't be within reach, and is rejected before the costly distance.
+*/
+Geodesic::Circle::Circle(double centerLat, double centerLon, double radiusKm,
+                         Precision aPrecision)
+    : lat(centerLat), lon(centerLon), radius(radiusKm), reach(radiusKm),
+      rejectAbove(0.0), precision(aPrecision){
+    if(precision == ELLIPSOID){
+        reach = radius * (1.0 + SPHERE_ERROR);
+    }else if(precision == FAST){
+        reach = radius * (1.0 + FAST_ERROR);
+    }
+    double kmPerDegree = Waypoint::radiusE * radians;
+    if(precision != FAST && reach <= FAST_MAX_KM &&
+       std::fabs(lat) + reach / kmPerDegree <= FAST_MAX_LAT){
+        rejectAbove = reach * (1.0 + FAST_ERROR);
+    }
+}
+
+bool Geodesic::Circle::contains(double aLat, double aLon,
+                                double& distance) const{
+    if(precision == FAST){
+        distance = fastKm(lat, lon, aLat, aLon);
+        return distance <= radius;
+    }
+    if(rejectAbove > 0.0 && fastKm(lat, lon, aLat, aLon) > rejectAbove){
+        return false;
+    }
+    distance = distanceKm(precision, lat, lon, aLat, aLon);
+    return distance <= radius;
+}
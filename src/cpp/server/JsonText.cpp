@@ -0,0 +1,220 @@
+#include "JsonText.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Writes json text byte for byte the way jsoncpp does.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+static void appendEscape(string& out, unsigned code){
+    static const char HEX[] = "0123456789abcdef";
+    out += "\\u";
+    out += HEX[code >> 12 & 0xF];
+    out += HEX[code >> 8 & 0xF];
+    out += HEX[code >> 4 & 0xF];
+    out += HEX[code & 0xF];
+}
+
+/**
+* Decodes the UTF-8 sequence at p, moving p past it.
+*
+* @return The code point, U+FFFD for a broken sequence.
+*/
+static unsigned decodeUtf8(const char*& p, const char* end){
+    unsigned char lead = *p++;
+    int more = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+    if(more < 0 || end - p < more){
+        return 0xFFFD;
+    }
+    unsigned code = lead & (0x3F >> more);
+    for(int i = 0; i < more; i++){
+        unsigned char next = p[i];
+        if((next & 0xC0) != 0x80){
+            return 0xFFFD;
+        }
+        code = code << 6 | (next & 0x3F);
+    }
+    p += more;
+    return code;
+}
+
+/**
+* Writes a string the way jsoncpp does, with everything outside printable
+* ascii escaped.
+*/
+void JsonText::appendQuoted(string& out, const string& text){
+    appendQuoted(out, text.data(), text.size());
+}
+
+void JsonText::appendQuoted(string& out, const char* text, size_t size){
+    out += '"';
+    const char* p = text;
+    const char* end = p + size;
+    while(p < end){
+        const char* run = p;
+        while(p < end && *p != '"' && *p != '\\' &&
+              (unsigned char)*p >= 0x20 && (unsigned char)*p < 0x80){
+            p++;
+        }
+        out.append(run, p - run);
+        if(p == end){
+            break;
+        }
+        char ch = *p;
+        if((unsigned char)ch >= 0x80){
+            unsigned code = decodeUtf8(p, end);
+            if(code >= 0x10000){
+                code -= 0x10000;
+                appendEscape(out, 0xD800 + (code >> 10));
+                appendEscape(out, 0xDC00 + (code & 0x3FF));
+            }else{
+                appendEscape(out, code);
+            }
+            continue;
+        }
+        p++;
+        switch(ch){
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: appendEscape(out, (unsigned char)ch);
+        }
+    }
+    out += '"';
+}
+
+#ifdef __SIZEOF_INT128__
+/**
+* Writes the same digits as "%.17g" for magnitudes in [1e-3, 2^53), the
+* range coordinates and elevations are in, a good deal faster. The
+* double is an integer times a power of two, so scaled by a power of ten
+* it is exact in 128 bits and can be rounded to 17 digits the way printf
+* rounds it.
+*
+* @return False, writing nothing, outside that range.
+*/
+static bool appendDigits17(string& out, double value){
+    static const uint64_t POW10[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+        10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+        100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+        100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+        100000000000000000ULL, 1000000000000000000ULL,
+        10000000000000000000ULL
+    };
+    double magnitude = std::fabs(value);
+    if(!(magnitude >= 1e-3 && magnitude < 9007199254740992.0)){
+        return false;
+    }
+    int binary;
+    double fraction = std::frexp(magnitude, &binary);
+    uint64_t mantissa = (uint64_t)std::ldexp(fraction, 53);
+    int drop = 53 - binary;
+    int decimal = (int)std::floor(std::log10(magnitude));
+    unsigned __int128 digits = 0;
+    unsigned __int128 rest = 0;
+    unsigned __int128 half = 0;
+    // log10 can be off by one at the powers of ten; the scaled value tells.
+    for(int attempt = 0; ; attempt++){
+        int scale = 16 - decimal;
+        if(attempt > 2 || scale < 0 || scale > 19){
+            return false;
+        }
+        unsigned __int128 product = (unsigned __int128)mantissa * POW10[scale];
+        digits = product >> drop;
+        rest = product - (digits << drop);
+        half = drop > 0 ? (unsigned __int128)1 << (drop - 1) : 0;
+        if(digits >= POW10[17]){
+            decimal++;
+        }else if(digits < POW10[16]){
+            decimal--;
+        }else{
+            break;
+        }
+    }
+    if(drop > 0 && (rest > half || (rest == half && (digits & 1)))){
+        digits++;
+    }
+    if(digits == POW10[17]){
+        digits = POW10[16];
+        decimal++;
+    }
+    char text[17];
+    uint64_t left = (uint64_t)digits;
+    for(int i = 16; i >= 0; i--){
+        text[i] = '0' + left % 10;
+        left /= 10;
+    }
+    int last = 16;
+    while(last > decimal && text[last] == '0'){
+        last--;
+    }
+    if(value < 0){
+        out += '-';
+    }
+    if(decimal < 0){
+        out += "0.";
+        out.append(-decimal - 1, '0');
+        out.append(text, last + 1);
+    }else{
+        out.append(text, decimal + 1);
+        if(last > decimal){
+            out += '.';
+            out.append(text + decimal + 1, last - decimal);
+        }
+    }
+    return true;
+}
+#endif
+
+/**
+* Writes a double the way jsoncpp does: 17 significant digits, and a
+* ".0" on whole numbers so they read back as reals.
+*/
+void JsonText::appendDouble(string& out, double value){
+    if(std::isnan(value)){
+        out += "null";
+        return;
+    }
+    if(std::isinf(value)){
+        out += value < 0 ? "-1e+9999" : "1e+9999";
+        return;
+    }
+    size_t start = out.size();
+#ifdef __SIZEOF_INT128__
+    if(!appendDigits17(out, value))
+#endif
+    {
+        char text[32];
+        int length = snprintf(text, sizeof(text), "%.17g", value);
+        out.append(text, length);
+    }
+    if(out.find_first_of(".e", start) == string::npos){
+        out += ".0";
+    }
+}
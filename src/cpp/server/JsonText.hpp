@@ -0,0 +1,62 @@
+#ifndef JSONTEXT_HPP
+#define JSONTEXT_HPP
+
+#include <string>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Writes json values straight into a string, producing the same
+ * bytes the jsoncpp writers do, so text written here can be mixed with,
+ * cached for, or compared against what the json-rpc handler writes.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class JsonText {
+
+    public:
+
+    /**
+    * Writes a quoted string, with everything outside printable ascii
+    * escaped.
+    *
+    * @param Where the text is appended.
+    * @param The string to write.
+    */
+    static void appendQuoted(string& out, const string& text);
+
+    /**
+    * @param Where the text is appended.
+    * @param The bytes of the string to write.
+    * @param How many there are.
+    */
+    static void appendQuoted(string& out, const char* text, size_t size);
+
+    /**
+    * Writes a double with 17 significant digits, and a ".0" on whole
+    * numbers so they read back as reals.
+    *
+    * @param Where the text is appended.
+    * @param The value to write.
+    */
+    static void appendDouble(string& out, double value);
+};
+
+#endif
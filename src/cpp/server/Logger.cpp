@@ -0,0 +1,157 @@
+#include "Logger.hpp"
+#include <cstdio>
+#include <chrono>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Leveled asynchronous logger.
+ *
+ * The ring is a bounded multi-producer queue: each slot carries a sequence
+ * number telling whether it is free for the producer claiming position
+ * pos (sequence == pos) or holds a message for the consumer
+ * (sequence == pos + 1). Only the writer thread consumes.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+static const char* levelNames[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+Logger& Logger::instance(){
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() : minimum(INFO), sampleEvery(1), sampleCount(0), dropped(0),
+                   running(false), ring(CAPACITY), head(0), tail(0){
+    for(size_t i = 0; i < CAPACITY; i++){
+        ring[i].sequence.store(i, memory_order_relaxed);
+    }
+}
+
+Logger::~Logger(){
+    this->stop();
+}
+
+bool Logger::parseLevel(const string& name, Level& level){
+    const char* names[] = { "debug", "info", "warn", "error", "off" };
+    for(int i = DEBUG; i <= OFF; i++){
+        if(name == names[i]){
+            level = (Level)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Logger::configure(Level level, unsigned every){
+    minimum.store(level, memory_order_relaxed);
+    sampleEvery.store(every == 0 ? 1 : every, memory_order_relaxed);
+}
+
+void Logger::start(){
+    bool expected = false;
+    if(running.compare_exchange_strong(expected, true)){
+        writer = thread([this](){
+            while(running.load(memory_order_acquire)){
+                if(!this->drain()){
+                    this_thread::sleep_for(chrono::milliseconds(5));
+                }
+            }
+        });
+    }
+}
+
+void Logger::stop(){
+    bool expected = true;
+    if(running.compare_exchange_strong(expected, false)){
+        writer.join();
+    }
+    this->drain();
+}
+
+bool Logger::sampled(){
+    unsigned every = sampleEvery.load(memory_order_relaxed);
+    return every <= 1 ||
+           sampleCount.fetch_add(1, memory_order_relaxed) % every == 0;
+}
+
+void Logger::log(Level level, string message){
+    size_t pos = tail.load(memory_order_relaxed);
+    Slot* slot;
+    while(true){
+        slot = &ring[pos % CAPACITY];
+        size_t sequence = slot->sequence.load(memory_order_acquire);
+        if(sequence == pos){
+            if(tail.compare_exchange_weak(pos, pos + 1,
+                                          memory_order_relaxed)){
+                break;
+            }
+        }else if(sequence < pos){
+            // the writer has not caught up with a full ring yet.
+            dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }else{
+            pos = tail.load(memory_order_relaxed);
+        }
+    }
+    slot->level = level;
+    slot->message.swap(message);
+    slot->sequence.store(pos + 1, memory_order_release);
+}
+
+/**
+* Takes the oldest queued message, if any. Only called by one thread.
+*/
+bool Logger::take(Level& level, string& message){
+    size_t pos = head.load(memory_order_relaxed);
+    Slot& slot = ring[pos % CAPACITY];
+    if(slot.sequence.load(memory_order_acquire) != pos + 1){
+        return false;
+    }
+    head.store(pos + 1, memory_order_relaxed);
+    level = slot.level;
+    message.swap(slot.message);
+    slot.message.clear();
+    slot.sequence.store(pos + CAPACITY, memory_order_release);
+    return true;
+}
+
+/**
+* Writes out everything queued and flushes once.
+*
+* @return True if anything was written.
+*/
+bool Logger::drain(){
+    Level level;
+    string message;
+    bool wrote = false;
+    while(this->take(level, message)){
+        fprintf(stdout, "%s %s\n", levelNames[level], message.c_str());
+        wrote = true;
+    }
+    size_t lost = dropped.exchange(0, memory_order_relaxed);
+    if(lost > 0){
+        fprintf(stdout, "WARN logger dropped %zu messages\n", lost);
+        wrote = true;
+    }
+    if(wrote){
+        fflush(stdout);
+    }
+    return wrote;
+}
@@ -0,0 +1,151 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <string>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Leveled asynchronous logger. Request threads only format their
+ * message and drop it into a fixed size lock-free ring; a background
+ * thread drains the ring to standard output and flushes once per batch
+ * rather than once per line. When the ring is full messages are counted
+ * and dropped instead of making a request wait on the console.
+ *
+ * Use the LOG_* macros, which skip formatting entirely when the level is
+ * filtered out. LOG_SAMPLED keeps only one out of every N messages, for
+ * the lines written on every request.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class Logger {
+
+    public:
+
+    enum Level { DEBUG = 0, INFO = 1, WARN = 2, ERROR = 3, OFF = 4 };
+
+    /**
+    * @return The process wide logger.
+    */
+    static Logger& instance();
+
+    /**
+    * Parses a level name such as "info".
+    *
+    * @param  The level name.
+    * @param  Set to the level when the name is known.
+    * @return True if the name is a level, false if not.
+    */
+    static bool parseLevel(const string& name, Level& level);
+
+    /**
+    * Sets which messages are kept.
+    *
+    * @param The lowest level that is written.
+    * @param Keep one out of this many sampled messages, 1 keeps all.
+    */
+    void configure(Level minimum, unsigned sampleEvery);
+
+    /**
+    * Starts the thread that writes the messages out.
+    */
+    void start();
+
+    /**
+    * Writes out whatever is still queued and stops the writer thread.
+    */
+    void stop();
+
+    bool enabled(Level level) const {
+        return level >= minimum.load(memory_order_relaxed);
+    }
+
+    /**
+    * @return True for one out of every sampleEvery calls.
+    */
+    bool sampled();
+
+    /**
+    * Queues a message for the writer thread.
+    *
+    * @param The level of the message.
+    * @param The message, without a trailing newline.
+    */
+    void log(Level level, string message);
+
+    private:
+
+    static const size_t CAPACITY = 8192;
+
+    struct Slot {
+        atomic<size_t> sequence;
+        Level level;
+        string message;
+    };
+
+    Logger();
+    ~Logger();
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    bool take(Level& level, string& message);
+    bool drain();
+
+    atomic<int> minimum;
+    atomic<unsigned> sampleEvery;
+    atomic<unsigned> sampleCount;
+    atomic<size_t> dropped;
+    atomic<bool> running;
+
+    vector<Slot> ring;
+    atomic<size_t> head;
+    atomic<size_t> tail;
+    thread writer;
+};
+
+#define LOG_AT(level, expr) \
+    do { \
+        if (Logger::instance().enabled(level)) { \
+            ostringstream logStream; \
+            logStream << expr; \
+            Logger::instance().log(level, logStream.str()); \
+        } \
+    } while (0)
+
+#define LOG_SAMPLED(level, expr) \
+    do { \
+        if (Logger::instance().enabled(level) && \
+            Logger::instance().sampled()) { \
+            ostringstream logStream; \
+            logStream << expr; \
+            Logger::instance().log(level, logStream.str()); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(expr) LOG_AT(Logger::DEBUG, expr)
+#define LOG_INFO(expr) LOG_AT(Logger::INFO, expr)
+#define LOG_WARN(expr) LOG_AT(Logger::WARN, expr)
+#define LOG_ERROR(expr) LOG_AT(Logger::ERROR, expr)
+
+#endif
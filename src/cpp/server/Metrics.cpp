@@ -0,0 +1,296 @@
+#include "Metrics.hpp"
+
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Per-thread counters and latency histograms of the server.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+const uint64_t Metrics::BOUNDS[BUCKETS] = {
+    10000ULL, 25000ULL, 50000ULL, 100000ULL, 250000ULL, 500000ULL,
+    1000000ULL, 2500000ULL, 5000000ULL, 10000000ULL, 25000000ULL,
+    50000000ULL, 100000000ULL, 250000000ULL, 500000000ULL, 1000000000ULL,
+    2500000000ULL, 5000000000ULL, 10000000000ULL
+};
+
+/**
+* How the metrics of each kind of series are named.
+*/
+static const struct {
+    const char* prefix;
+    const char* label;
+    const char* count;
+    const char* what;
+} KIND_NAMES[Metrics::KINDS] = {
+    { "waypoint_rpc", "method", "calls", "RPC calls" },
+    { "waypoint_persistence", "operation", "operations",
+      "persistence operations" }
+};
+
+/**
+* Gives the block of a thread back when the thread ends.
+*/
+struct BlockHolder {
+    Metrics::Block* block;
+    BlockHolder() : block(NULL) {}
+    ~BlockHolder(){
+        if(block != NULL){
+            Metrics::instance().release(block);
+        }
+    }
+};
+
+static thread_local BlockHolder holder;
+
+/**
+* Each thread keeps the series it has looked up, so a lookup only takes
+* the lock the first time.
+*/
+static thread_local unordered_map<string, int> known[Metrics::KINDS];
+
+/**
+* Only the thread owning a block writes it, so there is nothing to
+* race with but the scrape reading it.
+*/
+static inline void add(atomic<uint64_t>& counter, uint64_t value){
+    counter.store(counter.load(memory_order_relaxed) + value,
+                  memory_order_relaxed);
+}
+
+Metrics& Metrics::instance(){
+    static Metrics metrics;
+    return metrics;
+}
+
+int Metrics::series(Kind kind, const string& name){
+    unordered_map<string, int>::iterator found = known[kind].find(name);
+    if(found != known[kind].end()){
+        return found->second;
+    }
+    int id = -1;
+    {
+        lock_guard<mutex> guard(lock);
+        for(size_t i = 0; i < names.size() && id < 0; i++){
+            if(kinds[i] == kind && names[i] == name){
+                id = i;
+            }
+        }
+        if(id < 0 && names.size() < (size_t)MAX_SERIES){
+            id = names.size();
+            kinds.push_back(kind);
+            names.push_back(name);
+        }
+    }
+    known[kind][name] = id;
+    return id;
+}
+
+Metrics::Block& Metrics::block(){
+    if(holder.block == NULL){
+        lock_guard<mutex> guard(lock);
+        if(idle.empty()){
+            // value initialized, so every count starts at zero.
+            holder.block = new Block();
+            blocks.push_back(holder.block);
+        }else{
+            holder.block = idle.back();
+            idle.pop_back();
+        }
+    }
+    return *holder.block;
+}
+
+void Metrics::release(Block* block){
+    lock_guard<mutex> guard(lock);
+    idle.push_back(block);
+}
+
+void Metrics::begin(int series){
+    if(series >= 0){
+        add(this->block().cells[series].started, 1);
+    }
+}
+
+void Metrics::end(int series, uint64_t nanos, bool failed){
+    if(series < 0){
+        return;
+    }
+    Cell& cell = this->block().cells[series];
+    int bucket = 0;
+    while(bucket < BUCKETS && nanos > BOUNDS[bucket]){
+        bucket++;
+    }
+    add(cell.buckets[bucket], 1);
+    add(cell.nanos, nanos);
+    if(failed){
+        add(cell.failed, 1);
+    }
+    add(cell.finished, 1);
+}
+
+Metrics::Call::Call(Kind kind, const string& name)
+    : id(Metrics::instance().series(kind, name)), failed(true),
+      start(chrono::steady_clock::now()){
+    Metrics::instance().begin(id);
+}
+
+Metrics::Call::Call(int series)
+    : id(series), failed(true), start(chrono::steady_clock::now()){
+    Metrics::instance().begin(id);
+}
+
+Metrics::Call::~Call(){
+    uint64_t nanos = chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - start).count();
+    Metrics::instance().end(id, nanos, failed);
+}
+
+void Metrics::addReading(const string& name, const string& type,
+                         const string& help, const function<double()>& read){
+    lock_guard<mutex> guard(lock);
+    Reading reading;
+    reading.name = name;
+    reading.type = type;
+    reading.help = help;
+    reading.read = read;
+    readings.push_back(reading);
+}
+
+/**
+* Writes a number in as few digits as read back the same, so the bucket
+* bounds come out as 1e-05 rather than 1.0000000000000001e-05.
+*/
+static void appendNumber(string& out, double value){
+    char text[32];
+    snprintf(text, sizeof(text), "%.15g", value);
+    if(strtod(text, NULL) != value){
+        snprintf(text, sizeof(text), "%.17g", value);
+    }
+    out += text;
+}
+
+void Metrics::render(string& out){
+    lock_guard<mutex> guard(lock);
+    // the sums of every block, per series.
+    size_t count = names.size();
+    vector<uint64_t> started(count, 0);
+    vector<uint64_t> finished(count, 0);
+    vector<uint64_t> failed(count, 0);
+    vector<uint64_t> nanos(count, 0);
+    vector<uint64_t> buckets(count * (BUCKETS + 1), 0);
+    for(size_t b = 0; b < blocks.size(); b++){
+        for(size_t s = 0; s < count; s++){
+            Cell& cell = blocks[b]->cells[s];
+            finished[s] += cell.finished.load(memory_order_relaxed);
+            started[s] += cell.started.load(memory_order_relaxed);
+            failed[s] += cell.failed.load(memory_order_relaxed);
+            nanos[s] += cell.nanos.load(memory_order_relaxed);
+            for(int k = 0; k <= BUCKETS; k++){
+                buckets[s * (BUCKETS + 1) + k] +=
+                    cell.buckets[k].load(memory_order_relaxed);
+            }
+        }
+    }
+
+    for(int kind = 0; kind < KINDS; kind++){
+        string prefix = KIND_NAMES[kind].prefix;
+        string label = string("{") + KIND_NAMES[kind].label + "=\"";
+        string what = KIND_NAMES[kind].what;
+        bool any = false;
+        for(size_t s = 0; s < count && !any; s++){
+            any = kinds[s] == kind;
+        }
+        if(!any){
+            continue;
+        }
+
+        string name = prefix + "_" + KIND_NAMES[kind].count + "_total";
+        out += "# HELP " + name + " " + what + " finished.\n";
+        out += "# TYPE " + name + " counter\n";
+        for(size_t s = 0; s < count; s++){
+            if(kinds[s] == kind){
+                out += name + label + names[s] + "\"} " +
+                       to_string(finished[s]) + "\n";
+            }
+        }
+
+        name = prefix + "_errors_total";
+        out += "# HELP " + name + " " + what + " that failed.\n";
+        out += "# TYPE " + name + " counter\n";
+        for(size_t s = 0; s < count; s++){
+            if(kinds[s] == kind){
+                out += name + label + names[s] + "\"} " +
+                       to_string(failed[s]) + "\n";
+            }
+        }
+
+        name = prefix + "_in_flight";
+        out += "# HELP " + name + " " + what + " started and not finished.\n";
+        out += "# TYPE " + name + " gauge\n";
+        for(size_t s = 0; s < count; s++){
+            if(kinds[s] == kind){
+                // the two are read apart, so a call may look finished
+                // before it looks started.
+                uint64_t running = started[s] > finished[s]
+                                   ? started[s] - finished[s] : 0;
+                out += name + label + names[s] + "\"} " +
+                       to_string(running) + "\n";
+            }
+        }
+
+        name = prefix + "_duration_seconds";
+        out += "# HELP " + name + " How long " + what + " took.\n";
+        out += "# TYPE " + name + " histogram\n";
+        for(size_t s = 0; s < count; s++){
+            if(kinds[s] != kind){
+                continue;
+            }
+            string series = label + names[s] + "\"";
+            uint64_t cumulative = 0;
+            for(int k = 0; k <= BUCKETS; k++){
+                cumulative += buckets[s * (BUCKETS + 1) + k];
+                out += name + "_bucket" + series + ",le=\"";
+                if(k < BUCKETS){
+                    appendNumber(out, BOUNDS[k] / 1e9);
+                }else{
+                    out += "+Inf";
+                }
+                out += "\"} " + to_string(cumulative) + "\n";
+            }
+            out += name + "_sum" + series + "} ";
+            appendNumber(out, nanos[s] / 1e9);
+            out += "\n" + name + "_count" + series + "} " +
+                   to_string(cumulative) + "\n";
+        }
+    }
+
+    for(size_t r = 0; r < readings.size(); r++){
+        const Reading& reading = readings[r];
+        out += "# HELP " + reading.name + " " + reading.help + "\n";
+        out += "# TYPE " + reading.name + " " + reading.type + "\n";
+        out += reading.name + " ";
+        appendNumber(out, reading.read());
+        out += "\n";
+    }
+}
@@ -0,0 +1,182 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Counts and times what the server does, for a Prometheus
+ * scrape. Every RPC method and every persistence operation is a series
+ * with a call count, an error count, the number in flight and a latency
+ * histogram:
+ *
+ *     {
+ *         Metrics::Call call(Metrics::METHOD, "get");
+ *         ...
+ *         call.succeeded();
+ *     }
+ *
+ * Each thread counts in a block of its own that no other thread writes,
+ * so counting is a few plain stores with no lock and no shared cache
+ * line; the blocks are only added up when render is called for a scrape.
+ * Other values, such as the size of the library, are read by functions
+ * registered with addReading, also only when rendered.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class Metrics {
+
+    public:
+
+    /**
+    * What a series counts, which names its metrics.
+    */
+    enum Kind { METHOD, PERSISTENCE, KINDS };
+
+    /**
+    * How many series there can be; later ones are not counted.
+    */
+    static const int MAX_SERIES = 64;
+
+    /**
+    * The upper bounds of the histogram buckets, in nanoseconds, from 10
+    * microseconds to 10 seconds; a last bucket takes everything above.
+    */
+    static const int BUCKETS = 19;
+    static const uint64_t BOUNDS[BUCKETS];
+
+    static Metrics& instance();
+
+    /**
+    * Finds the series of a name, adding it the first time.
+    *
+    * @param  What the series counts.
+    * @param  The method or operation name.
+    * @return The series, or -1 once MAX_SERIES are taken.
+    */
+    int series(Kind kind, const string& name);
+
+    /**
+    * Counts a call as started, on the block of the calling thread.
+    */
+    void begin(int series);
+
+    /**
+    * Counts a call started by begin on this same thread as finished.
+    *
+    * @param The series.
+    * @param How long the call took.
+    * @param True if it failed.
+    */
+    void end(int series, uint64_t nanos, bool failed);
+
+    /**
+    * Counts and times one call for as long as it is in scope. The call
+    * is counted as an error unless succeeded is called before the end
+    * of the scope, so an exception counts as one. A hot path can look
+    * its series up once and pass that instead of the name.
+    */
+    class Call {
+        public:
+        Call(Kind kind, const string& name);
+        explicit Call(int series);
+        ~Call();
+        void succeeded() { failed = false; }
+        private:
+        int id;
+        bool failed;
+        chrono::steady_clock::time_point start;
+        Call(const Call&) = delete;
+        Call& operator=(const Call&) = delete;
+    };
+
+    /**
+    * Adds a value read at every scrape.
+    *
+    * @param The metric name.
+    * @param "gauge" or "counter".
+    * @param The help line.
+    * @param Reads the value; called from the scraping thread.
+    */
+    void addReading(const string& name, const string& type,
+                    const string& help, const function<double()>& read);
+
+    /**
+    * Writes every metric in the Prometheus text format, version 0.0.4.
+    *
+    * @param Where the text is appended.
+    */
+    void render(string& out);
+
+    private:
+
+    struct Cell {
+        atomic<uint64_t> started;
+        atomic<uint64_t> finished;
+        atomic<uint64_t> failed;
+        atomic<uint64_t> nanos;
+        atomic<uint64_t> buckets[BUCKETS + 1];
+    };
+
+    /**
+    * The counts of one thread. A thread that ends hands its block to the
+    * next thread that starts counting, so blocks are never lost and the
+    * totals never go down.
+    */
+    struct Block {
+        Cell cells[MAX_SERIES];
+    };
+
+    struct Reading {
+        string name;
+        string type;
+        string help;
+        function<double()> read;
+    };
+
+    /**
+    * Guards everything below; taken when a series or thread is new and
+    * on a scrape.
+    */
+    mutex lock;
+    vector<Kind> kinds;
+    vector<string> names;
+    vector<Block*> blocks;
+    vector<Block*> idle;
+    vector<Reading> readings;
+
+    Metrics() {}
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    Block& block();
+    void release(Block* block);
+
+    friend struct BlockHolder;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "MetricsServer.hpp"
+
+#ifdef __linux__
+
+#include "Metrics.hpp"
+#include "Logger.hpp"
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: The Prometheus scrape endpoint.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+MetricsServer::MetricsServer(int port) : EpollServer(1), port(port){
+}
+
+MetricsServer::~MetricsServer(){
+    // the thread calls back into this object, stop it while it is whole.
+    this->StopListening();
+}
+
+int MetricsServer::openListener(){
+    return listenTcp(port);
+}
+
+void MetricsServer::reply(Connection& c, int status, const string& body){
+    string& out = c.out;
+    out += "HTTP/1.1 ";
+    out += to_string(status);
+    switch(status){
+        case 200: out += " OK"; break;
+        case 405: out += " Method Not Allowed"; break;
+        default: out += " Request Header Fields Too Large"; break;
+    }
+    out += "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8"
+           "\r\nContent-Length: ";
+    out += to_string(body.size());
+    out += "\r\nConnection: close\r\n\r\n";
+    out += body;
+}
+
+bool MetricsServer::onData(Connection& c){
+    if(c.closeAfter){
+        return true;
+    }
+    size_t headerEnd = c.in.find("\r\n\r\n");
+    if(headerEnd == string::npos){
+        if(c.in.size() > MAX_HEADER){
+            c.closeAfter = true;
+            this->reply(c, 431, "");
+        }
+        return true;
+    }
+    // a scrape is one request, so whatever follows it is not read.
+    c.closeAfter = true;
+    if(c.in.compare(0, 4, "GET ") == 0){
+        string body;
+        Metrics::instance().render(body);
+        this->reply(c, 200, body);
+    }else{
+        LOG_DEBUG("Refused " << c.in.substr(0, c.in.find(' '))
+                  << " request for metrics");
+        this->reply(c, 405, "");
+    }
+    c.in.clear();
+    return true;
+}
+
+#endif
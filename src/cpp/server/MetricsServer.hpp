@@ -0,0 +1,63 @@
+#ifndef METRICSSERVER_HPP
+#define METRICSSERVER_HPP
+
+#include <string>
+
+#include "EpollServer.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: The Prometheus scrape endpoint, on a port of its own so a
+ * scrape never waits behind RPC traffic. Every GET, whatever its path,
+ * is answered with Metrics rendered in the text format and the
+ * connection is closed; other methods get 405. It runs on the epoll
+ * connector with a single thread and never dispatches JSON-RPC.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class MetricsServer : public EpollServer {
+
+    public:
+
+    /**
+    * Largest request header accepted.
+    */
+    static const size_t MAX_HEADER = 16 << 10;
+
+    /**
+    * @param The port to listen on.
+    */
+    MetricsServer(int port);
+    virtual ~MetricsServer();
+
+    protected:
+
+    virtual int openListener();
+    virtual bool onData(Connection& c);
+
+    private:
+
+    int port;
+
+    void reply(Connection& c, int status, const string& body);
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "RequestDispatcher.hpp"
+#include <vector>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Parallel dispatch of JSON-RPC 2.0 batches.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+static const char* READ_ONLY[] = {
+    "serviceInfo", "get", "getNames", "distanceAndBearing", "nearest",
+    "nearestTo", "withinRadius", "distanceMatrix", "getNamesPage",
+    "listWaypoints", "searchNames", "searchAddress", "searchAddressWithin"
+};
+
+RequestDispatcher::RequestDispatcher(jsonrpc::IClientConnectionHandler& inner,
+                                     WorkerPool& pool, TypedMethods* typed)
+    : inner(inner), pool(pool), typed(typed){
+}
+
+bool RequestDispatcher::isReadOnly(const string& method){
+    for(size_t i = 0; i < sizeof(READ_ONLY) / sizeof(READ_ONLY[0]); i++){
+        if(method == READ_ONLY[i]){
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isReadOnlyCall(const Json::Value& call){
+    return call.isObject() && call["method"].isString() &&
+           RequestDispatcher::isReadOnly(call["method"].asString());
+}
+
+void RequestDispatcher::HandleRequest(const std::string& request,
+                                      std::string& retValue){
+    // only a batch is parsed here; anything else, including a batch that
+    // does not parse, is left to the handler and its error replies.
+    size_t first = request.find_first_not_of(" \t\r\n");
+    if(first == string::npos || request[first] != '['){
+        this->handleCall(request, retValue);
+        return;
+    }
+    Json::Value batch;
+    Json::Reader reader;
+    if(!reader.parse(request, batch) || !batch.isArray() || batch.empty()){
+        inner.HandleRequest(request, retValue);
+        return;
+    }
+    this->handleBatch(batch, retValue);
+}
+
+void RequestDispatcher::handleCall(const string& request, string& retValue){
+    if(typed == NULL || !typed->handle(request, retValue)){
+        inner.HandleRequest(request, retValue);
+    }
+}
+
+void RequestDispatcher::handleBatch(const Json::Value& batch,
+                                    std::string& retValue){
+    Json::ArrayIndex count = batch.size();
+    vector<string> calls(count);
+    vector<string> replies(count);
+    Json::FastWriter writer;
+    for(Json::ArrayIndex i = 0; i < count; i++){
+        calls[i] = writer.write(batch[i]);
+    }
+
+    Json::ArrayIndex i = 0;
+    while(i < count){
+        if(!isReadOnlyCall(batch[i])){
+            this->handleCall(calls[i], replies[i]);
+            i++;
+            continue;
+        }
+        Json::ArrayIndex end = i + 1;
+        while(end < count && isReadOnlyCall(batch[end])){
+            end++;
+        }
+        Json::ArrayIndex begin = i;
+        pool.parallelFor(end - begin, [&](size_t k){
+            this->handleCall(calls[begin + k], replies[begin + k]);
+        });
+        i = end;
+    }
+
+    retValue.clear();
+    for(Json::ArrayIndex r = 0; r < count; r++){
+        string& reply = replies[r];
+        size_t last = reply.find_last_not_of(" \t\r\n");
+        if(last == string::npos){
+            continue;
+        }
+        retValue += retValue.empty() ? '[' : ',';
+        retValue.append(reply, 0, last + 1);
+    }
+    if(!retValue.empty()){
+        retValue += "]\n";
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef REQUESTDISPATCHER_HPP
+#define REQUESTDISPATCHER_HPP
+
+#include <string>
+#include <jsonrpccpp/server.h>
+#include <json/json.h>
+
+#include "WorkerPool.hpp"
+#include "TypedMethods.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Sits between the connector and the json-rpc handler of the
+ * server and spreads JSON-RPC 2.0 batches over a worker pool. Single
+ * calls go straight through. In a batch, every run of consecutive read
+ * only calls is handled in parallel, while a call that changes the
+ * library runs alone, after everything before it and before everything
+ * after it, so a batch still behaves as if it ran in order. The replies
+ * are put back together in the order of the calls; notifications get
+ * none.
+ *
+ * Calls the TypedMethods know, alone or inside a batch, are answered by
+ * them and never reach the handler.
+ *
+ * Install it with connector.SetHandler(&dispatcher) once the server has
+ * registered its own handler with the connector.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class RequestDispatcher : public jsonrpc::IClientConnectionHandler {
+
+    public:
+
+    /**
+    * @param The handler the connector had, which runs each call.
+    * @param The threads batches are spread over.
+    * @param The typed fast path to try first, or NULL for none.
+    */
+    RequestDispatcher(jsonrpc::IClientConnectionHandler& inner,
+                      WorkerPool& pool, TypedMethods* typed = NULL);
+
+    virtual void HandleRequest(const std::string& request,
+                               std::string& retValue);
+
+    /**
+    * @param  A method name.
+    * @return True if the method never changes the library.
+    */
+    static bool isReadOnly(const string& method);
+
+    private:
+
+    jsonrpc::IClientConnectionHandler& inner;
+    WorkerPool& pool;
+    TypedMethods* typed;
+
+    void handleCall(const string& request, string& retValue);
+    void handleBatch(const Json::Value& batch, std::string& retValue);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "StringArena.hpp"
+#include <algorithm>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Append only storage for the names and addresses of a shard.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+const size_t StringArena::FIRST_BLOCK;
+const size_t StringArena::LARGEST_BLOCK;
+
+/**
+* 64 bit FNV-1a. Not the hash that picks the shard, so the names of a
+* shard still spread over the buckets of its index.
+*/
+size_t StringArena::Hash::operator()(const Text& text) const{
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < text.size; i++){
+        hash ^= (unsigned char)text.data[i];
+        hash *= 1099511628211ULL;
+    }
+    return (size_t)hash;
+}
+
+StringArena::Text StringArena::add(const Text& text){
+    if(text.size == 0){
+        return Text();
+    }
+    if(room - used < text.size){
+        size_t size = blocks.empty() ? FIRST_BLOCK
+                                     : std::min(room * 2, LARGEST_BLOCK);
+        // a string larger than a block gets one of its own.
+        size = std::max(size, text.size);
+        blocks.push_back(unique_ptr<char[]>(new char[size]));
+        used = 0;
+        room = size;
+        sizes += size;
+    }
+    char* at = blocks.back().get() + used;
+    memcpy(at, text.data, text.size);
+    used += text.size;
+    live += text.size;
+    return Text(at, text.size);
+}
+
+void StringArena::reserve(size_t bytes){
+    if(room - used >= bytes){
+        return;
+    }
+    blocks.push_back(unique_ptr<char[]>(new char[bytes]));
+    used = 0;
+    room = bytes;
+    sizes += bytes;
+}
+
+void StringArena::clear(){
+    blocks.clear();
+    used = room = live = dead = sizes = 0;
+}
+
+void StringArena::swap(StringArena& other){
+    blocks.swap(other.blocks);
+    std::swap(used, other.used);
+    std::swap(room, other.room);
+    std::swap(live, other.live);
+    std::swap(dead, other.dead);
+    std::swap(sizes, other.sizes);
+}
@@ -0,0 +1,142 @@
+#ifndef STRINGARENA_HPP
+#define STRINGARENA_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Append only storage for the names and addresses of a shard.
+ * Strings are copied end to end into large blocks, so storing one costs
+ * no allocation of its own, and a Text pointing at it stays valid until
+ * the arena is cleared; blocks never move, not even when the arena is
+ * swapped.
+ *
+ * Nothing is freed one string at a time. A string that is no longer used
+ * is only counted as dead with drop, and the owner copies the live ones
+ * to a fresh arena once the dead outweigh them (see WaypointShard).
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class StringArena {
+
+    public:
+
+    /**
+    * The first block is small so a small shard stays small; each next
+    * one doubles up to the largest size.
+    */
+    static const size_t FIRST_BLOCK = 1 << 10;
+    static const size_t LARGEST_BLOCK = 256 << 10;
+
+    /**
+    * A string held by an arena, or any other bytes that outlive it, such
+    * as those of a string being looked up. Compared by content.
+    */
+    struct Text {
+        const char* data;
+        size_t size;
+
+        Text() : data(""), size(0) {}
+        Text(const char* data, size_t size) : data(data), size(size) {}
+        explicit Text(const string& text)
+            : data(text.data()), size(text.size()) {}
+
+        string str() const { return string(data, size); }
+
+        bool operator==(const Text& other) const {
+            return size == other.size && memcmp(data, other.data, size) == 0;
+        }
+        bool operator!=(const Text& other) const { return !(*this == other); }
+    };
+
+    /**
+    * Hashes the bytes of a Text, for the name index.
+    */
+    struct Hash {
+        size_t operator()(const Text& text) const;
+    };
+
+    StringArena() : used(0), room(0), live(0), dead(0), sizes(0) {}
+
+    /**
+    * Copies a string into the arena.
+    *
+    * @param  The string to copy.
+    * @return Where the copy is held.
+    */
+    Text add(const Text& text);
+    Text add(const string& text) { return this->add(Text(text)); }
+
+    /**
+    * Makes sure the next strings added, up to a number of bytes in all,
+    * fit in one block, for bulk loads.
+    *
+    * @param How many bytes are about to be added.
+    */
+    void reserve(size_t bytes);
+
+    /**
+    * Counts a string of the arena as no longer used.
+    */
+    void drop(const Text& text) { live -= text.size; dead += text.size; }
+
+    /**
+    * @return Bytes of the strings in use.
+    */
+    size_t liveBytes() const { return live; }
+
+    /**
+    * @return Bytes of the strings dropped, held until the arena is cleared.
+    */
+    size_t deadBytes() const { return dead; }
+
+    /**
+    * @return Bytes of every block, used or not.
+    */
+    size_t blockBytes() const { return sizes; }
+
+    /**
+    * Frees every block; every Text of the arena is left dangling.
+    */
+    void clear();
+
+    /**
+    * Exchanges the blocks of two arenas, the Texts of each stay valid.
+    */
+    void swap(StringArena& other);
+
+    private:
+
+    vector<unique_ptr<char[]> > blocks;
+    // how much of the last block is taken, and its size.
+    size_t used;
+    size_t room;
+    size_t live;
+    size_t dead;
+    size_t sizes;
+};
+
+#endif
@@ -0,0 +1,544 @@
+#include "TypedMethods.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+#include "Logger.hpp"
+#include "Metrics.hpp"
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Typed dispatch of the hot library methods, without Json::Value.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+// deeper requests are left to the handler rather than recursed into.
+static const int MAX_DEPTH = 64;
+
+/**
+* A position in the request being scanned.
+*/
+struct JsonCursor {
+    const char* p;
+    const char* end;
+};
+
+/**
+* A piece of the request, not copied out.
+*/
+struct JsonSlice {
+    const char* begin;
+    const char* end;
+};
+
+static void skipSpace(JsonCursor& c){
+    while(c.p < c.end &&
+          (*c.p == ' ' || *c.p == '\t' || *c.p == '\n' || *c.p == '\r')){
+        c.p++;
+    }
+}
+
+/**
+* Consumes ch, after any white space.
+*
+* @return False, consuming nothing but white space, if ch is not next.
+*/
+static bool expect(JsonCursor& c, char ch){
+    skipSpace(c);
+    if(c.p < c.end && *c.p == ch){
+        c.p++;
+        return true;
+    }
+    return false;
+}
+
+static bool isDigit(char ch){
+    return ch >= '0' && ch <= '9';
+}
+
+/**
+* Consumes a string, leaving body on what is between the quotes, still
+* escaped.
+*
+* @return False if there is no well formed string next.
+*/
+static bool scanString(JsonCursor& c, JsonSlice& body, bool& escaped){
+    skipSpace(c);
+    if(c.p >= c.end || *c.p != '"'){
+        return false;
+    }
+    body.begin = ++c.p;
+    escaped = false;
+    while(c.p < c.end){
+        char ch = *c.p;
+        if(ch == '"'){
+            body.end = c.p++;
+            return true;
+        }
+        if(ch == '\\'){
+            escaped = true;
+            c.p += 2;
+            continue;
+        }
+        if((unsigned char)ch < 0x20){
+            return false;
+        }
+        c.p++;
+    }
+    return false;
+}
+
+/**
+* Consumes a number, checked against the json grammar, which is stricter
+* than strtod.
+*/
+static bool scanNumber(JsonCursor& c, double& value){
+    const char* p = c.p;
+    const char* end = c.end;
+    if(p < end && *p == '-'){
+        p++;
+    }
+    if(p < end && *p == '0'){
+        p++;
+    }else if(p < end && isDigit(*p)){
+        while(p < end && isDigit(*p)){
+            p++;
+        }
+    }else{
+        return false;
+    }
+    if(p < end && *p == '.'){
+        if(++p >= end || !isDigit(*p)){
+            return false;
+        }
+        while(p < end && isDigit(*p)){
+            p++;
+        }
+    }
+    if(p < end && (*p == 'e' || *p == 'E')){
+        if(++p < end && (*p == '+' || *p == '-')){
+            p++;
+        }
+        if(p >= end || !isDigit(*p)){
+            return false;
+        }
+        while(p < end && isDigit(*p)){
+            p++;
+        }
+    }
+    // strtod needs a terminated string; numbers are short, copy it.
+    char text[64];
+    size_t length = p - c.p;
+    if(length >= sizeof(text)){
+        return false;
+    }
+    memcpy(text, c.p, length);
+    text[length] = '\0';
+    value = strtod(text, NULL);
+    c.p = p;
+    return true;
+}
+
+static bool skipValue(JsonCursor& c, int depth){
+    skipSpace(c);
+    if(c.p >= c.end || depth > MAX_DEPTH){
+        return false;
+    }
+    char ch = *c.p;
+    if(ch == '"'){
+        JsonSlice body;
+        bool escaped;
+        return scanString(c, body, escaped);
+    }
+    if(ch == '{' || ch == '['){
+        char close = ch == '{' ? '}' : ']';
+        c.p++;
+        if(expect(c, close)){
+            return true;
+        }
+        do{
+            JsonSlice key;
+            bool escaped;
+            if(ch == '{' && (!scanString(c, key, escaped) || !expect(c, ':'))){
+                return false;
+            }
+            if(!skipValue(c, depth + 1)){
+                return false;
+            }
+        }while(expect(c, ','));
+        return expect(c, close);
+    }
+    if(ch == '-' || isDigit(ch)){
+        double value;
+        return scanNumber(c, value);
+    }
+    static const char* LITERALS[] = {"true", "false", "null"};
+    for(size_t i = 0; i < 3; i++){
+        size_t length = strlen(LITERALS[i]);
+        if((size_t)(c.end - c.p) >= length &&
+           memcmp(c.p, LITERALS[i], length) == 0){
+            c.p += length;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool is(const JsonSlice& slice, const char* text){
+    size_t length = strlen(text);
+    return (size_t)(slice.end - slice.begin) == length &&
+           memcmp(slice.begin, text, length) == 0;
+}
+
+static bool hex4(const char* p, const char* end, unsigned& value){
+    if(end - p < 4){
+        return false;
+    }
+    value = 0;
+    for(int i = 0; i < 4; i++){
+        char ch = p[i];
+        value <<= 4;
+        if(isDigit(ch)){
+            value |= ch - '0';
+        }else if(ch >= 'a' && ch <= 'f'){
+            value |= ch - 'a' + 10;
+        }else if(ch >= 'A' && ch <= 'F'){
+            value |= ch - 'A' + 10;
+        }else{
+            return false;
+        }
+    }
+    return true;
+}
+
+static void appendUtf8(string& out, unsigned code){
+    if(code < 0x80){
+        out += (char)code;
+    }else if(code < 0x800){
+        out += (char)(0xC0 | code >> 6);
+        out += (char)(0x80 | (code & 0x3F));
+    }else if(code < 0x10000){
+        out += (char)(0xE0 | code >> 12);
+        out += (char)(0x80 | (code >> 6 & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }else{
+        out += (char)(0xF0 | code >> 18);
+        out += (char)(0x80 | (code >> 12 & 0x3F));
+        out += (char)(0x80 | (code >> 6 & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+/**
+* Decodes the escapes of a string body into out.
+*
+* @return False on an escape json does not have, or a broken surrogate
+*         pair.
+*/
+static bool unescape(const JsonSlice& body, string& out){
+    out.clear();
+    const char* p = body.begin;
+    const char* end = body.end;
+    while(p < end){
+        if(*p != '\\'){
+            const char* run = p;
+            while(p < end && *p != '\\'){
+                p++;
+            }
+            out.append(run, p - run);
+            continue;
+        }
+        if(++p >= end){
+            return false;
+        }
+        switch(*p++){
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned code;
+                if(!hex4(p, end, code)){
+                    return false;
+                }
+                p += 4;
+                if(code >= 0xD800 && code < 0xDC00){
+                    unsigned low;
+                    if(end - p < 6 || p[0] != '\\' || p[1] != 'u' ||
+                       !hex4(p + 2, end, low) || low < 0xDC00 || low > 0xDFFF){
+                        return false;
+                    }
+                    p += 6;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }else if(code >= 0xDC00 && code < 0xE000){
+                    return false;
+                }
+                appendUtf8(out, code);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+/*
+* The typed methods. Each writes its result, as json, to the end of out.
+*/
+
+static void typedGet(WaypointLibrary& library, string& out,
+                     const string& name){
+    LOG_SAMPLED(Logger::INFO, "Getting " << name);
+    if(!library.appendJson(name, out)){
+        // what get returns for a name it does not have.
+        out += "{\"address\":\"\",\"ele\":0.0,\"lat\":0.0,\"lon\":0.0,"
+               "\"name\":\"\"}";
+    }
+}
+
+static void typedGetNames(WaypointLibrary& library, string& out){
+    size_t count = library.appendNamesJson(out);
+    LOG_SAMPLED(Logger::INFO, "Get names returning " << count << " names");
+}
+
+static void typedDistanceAndBearing(WaypointLibrary& library, string& out,
+                                    const string& waypoint1,
+                                    const string& waypoint2){
+    // a missing waypoint counts as 0,0, as in distanceAndBearing.
+    double lat1 = 0, lon1 = 0, lat2 = 0, lon2 = 0;
+    library.position(waypoint1, lat1, lon1);
+    library.position(waypoint2, lat2, lon2);
+    double distance = Waypoint::toScale(library.distanceKm(lat1, lon1,
+                                                           lat2, lon2),
+                                        Waypoint::STATUTE);
+    double bearing = Waypoint::bearingGC(lat1, lon1, lat2, lon2);
+    char text[128];
+    int length = snprintf(text, sizeof(text), "\"%.2f miles at %.2f degrees \"",
+                          distance, bearing);
+    out.append(text, std::min(length, (int)sizeof(text) - 1));
+    LOG_SAMPLED(Logger::INFO, "Calculating distance and waypoint between: "
+                << waypoint1 << " and " << waypoint2);
+}
+
+/*
+* Decoding, generated for each method from its signature.
+*/
+
+template<class T>
+static bool decodeParam(JsonCursor& c, T& value);
+
+template<>
+bool decodeParam<string>(JsonCursor& c, string& value){
+    JsonSlice body;
+    bool escaped;
+    if(!scanString(c, body, escaped)){
+        return false;
+    }
+    if(!escaped){
+        value.assign(body.begin, body.end - body.begin);
+        return true;
+    }
+    return unescape(body, value);
+}
+
+/**
+* Decodes a positional parameter array into args, one decodeParam per
+* parameter type. No params at all, or null, is an empty array.
+*/
+template<class... A, size_t... I>
+static bool decodeParams(JsonCursor* params, tuple<A...>& args,
+                         index_sequence<I...>){
+    if(params == NULL){
+        return sizeof...(A) == 0;
+    }
+    if(!expect(*params, '[')){
+        return false;
+    }
+    if(sizeof...(A) == 0){
+        return expect(*params, ']');
+    }
+    bool ok = true;
+    // braced lists are evaluated left to right, so this decodes in order.
+    int unused[] = {0, (ok = ok && (I == 0 || expect(*params, ',')) &&
+                              decodeParam(*params, get<I>(args)))...};
+    (void)unused;
+    return ok && expect(*params, ']');
+}
+
+typedef bool (*TypedCall)(WaypointLibrary& library, JsonCursor* params,
+                          const JsonSlice& id, int series, string& reply);
+
+template<class F, F f>
+struct Typed;
+
+/**
+* Binds a method taking (library, out, const A&...) to a TypedCall that
+* decodes the A... from the request and wraps the result in the reply.
+*/
+template<class... A, void (*f)(WaypointLibrary&, string&, const A&...)>
+struct Typed<void (*)(WaypointLibrary&, string&, const A&...), f> {
+
+    static bool call(WaypointLibrary& library, JsonCursor* params,
+                     const JsonSlice& id, int series, string& reply){
+        // one set per thread and method, their strings keep their capacity.
+        thread_local tuple<A...> args;
+        if(!decodeParams(params, args, index_sequence_for<A...>())){
+            return false;
+        }
+        // only counted once answered here, a call left to the handler is
+        // counted there.
+        Metrics::Call timed(series);
+        reply.assign("{\"id\":");
+        reply.append(id.begin, id.end - id.begin);
+        reply += ",\"jsonrpc\":\"2.0\",\"result\":";
+        invoke(library, reply, args, index_sequence_for<A...>());
+        reply += "}\n";
+        timed.succeeded();
+        return true;
+    }
+
+    template<size_t... I>
+    static void invoke(WaypointLibrary& library, string& out,
+                       tuple<A...>& args, index_sequence<I...>){
+        f(library, out, get<I>(args)...);
+    }
+};
+
+#define TYPED_METHOD(name, function) \
+    { name, &Typed<decltype(&function), &function>::call }
+
+static const struct {
+    const char* name;
+    TypedCall call;
+} METHODS[] = {
+    TYPED_METHOD("get", typedGet),
+    TYPED_METHOD("getNames", typedGetNames),
+    TYPED_METHOD("distanceAndBearing", typedDistanceAndBearing)
+};
+
+/**
+* Consumes an id that can be echoed as it was sent: a string without
+* escapes or a plain integer. Anything else is left to the handler.
+*/
+static bool scanId(JsonCursor& c, JsonSlice& id){
+    skipSpace(c);
+    id.begin = c.p;
+    if(c.p < c.end && *c.p == '"'){
+        JsonSlice body;
+        bool escaped;
+        if(!scanString(c, body, escaped) || escaped){
+            return false;
+        }
+    }else{
+        if(c.p < c.end && *c.p == '-'){
+            c.p++;
+        }
+        const char* digits = c.p;
+        while(c.p < c.end && isDigit(*c.p)){
+            c.p++;
+        }
+        size_t length = c.p - digits;
+        if(length == 0 || length > 9 || (*digits == '0' && length > 1) ||
+           (*digits == '0' && digits != id.begin)){
+            return false;
+        }
+        if(c.p < c.end && (*c.p == '.' || *c.p == 'e' || *c.p == 'E')){
+            return false;
+        }
+    }
+    id.end = c.p;
+    return true;
+}
+
+TypedMethods::TypedMethods(WaypointLibrary& library) : library(library){
+    for(size_t i = 0; i < sizeof(METHODS) / sizeof(METHODS[0]); i++){
+        series.push_back(Metrics::instance().series(Metrics::METHOD,
+                                                    METHODS[i].name));
+    }
+}
+
+bool TypedMethods::handle(const string& request, string& reply){
+    JsonCursor c = { request.data(), request.data() + request.size() };
+    JsonSlice method = { NULL, NULL };
+    JsonSlice id = { NULL, NULL };
+    JsonCursor params = { NULL, c.end };
+    bool hasParams = false;
+    bool version = false;
+    if(!expect(c, '{')){
+        return false;
+    }
+    if(!expect(c, '}')){
+        do{
+            JsonSlice key;
+            bool escaped;
+            if(!scanString(c, key, escaped) || escaped || !expect(c, ':')){
+                return false;
+            }
+            if(is(key, "method")){
+                if(!scanString(c, method, escaped) || escaped){
+                    return false;
+                }
+            }else if(is(key, "jsonrpc")){
+                JsonSlice value;
+                if(!scanString(c, value, escaped)){
+                    return false;
+                }
+                version = is(value, "2.0");
+            }else if(is(key, "id")){
+                if(!scanId(c, id)){
+                    return false;
+                }
+            }else if(is(key, "params")){
+                skipSpace(c);
+                params.p = c.p;
+                if(!skipValue(c, 0)){
+                    return false;
+                }
+                hasParams = *params.p != 'n';
+            }else if(!skipValue(c, 0)){
+                return false;
+            }
+        }while(expect(c, ','));
+        if(!expect(c, '}')){
+            return false;
+        }
+    }
+    skipSpace(c);
+    // notifications and anything but a lone 2.0 call go the long way.
+    if(c.p != c.end || !version || method.begin == NULL || id.begin == NULL){
+        return false;
+    }
+    for(size_t i = 0; i < sizeof(METHODS) / sizeof(METHODS[0]); i++){
+        if(is(method, METHODS[i].name)){
+            return METHODS[i].call(library, hasParams ? &params : NULL, id,
+                                   series[i], reply);
+        }
+    }
+    return false;
+}
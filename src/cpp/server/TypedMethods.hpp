@@ -0,0 +1,73 @@
+#ifndef TYPEDMETHODS_HPP
+#define TYPEDMETHODS_HPP
+
+#include <string>
+#include <vector>
+
+#include "WaypointLibrary.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Answers the hottest methods of the library, get,
+ * distanceAndBearing and getNames, without building a Json::Value for
+ * either the request or the reply. The request is scanned in place, the
+ * parameters are decoded straight into typed arguments and the result is
+ * written straight into the reply, using buffers each thread keeps, so a
+ * call allocates nothing once the thread is warm. The results of get and
+ * getNames are copied from the json the library keeps cached for them.
+ *
+ * Anything it is not sure about, a method it does not have, parameters
+ * by name or of the wrong type, a notification, a request that does not
+ * parse, is left to the json-rpc handler, which answers it as it always
+ * did, errors included. The replies are the same json the handler writes.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class TypedMethods {
+
+    public:
+
+    /**
+    * @param The library the methods run against.
+    */
+    TypedMethods(WaypointLibrary& library);
+
+    /**
+    * Answers a single JSON-RPC 2.0 request if it is a call to one of the
+    * typed methods.
+    *
+    * @param  The request, one json object.
+    * @param  Replaced with the reply when the request is answered.
+    * @return True if answered, false to leave it to the handler; reply is
+    *         untouched then.
+    */
+    bool handle(const string& request, string& reply);
+
+    private:
+
+    WaypointLibrary& library;
+    /**
+    * The Metrics series of each method, looked up once.
+    */
+    vector<int> series;
+};
+
+#endif
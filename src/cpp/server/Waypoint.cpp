@@ -2,6 +2,7 @@
 #include <iostream>
 #include <stdlib.h>
 #include <cmath>
+#include <utility>
 
 /**
  * Copyright 2018 Tim Lindquist,
@@ -27,88 +28,118 @@
  *         Software Engineering, CIDSE, IAFSE, ASU Poly
  * @version January 2018
  */
+constexpr double Waypoint::pi;
+constexpr double Waypoint::radiusE;
+
 Waypoint::Waypoint(){
    lat = lon = ele = 0;
-   name = "";
-   address = "";
-}
-
-Waypoint::Waypoint(const Waypoint & wp){
-   lat = wp.lat;
-   lon = wp.lon;
-   ele = wp.ele; 
-   name = wp.name;
-   address = wp.address;
 }
 
-Waypoint::Waypoint(Json::Value object){
+Waypoint::Waypoint(const Json::Value& object){
    lat = object.get("lat",0).asDouble();
    lon = object.get("lon",0).asDouble();
    ele = object.get("ele",0).asDouble(); 
    name = object.get("name","").asString();
-   address = object.get("adress","").asString();
-}
-
-Waypoint::Waypoint(double aLat, double aLon, double anElevation, string aName, string aAddress) {
-   lat = aLat;
-   lon = aLon;
-   ele = anElevation;
-   name = aName;
-   address = aAddress;
+   // toJSONObject writes "address"; older files spelled it "adress".
+   address = object.isMember("address")
+             ? object.get("address","").asString()
+             : object.get("adress","").asString();
 }
 
-Waypoint::~Waypoint() {
-   //cout << "Waypoint destructor.\n";
-   lat=lon=ele=0; name=""; address="";
+/**
+ * The strings are taken by value and moved in, so a caller handing over
+ * temporaries pays for no copy.
+ */
+Waypoint::Waypoint(double aLat, double aLon, double anElevation, string aName, string aAddress)
+   : lat(aLat), lon(aLon), ele(anElevation), name(std::move(aName)),
+     address(std::move(aAddress)) {
 }
 
 void Waypoint::setValues(double aLat, double aLon, double anElevation,
-                         string aName) {
+                         const string& aName) {
    lat = aLat;
    lon = aLon;
    ele = anElevation;
    name = aName;
 }
 
-double Waypoint::distanceGCTo(Waypoint wp, int scale){
+double Waypoint::distanceGCTo(const Waypoint& wp, int scale) const{
+   return distanceGC(this->lat, this->lon, wp.lat, wp.lon, scale);
+}
+
+/**
+ * Great circle (haversine) distance between two positions given in
+ * degrees, in the units selected by scale.
+ */
+double Waypoint::distanceGC(double lat1, double lon1, double lat2, double lon2,
+                            int scale){
    double ret = 0.0;
    // ret is in kilometers. switch to either Statute or Nautical?
-   double lat1 = this->toRadians(this->lat);
-   double lat2 = this->toRadians(wp.lat);
-   double deltaLat = this->toRadians(wp.lat-this->lat);
-   double deltaLon = this->toRadians(wp.lon-this->lon);
+   double deltaLat = toRadians(lat2-lat1);
+   double deltaLon = toRadians(lon2-lon1);
+   lat1 = toRadians(lat1);
+   lat2 = toRadians(lat2);
    double a = std::sin(deltaLat/2)*std::sin(deltaLat/2) +
                  std::cos(lat1)*std::cos(lat2)*
                  std::sin(deltaLon/2)*std::sin(deltaLon/2);
    double c = 2 * std::atan2(std::sqrt(a), std::sqrt(1-a));
    ret = radiusE * c;
+   return toScale(ret, scale);
+}
+
+/**
+ * Converts a distance in kilometers to the units selected by scale.
+ */
+double Waypoint::toScale(double km, int scale){
    switch(scale) {
    case STATUTE:
-      ret = ret * 0.62137119;
-      break;
+      return km * 0.62137119;
    case NAUTICAL:
-      ret = ret * 0.5399568;
-      break;
+      return km * 0.5399568;
    }
-   return ret;
+   return km;
 }
 
-double Waypoint::bearingGCInitTo(Waypoint wp, int scale){
+/**
+ * Converts a distance in the units selected by scale to kilometers.
+ */
+double Waypoint::fromScale(double distance, int scale){
+   switch(scale) {
+   case STATUTE:
+      return distance / 0.62137119;
+   case NAUTICAL:
+      return distance / 0.5399568;
+   }
+   return distance;
+}
+
+/**
+ * Bearing from this waypoint to wp as bearingGC gives it. A bearing is an
+ * angle, so scale, kept for the callers that pass one, changes nothing.
+ */
+double Waypoint::bearingGCInitTo(const Waypoint& wp, int scale) const{
+   return bearingGC(this->lat, this->lon, wp.lat, wp.lon);
+}
+
+/**
+ * Initial great circle bearing in degrees between two positions given in
+ * degrees, as bearingGCInitTo computes it from this waypoint to wp.
+ */
+double Waypoint::bearingGC(double lat1, double lon1, double lat2, double lon2){
    double ret = 0.0;
-   double lat2 = this->toRadians(this->lat);
-   double lat1 = this->toRadians(wp.lat);
-   double deltaLat = this->toRadians(this->lat-wp.lat);
-   double deltaLon = this->toRadians(this->lon-wp.lon);
-   double y = std::sin(deltaLon) * std::cos(lat2);
-   double x = (std::cos(lat1) * std::sin(lat2)) - 
-                 (std::sin(lat1) * std::cos(lat2) * std::cos(deltaLon));
+   double rLat2 = toRadians(lat1);
+   double rLat1 = toRadians(lat2);
+   double deltaLon = toRadians(lon1-lon2);
+   double y = std::sin(deltaLon) * std::cos(rLat2);
+   double x = (std::cos(rLat1) * std::sin(rLat2)) - 
+                 (std::sin(rLat1) * std::cos(rLat2) * std::cos(deltaLon));
    double brng = std::atan2(y,x);
-   ret = this->toDegrees(brng);
+   ret = toDegrees(brng);
    return ret;
 }
 
 
-Json::Value Waypoint::toJSONObject(){
+Json::Value Waypoint::toJSONObject() const{
    Json::Value  ret;
    ret["lat"] = this->lat;
    ret["lon"] = this->lon;
@@ -119,7 +150,7 @@ Json::Value Waypoint::toJSONObject(){
    return ret;
 }
 
-void Waypoint::print(){
+void Waypoint::print() const{
    cout << "Waypoint " << name << " lat "
         << lat << " lon " << lon << "\n";
 }
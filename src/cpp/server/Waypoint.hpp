@@ -1,3 +1,6 @@
+#ifndef WAYPOINT_HPP
+#define WAYPOINT_HPP
+
 #include <string>
 #include <cmath>
 
@@ -30,19 +33,19 @@ using namespace std;
  * @version January 2018
  */
 class Waypoint {
-protected:
-   static constexpr double pi = 3.14159265;
-   double toRadians(double deg){
+public:
+   static constexpr double pi = 3.14159265358979323846;
+   static double toRadians(double deg){
       return (deg*pi)/180.0;
    }
-   double toDegrees(double rad){
+   static double toDegrees(double rad){
       return (rad*180.0)/pi;
    }
-public:
    static const int STATUTE = 0;
    static const int NAUTICAL = 1;
    static const int KMETER = 2;
-   static const int radiusE = 6371;
+   // mean earth radius in kilometers.
+   static constexpr double radiusE = 6371.0088;
 
    double lat;
    double lon;
@@ -50,14 +53,21 @@ public:
    string name;
    string address;
 
+   // copied and moved member by member.
    Waypoint();
-   Waypoint(const Waypoint & another);
    Waypoint(double aLat, double aLon, double anElevation, string aName, string aAddress);
-   Waypoint(Json::Value object);
-   ~Waypoint();
-   void setValues(double aLat, double aLon, double anElevation, string aName);
-   double distanceGCTo(Waypoint wp, int scale);
-   double bearingGCInitTo(Waypoint wp, int scale);
-   Json::Value toJSONObject();
-   void print();
+   Waypoint(const Json::Value& object);
+   void setValues(double aLat, double aLon, double anElevation,
+                  const string& aName);
+   double distanceGCTo(const Waypoint& wp, int scale) const;
+   static double distanceGC(double lat1, double lon1, double lat2, double lon2,
+                            int scale);
+   static double toScale(double km, int scale);
+   static double fromScale(double distance, int scale);
+   double bearingGCInitTo(const Waypoint& wp, int scale) const;
+   static double bearingGC(double lat1, double lon1, double lat2, double lon2);
+   Json::Value toJSONObject() const;
+   void print() const;
 };
+
+#endif
@@ -0,0 +1,434 @@
+#include "WaypointAddressIndex.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Inverted index over the addresses of a shard.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+const size_t WaypointAddressIndex::BLOCK;
+const size_t WaypointAddressIndex::MAX_TERM;
+
+/**
+* Changes held apart before a list is repacked, at least.
+*/
+static const size_t MIN_PENDING = 32;
+
+/**
+* Below this many candidates per slot of a list, the candidates are looked
+* up in the list one by one rather than the list being decoded whole.
+*/
+static const size_t PROBE_RATIO = 32;
+
+static inline void putVarint(vector<uint8_t>& out, uint32_t value){
+    while(value >= 0x80){
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static inline uint32_t getVarint(const uint8_t*& p){
+    uint32_t value = *p & 0x7F;
+    for(int shift = 7; *p++ & 0x80; shift += 7){
+        value |= (uint32_t)(*p & 0x7F) << shift;
+    }
+    return value;
+}
+
+/**
+* Tells whether a byte belongs in a term.
+*/
+static inline bool inTerm(unsigned char c){
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+static inline char fold(char c){
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+void WaypointAddressIndex::termsOf(const char* text, size_t size,
+                                   vector<string>& out){
+    // the strings already in out are reused, so a caller splitting one
+    // address after another seldom allocates.
+    size_t count = 0;
+    for(size_t i = 0; i < size; ){
+        if(!inTerm(text[i])){
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while(i < size && inTerm(text[i])){
+            i++;
+        }
+        if(count == out.size()){
+            out.push_back(string());
+        }
+        string& term = out[count++];
+        term.assign(text + start, std::min(i - start, MAX_TERM));
+        for(size_t k = 0; k < term.size(); k++){
+            term[k] = fold(term[k]);
+        }
+    }
+    out.resize(count);
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+bool WaypointAddressIndex::holdsAll(const StringArena::Text& text,
+                                    const vector<string>& terms){
+    if(terms.size() > 64){
+        vector<string> own;
+        termsOf(text.data, text.size, own);
+        return includes(own.begin(), own.end(), terms.begin(), terms.end());
+    }
+    // split as termsOf does, each term looked up in place and ticked off.
+    uint64_t seen = 0;
+    size_t count = 0;
+    char term[MAX_TERM];
+    size_t length = 0;
+    for(size_t i = 0; i <= text.size && count < terms.size(); i++){
+        char c = i < text.size ? text.data[i] : ' ';
+        if(inTerm(c)){
+            if(length < MAX_TERM){
+                term[length++] = fold(c);
+            }
+        }else if(length > 0){
+            vector<string>::const_iterator found =
+                lower_bound(terms.begin(), terms.end(), term,
+                            [length](const string& a, const char* b){
+                                return a.compare(0, string::npos, b,
+                                                 length) < 0;
+                            });
+            if(found != terms.end() &&
+               found->compare(0, string::npos, term, length) == 0){
+                uint64_t bit = (uint64_t)1 << (found - terms.begin());
+                if(!(seen & bit)){
+                    seen |= bit;
+                    count++;
+                }
+            }
+            length = 0;
+        }
+    }
+    return count == terms.size();
+}
+
+WaypointAddressIndex::WaypointAddressIndex() : built(false){
+}
+
+/**
+* Stands for the changes of a list that has none.
+*/
+static const vector<uint32_t> NONE;
+
+void WaypointAddressIndex::pack(const vector<uint32_t>& slots,
+                                Postings& postings){
+    postings.bytes.clear();
+    postings.blocks.clear();
+    for(size_t i = 0; i < slots.size(); i++){
+        if(i % BLOCK == 0){
+            if(i > 0){
+                postings.blocks.push_back(postings.bytes.size());
+            }
+            putVarint(postings.bytes, slots[i]);
+        }else{
+            putVarint(postings.bytes, slots[i] - slots[i - 1]);
+        }
+    }
+    postings.packed = slots.size();
+    postings.changes.reset();
+    postings.bytes.shrink_to_fit();
+    postings.blocks.shrink_to_fit();
+}
+
+void WaypointAddressIndex::unpack(const Postings& postings,
+                                  vector<uint32_t>& out){
+    out.clear();
+    out.reserve(postings.size());
+    const vector<uint32_t>& added =
+        postings.changes ? postings.changes->added : NONE;
+    const vector<uint32_t>& removed =
+        postings.changes ? postings.changes->removed : NONE;
+    vector<uint32_t>::const_iterator a = added.begin();
+    vector<uint32_t>::const_iterator r = removed.begin();
+    const uint8_t* p = postings.bytes.data();
+    uint32_t slot = 0;
+    for(size_t i = 0; i < postings.packed; i++){
+        slot = i % BLOCK == 0 ? getVarint(p) : slot + getVarint(p);
+        while(a != added.end() && *a < slot){
+            out.push_back(*a++);
+        }
+        while(r != removed.end() && *r < slot){
+            r++;
+        }
+        if(r != removed.end() && *r == slot){
+            continue;
+        }
+        out.push_back(slot);
+    }
+    out.insert(out.end(), a, added.end());
+}
+
+bool WaypointAddressIndex::packedHolds(const Postings& postings,
+                                       uint32_t slot){
+    if(postings.packed == 0){
+        return false;
+    }
+    // the last block starting at or before the slot.
+    size_t low = 0;
+    size_t high = postings.blocks.size();
+    while(low < high){
+        size_t middle = (low + high + 1) / 2;
+        const uint8_t* p = postings.bytes.data() + postings.blocks[middle - 1];
+        if(getVarint(p) <= slot){
+            low = middle;
+        }else{
+            high = middle - 1;
+        }
+    }
+    const uint8_t* p = postings.bytes.data() +
+                       (low == 0 ? 0 : postings.blocks[low - 1]);
+    size_t count = std::min(BLOCK, postings.packed - low * BLOCK);
+    uint32_t at = getVarint(p);
+    for(size_t i = 1; i < count && at < slot; i++){
+        at += getVarint(p);
+    }
+    return at == slot;
+}
+
+bool WaypointAddressIndex::holds(const Postings& postings, uint32_t slot){
+    if(postings.changes){
+        const Changes& changes = *postings.changes;
+        if(binary_search(changes.added.begin(), changes.added.end(), slot)){
+            return true;
+        }
+        if(binary_search(changes.removed.begin(), changes.removed.end(),
+                         slot)){
+            return false;
+        }
+    }
+    return packedHolds(postings, slot);
+}
+
+/**
+* Repacks a list once the changes held apart outnumber the square root of
+* the packed slots, so each change pays for about as many bytes.
+*/
+void WaypointAddressIndex::settle(Postings& postings){
+    Changes& changes = *postings.changes;
+    size_t pending = changes.added.size() + changes.removed.size();
+    if(pending == 0){
+        postings.changes.reset();
+    }else if(pending > MIN_PENDING && pending * pending > postings.packed){
+        vector<uint32_t> slots;
+        unpack(postings, slots);
+        pack(slots, postings);
+    }
+}
+
+void WaypointAddressIndex::addTo(Postings& postings, uint32_t slot){
+    if(!postings.changes){
+        postings.changes.reset(new Changes());
+    }
+    Changes& changes = *postings.changes;
+    vector<uint32_t>::iterator at =
+        lower_bound(changes.removed.begin(), changes.removed.end(), slot);
+    if(at != changes.removed.end() && *at == slot){
+        changes.removed.erase(at);
+    }else{
+        changes.added.insert(lower_bound(changes.added.begin(),
+                                         changes.added.end(), slot), slot);
+    }
+    settle(postings);
+}
+
+void WaypointAddressIndex::removeFrom(Postings& postings, uint32_t slot){
+    if(postings.changes){
+        vector<uint32_t>& added = postings.changes->added;
+        vector<uint32_t>::iterator at =
+            lower_bound(added.begin(), added.end(), slot);
+        if(at != added.end() && *at == slot){
+            added.erase(at);
+            settle(postings);
+            return;
+        }
+    }
+    if(!packedHolds(postings, slot)){
+        return;
+    }
+    if(!postings.changes){
+        postings.changes.reset(new Changes());
+    }
+    vector<uint32_t>& removed = postings.changes->removed;
+    removed.insert(lower_bound(removed.begin(), removed.end(), slot), slot);
+    settle(postings);
+}
+
+void WaypointAddressIndex::build(const Addresses& addresses) const{
+    lock_guard<std::mutex> guard(buildLock);
+    if(built.load(memory_order_relaxed)){
+        return;
+    }
+    // the slots come in order, so each list is sorted as it is filled.
+    unordered_map<string, vector<uint32_t> > lists;
+    vector<string> found;
+    for(size_t slot = 0; slot < addresses.size(); slot++){
+        termsOf(addresses[slot].data, addresses[slot].size, found);
+        for(size_t t = 0; t < found.size(); t++){
+            lists[found[t]].push_back(slot);
+        }
+    }
+    terms.reserve(lists.size());
+    for(unordered_map<string, vector<uint32_t> >::iterator list =
+            lists.begin(); list != lists.end(); ++list){
+        pack(list->second, terms[list->first]);
+        vector<uint32_t>().swap(list->second);
+    }
+    built.store(true, memory_order_release);
+}
+
+void WaypointAddressIndex::add(size_t slot, const Addresses& addresses){
+    // nothing to keep up to date until a search builds it.
+    if(!built.load(memory_order_relaxed)){
+        return;
+    }
+    vector<string> found;
+    termsOf(addresses[slot].data, addresses[slot].size, found);
+    for(size_t t = 0; t < found.size(); t++){
+        this->addTo(terms[found[t]], slot);
+    }
+}
+
+void WaypointAddressIndex::remove(size_t slot, const Addresses& addresses){
+    if(!built.load(memory_order_relaxed)){
+        return;
+    }
+    vector<string> found;
+    termsOf(addresses[slot].data, addresses[slot].size, found);
+    for(size_t t = 0; t < found.size(); t++){
+        unordered_map<string, Postings>::iterator postings =
+            terms.find(found[t]);
+        if(postings == terms.end()){
+            continue;
+        }
+        this->removeFrom(postings->second, slot);
+        if(postings->second.size() == 0){
+            terms.erase(postings);
+        }
+    }
+}
+
+void WaypointAddressIndex::move(size_t from, size_t to,
+                                const Addresses& addresses){
+    if(!built.load(memory_order_relaxed)){
+        return;
+    }
+    vector<string> found;
+    termsOf(addresses[from].data, addresses[from].size, found);
+    for(size_t t = 0; t < found.size(); t++){
+        Postings& postings = terms[found[t]];
+        this->removeFrom(postings, from);
+        this->addTo(postings, to);
+    }
+}
+
+void WaypointAddressIndex::clear(){
+    unordered_map<string, Postings>().swap(terms);
+    built.store(false, memory_order_relaxed);
+}
+
+void WaypointAddressIndex::swap(WaypointAddressIndex& other){
+    terms.swap(other.terms);
+    bool was = built.load(memory_order_relaxed);
+    built.store(other.built.load(memory_order_relaxed), memory_order_relaxed);
+    other.built.store(was, memory_order_relaxed);
+}
+
+const WaypointAddressIndex::Postings*
+WaypointAddressIndex::find(const string& term) const{
+    unordered_map<string, Postings>::const_iterator postings =
+        terms.find(term);
+    return postings == terms.end() ? NULL : &postings->second;
+}
+
+size_t WaypointAddressIndex::fewest(const Addresses& addresses,
+                                    const vector<string>& wanted) const{
+    if(!built.load(memory_order_acquire)){
+        this->build(addresses);
+    }
+    size_t least = addresses.size();
+    for(size_t t = 0; t < wanted.size(); t++){
+        const Postings* postings = this->find(wanted[t]);
+        least = std::min(least, postings == NULL ? 0 : postings->size());
+    }
+    return least;
+}
+
+void WaypointAddressIndex::matching(const Addresses& addresses,
+                                    const vector<string>& wanted,
+                                    vector<size_t>& out) const{
+    if(wanted.empty()){
+        return;
+    }
+    if(!built.load(memory_order_acquire)){
+        this->build(addresses);
+    }
+    vector<const Postings*> lists;
+    for(size_t t = 0; t < wanted.size(); t++){
+        const Postings* postings = this->find(wanted[t]);
+        if(postings == NULL){
+            return;
+        }
+        lists.push_back(postings);
+    }
+    sort(lists.begin(), lists.end(),
+         [](const Postings* a, const Postings* b){
+             return a->size() < b->size();
+         });
+    // the shortest list whole, narrowed by each longer one: looked up one
+    // candidate at a time while there are few, else decoded and merged.
+    vector<uint32_t> found;
+    unpack(*lists[0], found);
+    vector<uint32_t> other;
+    vector<uint32_t> both;
+    for(size_t l = 1; l < lists.size() && !found.empty(); l++){
+        if(found.size() * PROBE_RATIO < lists[l]->size()){
+            size_t kept = 0;
+            for(size_t i = 0; i < found.size(); i++){
+                if(holds(*lists[l], found[i])){
+                    found[kept++] = found[i];
+                }
+            }
+            found.resize(kept);
+        }else{
+            unpack(*lists[l], other);
+            both.clear();
+            set_intersection(found.begin(), found.end(),
+                             other.begin(), other.end(), back_inserter(both));
+            found.swap(both);
+        }
+    }
+    out.insert(out.end(), found.begin(), found.end());
+}
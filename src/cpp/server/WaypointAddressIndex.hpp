@@ -0,0 +1,185 @@
+#ifndef WAYPOINTADDRESSINDEX_HPP
+#define WAYPOINTADDRESSINDEX_HPP
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#include "StringArena.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Inverted index over the addresses of a shard, for finding the
+ * waypoints whose address holds every one of a few words without reading
+ * every address.
+ *
+ * An address is split into terms at every byte that is not an ASCII
+ * letter or digit, bytes above ASCII staying inside terms so UTF-8 words
+ * are kept whole, and letters are folded to lower case. Each term has the
+ * sorted list of the slots whose address holds it.
+ *
+ * The lists are packed: each slot is written as its distance from the one
+ * before in as few 7-bit bytes as it takes, in blocks of BLOCK slots
+ * that each start from a whole slot, so a list of close slots costs about
+ * a byte per slot and a lookup only decodes one block. Changes don't repack
+ * a list; they go to two small sorted lists of slots added and removed
+ * since, and the list is repacked once those outnumber the square root of
+ * the packed ones, so a change costs about that many bytes of repacking.
+ *
+ * Like WaypointNameIndex, it is built the first time it is searched and
+ * kept up to date from then on; every call takes the addresses of the
+ * shard as they are when it is made, and the caller holds the shard
+ * exclusive to change it and shared to search.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WaypointAddressIndex {
+
+    public:
+
+    typedef vector<StringArena::Text> Addresses;
+
+    /**
+    * How many slots a packed block holds.
+    */
+    static const size_t BLOCK = 128;
+
+    /**
+    * Longest term kept; longer ones are cut to this many bytes.
+    */
+    static const size_t MAX_TERM = 64;
+
+    WaypointAddressIndex();
+
+    /**
+    * Records the address at slot, which addresses already holds.
+    */
+    void add(size_t slot, const Addresses& addresses);
+
+    /**
+    * Forgets the address at slot, which addresses still holds.
+    */
+    void remove(size_t slot, const Addresses& addresses);
+
+    /**
+    * Records that the address at one slot is moving to another, the one
+    * at the new slot having been removed; addresses still holds it at
+    * from.
+    */
+    void move(size_t from, size_t to, const Addresses& addresses);
+
+    /**
+    * Drops everything; the index is built again when next searched.
+    */
+    void clear();
+
+    /**
+    * Exchanges the content of this index with another one.
+    */
+    void swap(WaypointAddressIndex& other);
+
+    /**
+    * Counts the slots holding the rarest of some terms, which is as many
+    * as could hold all of them.
+    *
+    * @param  The addresses of the shard.
+    * @param  The terms, as termsOf gives them.
+    * @return The length of the shortest list, 0 if a term is in none.
+    */
+    size_t fewest(const Addresses& addresses,
+                  const vector<string>& terms) const;
+
+    /**
+    * Finds the slots whose address holds every one of some terms.
+    *
+    * @param The addresses of the shard.
+    * @param The terms, as termsOf gives them; none finds nothing.
+    * @param Where the slots are appended, in increasing order.
+    */
+    void matching(const Addresses& addresses, const vector<string>& terms,
+                  vector<size_t>& out) const;
+
+    /**
+    * Splits a text into terms the way addresses are split.
+    *
+    * @param The text.
+    * @param Its length.
+    * @param Set to the terms, sorted and each once.
+    */
+    static void termsOf(const char* text, size_t size, vector<string>& out);
+
+    /**
+    * Tells whether a text holds every one of some terms, without the
+    * index, for checking a few slots found some other way.
+    */
+    static bool holdsAll(const StringArena::Text& text,
+                         const vector<string>& terms);
+
+    private:
+
+    /**
+    * The slots added to a list and removed from it since it was packed.
+    */
+    struct Changes {
+        vector<uint32_t> added;
+        vector<uint32_t> removed;
+    };
+
+    /**
+    * The slots of one term. Most terms, such as house numbers, are held
+    * by a few addresses, so what a list costs besides its bytes is kept
+    * small: the blocks after the first are found through their offsets,
+    * their first slot written at the start of each, and the changes are
+    * only allocated while there are some.
+    */
+    struct Postings {
+        vector<uint8_t> bytes;
+        vector<uint32_t> blocks;
+        uint32_t packed = 0;
+        unique_ptr<Changes> changes;
+        size_t size() const {
+            return changes ? packed + changes->added.size() -
+                             changes->removed.size()
+                           : packed;
+        }
+    };
+
+    mutable unordered_map<string, Postings> terms;
+    mutable atomic<bool> built;
+    mutable std::mutex buildLock;
+
+    void build(const Addresses& addresses) const;
+    void addTo(Postings& postings, uint32_t slot);
+    void removeFrom(Postings& postings, uint32_t slot);
+    const Postings* find(const string& term) const;
+
+    static void pack(const vector<uint32_t>& slots, Postings& postings);
+    static void unpack(const Postings& postings, vector<uint32_t>& out);
+    static bool packedHolds(const Postings& postings, uint32_t slot);
+    static bool holds(const Postings& postings, uint32_t slot);
+    static void settle(Postings& postings);
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "WaypointGrid.hpp"
+#include "Waypoint.hpp"
+#include <cmath>
+#include <algorithm>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Spatial index over waypoint positions.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+// std::min takes them by reference, which needs them defined.
+const int WaypointGrid::LAT_CELLS;
+const int WaypointGrid::LON_CELLS;
+
+void WaypointGrid::add(size_t slot, double lat, double lon){
+    cells[cellOf(lat, lon)].push_back(slot);
+}
+
+void WaypointGrid::remove(size_t slot, double lat, double lon){
+    unordered_map<int, vector<size_t> >::iterator cell =
+        cells.find(cellOf(lat, lon));
+    if(cell == cells.end()){
+        return;
+    }
+    vector<size_t>& slots = cell->second;
+    vector<size_t>::iterator found = std::find(slots.begin(), slots.end(), slot);
+    if(found != slots.end()){
+        *found = slots.back();
+        slots.pop_back();
+    }
+    if(slots.empty()){
+        cells.erase(cell);
+    }
+}
+
+void WaypointGrid::move(size_t from, size_t to, double lat, double lon){
+    vector<size_t>& slots = cells[cellOf(lat, lon)];
+    vector<size_t>::iterator found = std::find(slots.begin(), slots.end(), from);
+    if(found != slots.end()){
+        *found = to;
+    }
+}
+
+void WaypointGrid::clear(){
+    cells.clear();
+}
+
+void WaypointGrid::swap(WaypointGrid& other){
+    cells.swap(other.cells);
+}
+
+void WaypointGrid::candidates(double lat, double lon, double radiusKm,
+                              vector<size_t>& out) const{
+    double angle = radiusKm / Waypoint::radiusE;
+    double angleDeg = Waypoint::toDegrees(angle);
+    bool allLon = false;
+    double lonDeg = 0.0;
+    if(lat - angleDeg <= -90.0 || lat + angleDeg >= 90.0){
+        // the circle covers a pole, so every longitude is in reach.
+        allLon = true;
+    }else{
+        double ratio = std::sin(angle) / std::cos(Waypoint::toRadians(lat));
+        if(ratio >= 1.0){
+            allLon = true;
+        }else{
+            lonDeg = Waypoint::toDegrees(std::asin(ratio));
+        }
+    }
+    int latLow = latCell(std::max(lat - angleDeg, -90.0));
+    int latHigh = latCell(std::min(lat + angleDeg, 90.0));
+    int lonLow = 0;
+    int lonSpan = LON_CELLS;
+    if(!allLon){
+        lonLow = (int)std::floor((lon - lonDeg + 180.0));
+        int lonHigh = (int)std::floor((lon + lonDeg + 180.0));
+        lonSpan = std::min(lonHigh - lonLow + 1, LON_CELLS);
+    }
+
+    // a wide circle covers more cells than there are occupied ones, so
+    // just filter the occupied ones in that case.
+    if((size_t)(latHigh - latLow + 1) * lonSpan > cells.size()){
+        for(unordered_map<int, vector<size_t> >::const_iterator cell =
+                cells.begin(); cell != cells.end(); cell++){
+            int latIdx = cell->first / LON_CELLS;
+            int lonIdx = cell->first % LON_CELLS;
+            int lonOffset = ((lonIdx - lonLow) % LON_CELLS + LON_CELLS) % LON_CELLS;
+            if(latIdx >= latLow && latIdx <= latHigh && lonOffset < lonSpan){
+                out.insert(out.end(), cell->second.begin(), cell->second.end());
+            }
+        }
+        return;
+    }
+    for(int latIdx = latLow; latIdx <= latHigh; latIdx++){
+        for(int i = 0; i < lonSpan; i++){
+            int lonIdx = ((lonLow + i) % LON_CELLS + LON_CELLS) % LON_CELLS;
+            unordered_map<int, vector<size_t> >::const_iterator cell =
+                cells.find(latIdx * LON_CELLS + lonIdx);
+            if(cell != cells.end()){
+                out.insert(out.end(), cell->second.begin(), cell->second.end());
+            }
+        }
+    }
+}
+
+int WaypointGrid::latCell(double lat){
+    int idx = (int)std::floor(lat + 90.0);
+    return std::min(std::max(idx, 0), LAT_CELLS - 1);
+}
+
+int WaypointGrid::lonCell(double lon){
+    int idx = (int)std::floor(lon + 180.0);
+    return ((idx % LON_CELLS) + LON_CELLS) % LON_CELLS;
+}
+
+int WaypointGrid::cellOf(double lat, double lon){
+    return latCell(lat) * LON_CELLS + lonCell(lon);
+}
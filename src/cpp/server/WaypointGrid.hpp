@@ -0,0 +1,88 @@
+#ifndef WAYPOINTGRID_HPP
+#define WAYPOINTGRID_HPP
+
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Spatial index over waypoint positions. The globe is cut into
+ * one degree latitude/longitude cells and each cell lists the slots of the
+ * waypoints inside it, so a radius query only has to look at the cells
+ * overlapping the circle instead of at every waypoint.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WaypointGrid {
+
+    public:
+
+    static const int LAT_CELLS = 180;
+    static const int LON_CELLS = 360;
+
+    /**
+    * Records that the waypoint at slot sits at lat/lon.
+    */
+    void add(size_t slot, double lat, double lon);
+
+    /**
+    * Forgets the waypoint at slot, which sits at lat/lon.
+    */
+    void remove(size_t slot, double lat, double lon);
+
+    /**
+    * Records that the waypoint at lat/lon moved from one slot to another.
+    */
+    void move(size_t from, size_t to, double lat, double lon);
+
+    /**
+    * Drops every cell.
+    */
+    void clear();
+
+    /**
+    * Exchanges the cells of this grid with another one.
+    */
+    void swap(WaypointGrid& other);
+
+    /**
+    * Collects the slots of every waypoint in a cell that overlaps the
+    * circle of the given radius around lat/lon. Callers still have to
+    * check the exact distance of each candidate.
+    *
+    * @param Latitude of the center in degrees.
+    * @param Longitude of the center in degrees.
+    * @param Radius of the circle in kilometers.
+    * @param Where the candidate slots are appended.
+    */
+    void candidates(double lat, double lon, double radiusKm,
+                    vector<size_t>& out) const;
+
+    private:
+
+    unordered_map<int, vector<size_t> > cells;
+
+    static int latCell(double lat);
+    static int lonCell(double lon);
+    static int cellOf(double lat, double lon);
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "WaypointImport.hpp"
+#include "WaypointJsonLoader.hpp"
+#include "JsonText.hpp"
+#include "Logger.hpp"
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Adds waypoints to the library from a stream of json.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+const size_t WaypointImport::BATCH;
+const size_t WaypointImport::MAX_RECORD;
+
+WaypointImport::WaypointImport(WaypointLibrary& library)
+    : library(library), scanned(0), depth(0), inString(false),
+      escaped(false), skipping(false), record(0), addedCount(0),
+      failedCount(0), logFailed(false){
+    batch.reserve(BATCH);
+}
+
+/**
+* Splits the bytes into records. Only the record still being received is
+* kept between calls, and it is scanned once, however it was split.
+*/
+void WaypointImport::feed(const char* data, size_t size){
+    if(this->stopped()){
+        return;
+    }
+    pending.append(data, size);
+    // where the unfinished record, if any, starts.
+    size_t start = 0;
+    size_t i = scanned;
+    for(; i < pending.size(); i++){
+        char c = pending[i];
+        if(depth == 0){
+            if(skipping){
+                skipping = c != '\n' && c != ',';
+            }else if(c == '{'){
+                depth = 1;
+                start = i;
+                continue;
+            }else if(c != ' ' && c != '\t' && c != '\r' && c != '\n' &&
+                     c != ',' && c != '[' && c != ']'){
+                this->fail("not an object");
+                record++;
+                skipping = true;
+            }
+            start = i + 1;
+        }else if(inString){
+            if(escaped){
+                escaped = false;
+            }else if(c == '\\'){
+                escaped = true;
+            }else if(c == '"'){
+                inString = false;
+            }
+        }else if(c == '"'){
+            inString = true;
+        }else if(c == '{' || c == '['){
+            depth++;
+        }else if(c == '}' || c == ']'){
+            if(--depth == 0){
+                this->decode(pending.data() + start, pending.data() + i + 1);
+                start = i + 1;
+            }
+        }
+    }
+    if(depth > 0 && pending.size() - start > MAX_RECORD){
+        fatal = "record " + to_string(record) + " is longer than " +
+                to_string(MAX_RECORD) + " bytes";
+        pending.clear();
+        scanned = 0;
+        return;
+    }
+    pending.erase(0, start);
+    scanned = i - start;
+}
+
+void WaypointImport::finish(){
+    if(depth > 0 && !this->stopped()){
+        fatal = "the stream ended inside record " + to_string(record);
+    }
+    pending.clear();
+    scanned = 0;
+    this->flush();
+    LOG_INFO("Imported " << addedCount << " waypoints, skipped "
+             << failedCount << (this->stopped() ? ", " + fatal : string()));
+}
+
+void WaypointImport::fail(const string& error){
+    if(failedCount++ < WaypointLibrary::MAX_ERRORS){
+        errors.push_back(make_pair(record, error));
+    }
+}
+
+void WaypointImport::decode(const char* begin, const char* end){
+    Waypoint aWaypoint;
+    if(WaypointJsonLoader::readWaypoint(begin, end, aWaypoint) != NULL){
+        this->fail("not a waypoint object");
+    }else if(aWaypoint.name.empty()){
+        this->fail("missing name");
+    }else{
+        batch.push_back(std::move(aWaypoint));
+        if(batch.size() >= BATCH){
+            this->flush();
+        }
+    }
+    record++;
+}
+
+void WaypointImport::flush(){
+    if(batch.empty()){
+        return;
+    }
+    if(!library.addMany(batch)){
+        logFailed = true;
+    }
+    addedCount += batch.size();
+    batch.clear();
+}
+
+void WaypointImport::appendReport(string& out) const {
+    // keys in the order jsoncpp writes them.
+    out += "{\"added\":" + to_string(addedCount);
+    if(!fatal.empty() || logFailed){
+        out += ",\"error\":";
+        JsonText::appendQuoted(out, !fatal.empty() ? fatal
+                                                   : "not written to the log");
+    }
+    out += ",\"errors\":[";
+    for(size_t i = 0; i < errors.size(); i++){
+        out += i == 0 ? "{\"error\":" : ",{\"error\":";
+        JsonText::appendQuoted(out, errors[i].second);
+        out += ",\"record\":" + to_string(errors[i].first) + "}";
+    }
+    out += "],\"failed\":" + to_string(failedCount) + "}";
+}
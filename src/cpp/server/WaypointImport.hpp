@@ -0,0 +1,133 @@
+#ifndef WAYPOINTIMPORT_HPP
+#define WAYPOINTIMPORT_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "Waypoint.hpp"
+#include "WaypointLibrary.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Adds waypoints to the library from a stream of json as it
+ * arrives, so a large import needs neither one call per waypoint nor the
+ * whole body in memory. The stream is either a json array of waypoint
+ * objects or newline delimited json, one object per line; the same
+ * objects as the json file holds, address spelled as toJSONObject writes
+ * it. Bytes are fed in pieces of any size:
+ *
+ *     WaypointImport import(library);
+ *     while(...) import.feed(data, size);
+ *     import.finish();
+ *     import.appendReport(reply);
+ *
+ * Objects are decoded by the json loader as soon as they are complete
+ * and added BATCH at a time with WaypointLibrary::addMany. A record that
+ * is not a waypoint is counted as failed and the stream goes on; a record
+ * that never ends, or grows past MAX_RECORD, stops it. A stream cut short
+ * keeps the batches added so far.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WaypointImport {
+
+    public:
+
+    /**
+    * How many waypoints are added at once.
+    */
+    static const size_t BATCH = 4096;
+
+    /**
+    * Largest record accepted.
+    */
+    static const size_t MAX_RECORD = 1 << 20;
+
+    /**
+    * @param The library to add to.
+    */
+    WaypointImport(WaypointLibrary& library);
+
+    /**
+    * Takes the next bytes of the stream.
+    *
+    * @param The bytes.
+    * @param How many there are.
+    */
+    void feed(const char* data, size_t size);
+
+    /**
+    * Ends the stream, adding the waypoints still batched.
+    */
+    void finish();
+
+    /**
+    * @return True once the stream could not be read any further.
+    */
+    bool stopped() const { return !fatal.empty(); }
+
+    size_t added() const { return addedCount; }
+    size_t failed() const { return failedCount; }
+
+    /**
+    * Writes {"added": n, "failed": n, "errors": [{"record": i, "error":
+    * text}]}, the shape WaypointLibrary::addMany answers with, plus
+    * "error" when the stream stopped early or the log failed.
+    *
+    * @param Where the json is appended.
+    */
+    void appendReport(string& out) const;
+
+    private:
+
+    WaypointLibrary& library;
+    /**
+    * The bytes of the record being received, from its opening brace.
+    */
+    string pending;
+    // how far pending was scanned, and the state of the scan there.
+    size_t scanned;
+    int depth;
+    bool inString;
+    bool escaped;
+    /**
+    * True while skipping a value that is not an object, up to the next
+    * newline or comma.
+    */
+    bool skipping;
+    /**
+    * The record number of the next record.
+    */
+    size_t record;
+    vector<Waypoint> batch;
+    size_t addedCount;
+    size_t failedCount;
+    vector<pair<size_t, string> > errors;
+    bool logFailed;
+    string fatal;
+
+    void fail(const string& error);
+    void decode(const char* begin, const char* end);
+    void flush();
+};
+
+#endif
@@ -0,0 +1,442 @@
+#include "WaypointJsonLoader.hpp"
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Streaming loader for waypoint json files.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+// Files smaller than this are not worth starting threads for.
+static const size_t BYTES_PER_THREAD = 1 << 20;
+
+static const char* skipSpace(const char* p, const char* end){
+    while(p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')){
+        p++;
+    }
+    return p;
+}
+
+/**
+* Moves past a string whose opening quote is at p.
+*
+* @return Just past the closing quote, or NULL if the string never closes.
+*/
+static const char* skipString(const char* p, const char* end){
+    for(p++; p < end; p++){
+        if(*p == '\\'){
+            p++;
+        }else if(*p == '"'){
+            return p + 1;
+        }
+    }
+    return NULL;
+}
+
+/**
+* Moves past any json value starting at p.
+*
+* @return Just past the value, or NULL if it is cut short.
+*/
+static const char* skipValue(const char* p, const char* end){
+    if(p >= end){
+        return NULL;
+    }
+    if(*p == '"'){
+        return skipString(p, end);
+    }
+    if(*p == '{' || *p == '['){
+        int depth = 0;
+        while(p < end){
+            if(*p == '"'){
+                p = skipString(p, end);
+                if(p == NULL){
+                    return NULL;
+                }
+                continue;
+            }
+            if(*p == '{' || *p == '['){
+                depth++;
+            }else if(*p == '}' || *p == ']'){
+                if(--depth == 0){
+                    return p + 1;
+                }
+            }
+            p++;
+        }
+        return NULL;
+    }
+    // a number, true, false or null.
+    const char* start = p;
+    while(p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' &&
+          *p != '\n' && *p != '\r' && *p != '\t'){
+        p++;
+    }
+    return p == start ? NULL : p;
+}
+
+static void appendUtf8(unsigned code, string& out){
+    if(code < 0x80){
+        out += (char)code;
+    }else if(code < 0x800){
+        out += (char)(0xC0 | (code >> 6));
+        out += (char)(0x80 | (code & 0x3F));
+    }else if(code < 0x10000){
+        out += (char)(0xE0 | (code >> 12));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }else{
+        out += (char)(0xF0 | (code >> 18));
+        out += (char)(0x80 | ((code >> 12) & 0x3F));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+static bool readHex4(const char* p, const char* end, unsigned& code){
+    if(end - p < 4){
+        return false;
+    }
+    code = 0;
+    for(int i = 0; i < 4; i++){
+        char c = p[i];
+        code <<= 4;
+        if(c >= '0' && c <= '9') code |= c - '0';
+        else if(c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+/**
+* Decodes the string whose opening quote is at p.
+*
+* @return Just past the closing quote, or NULL if the string is malformed.
+*/
+static const char* readString(const char* p, const char* end, string& out){
+    out.clear();
+    for(p++; p < end; p++){
+        const char* run = p;
+        while(p < end && *p != '"' && *p != '\\'){
+            p++;
+        }
+        out.append(run, p - run);
+        if(p >= end){
+            return NULL;
+        }
+        if(*p == '"'){
+            return p + 1;
+        }
+        if(++p >= end){
+            return NULL;
+        }
+        switch(*p){
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            unsigned code = 0;
+            if(!readHex4(p + 1, end, code)){
+                return NULL;
+            }
+            p += 4;
+            if(code >= 0xD800 && code < 0xDC00 && end - p > 6 &&
+               p[1] == '\\' && p[2] == 'u'){
+                unsigned low = 0;
+                if(readHex4(p + 3, end, low) && low >= 0xDC00 && low < 0xE000){
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+            }
+            appendUtf8(code, out);
+            break;
+        }
+        default:
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+/**
+* Reads a number at p, copying it out first since the mapped file is not
+* zero terminated.
+*
+* @return Just past the number, or NULL if there is no number at p.
+*/
+static const char* readNumber(const char* p, const char* end, double& value){
+    char buffer[64];
+    size_t length = 0;
+    while(p + length < end && length < sizeof(buffer) - 1 &&
+          std::strchr("+-0123456789.eE", p[length]) != NULL){
+        buffer[length] = p[length];
+        length++;
+    }
+    if(length == 0){
+        return NULL;
+    }
+    buffer[length] = '\0';
+    char* stop = NULL;
+    value = std::strtod(buffer, &stop);
+    if(stop == buffer){
+        return NULL;
+    }
+    return p + (stop - buffer);
+}
+
+/**
+* Decodes one waypoint object spanning [p, end).
+*
+* @return NULL on success, otherwise the position of the error.
+*/
+const char* WaypointJsonLoader::readWaypoint(const char* p, const char* end,
+                                             Waypoint& aWaypoint){
+    string key;
+    // older files spell it "adress"; it counts when "address" is absent.
+    string misspelled;
+    bool spelled = false;
+    aWaypoint.lat = aWaypoint.lon = aWaypoint.ele = 0;
+    aWaypoint.name.clear();
+    aWaypoint.address.clear();
+    p = skipSpace(p, end);
+    if(p >= end || *p != '{'){
+        return p;
+    }
+    p = skipSpace(p + 1, end);
+    if(p < end && *p == '}'){
+        return NULL;
+    }
+    while(p < end){
+        if(*p != '"'){
+            return p;
+        }
+        const char* next = readString(p, end, key);
+        if(next == NULL){
+            return p;
+        }
+        p = skipSpace(next, end);
+        if(p >= end || *p != ':'){
+            return p;
+        }
+        p = skipSpace(p + 1, end);
+        double* number = NULL;
+        string* text = NULL;
+        if(key == "lat") number = &aWaypoint.lat;
+        else if(key == "lon") number = &aWaypoint.lon;
+        else if(key == "ele") number = &aWaypoint.ele;
+        else if(key == "name") text = &aWaypoint.name;
+        else if(key == "address") text = &aWaypoint.address;
+        else if(key == "adress") text = &misspelled;
+        spelled = spelled || text == &aWaypoint.address;
+
+        if(number != NULL && p < end &&
+           (*p == '-' || (*p >= '0' && *p <= '9'))){
+            next = readNumber(p, end, *number);
+        }else if(text != NULL && p < end && *p == '"'){
+            next = readString(p, end, *text);
+        }else{
+            next = skipValue(p, end);
+        }
+        if(next == NULL){
+            return p;
+        }
+        p = skipSpace(next, end);
+        if(p < end && *p == ','){
+            p = skipSpace(p + 1, end);
+        }else if(p < end && *p == '}'){
+            if(!spelled){
+                aWaypoint.address.swap(misspelled);
+            }
+            return NULL;
+        }else{
+            return p;
+        }
+    }
+    return p;
+}
+
+WaypointJsonLoader::WaypointJsonLoader(const string& fileName)
+    : data(NULL), size(0), fd(-1){
+    fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0){
+        message = "cannot open " + fileName;
+        return;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0){
+        message = "cannot stat " + fileName;
+        close(fd);
+        fd = -1;
+        return;
+    }
+    size = info.st_size;
+    if(size > 0){
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped == MAP_FAILED){
+            message = "cannot map " + fileName;
+            return;
+        }
+        data = (const char*)mapped;
+        madvise(mapped, size, MADV_SEQUENTIAL);
+    }
+}
+
+WaypointJsonLoader::~WaypointJsonLoader(){
+    if(data != NULL){
+        munmap((void*)data, size);
+    }
+    if(fd >= 0){
+        close(fd);
+    }
+}
+
+/**
+* Finds where each waypoint object of the file starts and ends, only
+* looking at quotes and brackets.
+*/
+bool WaypointJsonLoader::findSpans(vector<Span>& spans){
+    const char* begin = data;
+    const char* end = data + size;
+    const char* p = skipSpace(begin, end);
+    if(p >= end || (*p != '{' && *p != '[')){
+        message = "expected an object or an array of waypoints";
+        return false;
+    }
+    bool keyed = *p == '{';
+    char close = keyed ? '}' : ']';
+    p = skipSpace(p + 1, end);
+    if(p < end && *p == close){
+        return true;
+    }
+    while(p < end){
+        Span span;
+        span.keyBegin = span.keyEnd = 0;
+        if(keyed){
+            const char* keyEnd = (*p == '"') ? skipString(p, end) : NULL;
+            if(keyEnd == NULL){
+                break;
+            }
+            span.keyBegin = p - begin;
+            span.keyEnd = keyEnd - begin;
+            p = skipSpace(keyEnd, end);
+            if(p >= end || *p != ':'){
+                break;
+            }
+            p = skipSpace(p + 1, end);
+        }
+        const char* valueEnd = skipValue(p, end);
+        if(valueEnd == NULL){
+            break;
+        }
+        span.begin = p - begin;
+        span.end = valueEnd - begin;
+        spans.push_back(span);
+        p = skipSpace(valueEnd, end);
+        if(p < end && *p == ','){
+            p = skipSpace(p + 1, end);
+        }else if(p < end && *p == close){
+            return true;
+        }else{
+            break;
+        }
+    }
+    stringstream error;
+    error << "malformed json at byte " << (p - begin);
+    message = error.str();
+    return false;
+}
+
+bool WaypointJsonLoader::parse(unsigned threads, size_t bucketCount,
+                               size_t (*bucketOf)(const string&),
+                               vector<Buckets>& chunks){
+    chunks.clear();
+    if(!this->isOpen() || size == 0){
+        if(message.empty()){
+            message = "empty file";
+        }
+        return false;
+    }
+    vector<Span> spans;
+    if(!this->findSpans(spans)){
+        return false;
+    }
+
+    size_t byBytes = size / BYTES_PER_THREAD + 1;
+    size_t count = std::min((size_t)std::max(threads, 1u), byBytes);
+    count = std::max((size_t)1, std::min(count, spans.size()));
+    chunks.assign(count, Buckets(bucketCount));
+    vector<size_t> failedAt(count, 0);
+    vector<char> failed(count, false);
+
+    // each worker decodes a contiguous run of spans into its own chunk.
+    auto work = [&](size_t chunk){
+        size_t first = spans.size() * chunk / count;
+        size_t last = spans.size() * (chunk + 1) / count;
+        Waypoint aWaypoint;
+        for(size_t i = first; i < last; i++){
+            const Span& span = spans[i];
+            const char* error = readWaypoint(data + span.begin,
+                                             data + span.end, aWaypoint);
+            if(error != NULL){
+                failed[chunk] = true;
+                failedAt[chunk] = error - data;
+                return;
+            }
+            if(aWaypoint.name.empty() && span.keyEnd > span.keyBegin){
+                readString(data + span.keyBegin, data + span.keyEnd,
+                           aWaypoint.name);
+            }
+            chunks[chunk][bucketOf(aWaypoint.name)].push_back(aWaypoint);
+        }
+    };
+    vector<thread> workers;
+    for(size_t chunk = 1; chunk < count; chunk++){
+        workers.push_back(thread(work, chunk));
+    }
+    work(0);
+    for(size_t i = 0; i < workers.size(); i++){
+        workers[i].join();
+    }
+
+    for(size_t chunk = 0; chunk < count; chunk++){
+        if(failed[chunk]){
+            stringstream error;
+            error << "malformed waypoint at byte " << failedAt[chunk];
+            message = error.str();
+            chunks.clear();
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,114 @@
+#ifndef WAYPOINTJSONLOADER_HPP
+#define WAYPOINTJSONLOADER_HPP
+
+#include <string>
+#include <vector>
+
+#include "Waypoint.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Streaming loader for waypoint json files. The file is mapped
+ * into memory and read in place, without building a Json::Value tree:
+ * a quick first pass only finds where each waypoint object starts and
+ * ends, then the objects are split between threads which decode their
+ * fields straight into Waypoint objects.
+ *
+ * The file is either an object whose members are waypoints keyed by
+ * name, as written by saveToJsonFile, or an array of waypoints.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WaypointJsonLoader {
+
+    public:
+
+    /**
+    * Waypoints grouped by bucket, each bucket in file order.
+    */
+    typedef vector<vector<Waypoint> > Buckets;
+
+    /**
+    * Maps the file. Check isOpen() before parsing.
+    *
+    * @param The name of the json file.
+    */
+    WaypointJsonLoader(const string& fileName);
+    ~WaypointJsonLoader();
+
+    bool isOpen() const { return fd >= 0 && (data != NULL || size == 0); }
+
+    /**
+    * Parses every waypoint in the file.
+    *
+    * @param  How many threads to parse with, at most.
+    * @param  How many buckets to split the waypoints into.
+    * @param  Picks the bucket of a waypoint from its name.
+    * @param  Set to one Buckets per chunk of the file, in file order.
+    * @return True if the whole file parsed, false if not; see error().
+    */
+    bool parse(unsigned threads, size_t bucketCount,
+               size_t (*bucketOf)(const string&), vector<Buckets>& chunks);
+
+    /**
+    * @return What went wrong in the last parse that failed.
+    */
+    const string& error() const { return message; }
+
+    /**
+    * Decodes one waypoint object. Members other than lat, lon, ele, name
+    * and address are skipped, and missing ones are left 0 or empty. The
+    * address is read from "adress", as older files spell it, when there
+    * is no "address".
+    *
+    * @param  Where the object starts, leading spaces allowed.
+    * @param  Where the object ends.
+    * @param  Set to the waypoint.
+    * @return NULL on success, otherwise the position of the error.
+    */
+    static const char* readWaypoint(const char* p, const char* end,
+                                    Waypoint& aWaypoint);
+
+    private:
+
+    /**
+    * Where one waypoint object sits in the file, and the member key it was
+    * stored under, if any.
+    */
+    struct Span {
+        size_t begin;
+        size_t end;
+        size_t keyBegin;
+        size_t keyEnd;
+    };
+
+    const char* data;
+    size_t size;
+    int fd;
+    string message;
+
+    WaypointJsonLoader(const WaypointJsonLoader&) = delete;
+    WaypointJsonLoader& operator=(const WaypointJsonLoader&) = delete;
+
+    bool findSpans(vector<Span>& spans);
+};
+
+#endif
@@ -3,8 +3,20 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
-#include <sstream> 
-#include <iomanip> // setprecision
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <shared_mutex>
+
+#include <thread>
+#include <chrono>
+
+#include "DistanceKernel.hpp"
+#include "Logger.hpp"
+#include "WaypointJsonLoader.hpp"
+#include "WaypointSnapshot.hpp"
+#include "Metrics.hpp"
 
 
 /**
@@ -30,19 +42,34 @@
  * @version January 2018
  */
 
+const int WaypointLibrary::DEFAULT_PAGE;
+const int WaypointLibrary::MAX_PAGE;
+const int WaypointLibrary::DEFAULT_SEARCH;
+const int WaypointLibrary::MAX_SEARCH;
+constexpr double WaypointLibrary::MIN_SIMILARITY;
+const size_t WaypointLibrary::MAX_QUERY;
+
 /**
 * No parameter constructor. Just creates an empty Vector.
 */
-WaypointLibrary::WaypointLibrary(){}
+WaypointLibrary::WaypointLibrary() : fileName("waypoints.json"),
+                                     snapshotName("waypoints.snap"),
+                                     snapshotGeneration(0), stopping(false),
+                                     checkpointBytes(0),
+                                     precision(Geodesic::SPHERE), changes(0),
+                                     namesJsonRevision(0){}
 
 /**
 * Waypoint Library constructor that takes a list as an argument.
 *
 * @param An old list of waypoints to initialize the library.
 */
-WaypointLibrary::WaypointLibrary(vector<Waypoint> oldLibrary){
-    for (int i=0; i<oldLibrary.size(); i++)
-        this->library.push_back(oldLibrary[i]);
+WaypointLibrary::WaypointLibrary(const vector<Waypoint>& oldLibrary)
+    : fileName("waypoints.json"), snapshotName("waypoints.snap"),
+      snapshotGeneration(0), stopping(false), checkpointBytes(0),
+      precision(Geodesic::SPHERE), changes(0), namesJsonRevision(0){
+    for (size_t i=0; i<oldLibrary.size(); i++)
+        this->insert(oldLibrary[i]);
 }
 
 /**
@@ -50,34 +77,110 @@ WaypointLibrary::WaypointLibrary(vector<Waypoint> oldLibrary){
 * 
 * @param The name of the json file.
 */
-WaypointLibrary::WaypointLibrary(string jsonFileName){
-    
-    std::ifstream infile;
-    Json::Value root;
-    Json::Reader reader;
-    infile.open("waypoints.json");      
-    string data((std::istreambuf_iterator<char>(infile)),
-                 std::istreambuf_iterator<char>());  
-    // close the opened file.
-    infile.close();
-    bool parsingSuccessful = reader.parse( data, root );
-    if (!parsingSuccessful){
-        // report to the user the failure and their locations in the document.
-        std::cout  << "Failed to parse configuration\n"
-                   << reader.getFormattedErrorMessages();
-        return;
+WaypointLibrary::WaypointLibrary(const string& jsonFileName)
+                                   : fileName(jsonFileName),
+                                     snapshotName("waypoints.snap"),
+                                     snapshotGeneration(0), stopping(false),
+                                     checkpointBytes(0),
+                                     precision(Geodesic::SPHERE), changes(0),
+                                     namesJsonRevision(0){
+    this->loadJsonFile();
+}
+
+/**
+* Waypoint Library constructor that starts from a binary snapshot when
+* one can be read, and from the json file otherwise.
+*
+* @param The name of the json file.
+* @param The name of the snapshot file.
+*/
+WaypointLibrary::WaypointLibrary(const string& jsonFileName,
+                                 const string& snapshotFileName)
+    : fileName(jsonFileName), snapshotName(snapshotFileName),
+      snapshotGeneration(0), stopping(false), checkpointBytes(0),
+      precision(Geodesic::SPHERE), changes(0), namesJsonRevision(0){
+    if(!this->loadSnapshot()){
+        this->loadJsonFile();
     }
-    
-    for(Json::Value::iterator i= root.begin(); i != root.end(); i++){
-        std::cout << (*i)["name"].asString() << endl;
+}
+
+/**
+* Stops the checkpoint thread and closes the log, if any.
+*/
+WaypointLibrary::~WaypointLibrary(){
+    {
+        lock_guard<mutex> lock(checkpointMutex);
+        stopping = true;
+    }
+    checkpointWake.notify_one();
+    if(checkpointer.joinable()){
+        checkpointer.join();
     }
+    log.reset();
+}
 
-    for (Json::Value::iterator i= root.begin(); i != root.end(); i++){
-        Waypoint aWaypoint((*i));
-        this->library.push_back(aWaypoint);
+/**
+* Recovers the mutations logged since the loaded snapshot, then logs
+* every mutation from here on.
+*
+* @param  The path the log generation numbers are appended to.
+* @param  How many bytes of log trigger a checkpoint, 0 for never.
+* @return True if the log was replayed and opened, false if not.
+*/
+bool WaypointLibrary::openLog(const string& prefix, uint64_t checkpointEvery){
+    lock_guard<mutex> lock(fileMutex);
+    size_t replayed;
+    {
+        Metrics::Call call(Metrics::PERSISTENCE, "replay_log");
+        replayed = WaypointLog::replay(prefix, snapshotGeneration,
+            [this](bool remove, const Waypoint& aWaypoint){
+                this->apply(remove, aWaypoint);
+            });
+        call.succeeded();
     }
+    LOG_INFO("Replayed " << replayed << " log records from " << prefix);
 
+    vector<uint64_t> generations = WaypointLog::generations(prefix);
+    uint64_t last = snapshotGeneration;
+    if(!generations.empty()){
+        last = std::max(last, generations.back());
+    }
+    log.reset(new WaypointLog(prefix));
+    if(!log->open(last)){
+        log.reset();
+        return false;
+    }
+    // start over from a fresh snapshot and generation, since the last
+    // generation may end with a torn record that must not be appended to.
+    if(!this->writeSnapshot()){
+        return false;
+    }
+    checkpointBytes = checkpointEvery;
+    if(checkpointBytes > 0){
+        checkpointer = thread(&WaypointLibrary::checkpointLoop, this);
+    }
+    return true;
+}
 
+/**
+* Sets the precision distances are measured at.
+*
+* @param The precision.
+*/
+void WaypointLibrary::setPrecision(Geodesic::Precision aPrecision){
+    precision = aPrecision;
+}
+
+Geodesic::Precision WaypointLibrary::getPrecision() const{
+    return precision;
+}
+
+/**
+* Distance in kilometers between two positions at the precision set.
+*/
+double WaypointLibrary::distanceKm(double lat1, double lon1,
+                                   double lat2, double lon2) const{
+    return Geodesic::distanceKm(precision, lat1, lon1, lat2, lon2);
 }
 
 /**
@@ -88,9 +191,14 @@ WaypointLibrary::WaypointLibrary(string jsonFileName){
 string WaypointLibrary::toJSONstring(){
     string ret = "";
     Json::Value obj;
-    for (int i = 0; i < this->library.size(); i++){
-        cout << "Converting to JSON STR:" << this->library[i].name << endl;
-        obj[this->library[i].name] = this->library[i].toJSONObject();
+    for (int s = 0; s < SHARDS; s++){
+        shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+        WaypointShard& shard = shards[s];
+        for (size_t i = 0; i < shard.size(); i++){
+            Waypoint aWaypoint = shard.at(i);
+            LOG_DEBUG("Converting to JSON STR:" << aWaypoint.name);
+            obj[aWaypoint.name] = aWaypoint.toJSONObject();
+        }
     }
     ret = obj.toStyledString();
     return ret;
@@ -104,8 +212,116 @@ string WaypointLibrary::toJSONstring(){
 */
 bool WaypointLibrary::add(const Json::Value& aWaypointJson){
     Waypoint aWaypoint(aWaypointJson);
-    this->library.push_back(aWaypoint);
-    return true;
+    return this->insert(aWaypoint);
+}
+
+/**
+* Adds many waypoints at once, locking each shard once.
+*
+* @param  The waypoints to add.
+* @return False if the log could not be written, true otherwise.
+*/
+bool WaypointLibrary::addMany(const vector<Waypoint>& waypoints){
+    // the waypoints of each shard, in the order given.
+    vector<size_t> byShard[SHARDS];
+    for(size_t i = 0; i < waypoints.size(); i++){
+        byShard[shardOf(waypoints[i].name)].push_back(i);
+    }
+    uint64_t ticket = 0;
+    for(int s = 0; s < SHARDS; s++){
+        const vector<size_t>& mine = byShard[s];
+        if(mine.empty()){
+            continue;
+        }
+        unique_lock<shared_timed_mutex> lock(shards[s].mutex);
+        shards[s].grow(mine.size());
+        for(size_t i = 0; i < mine.size(); i++){
+            const Waypoint& aWaypoint = waypoints[mine[i]];
+            shards[s].insert(aWaypoint);
+            if(log){
+                ticket = log->appendPut(aWaypoint.lat, aWaypoint.lon,
+                                        aWaypoint.ele, aWaypoint.name,
+                                        aWaypoint.address);
+            }
+        }
+        changes.fetch_add(1, memory_order_release);
+    }
+    // tickets only grow, so the last one covers every record.
+    return ticket == 0 || log->waitDurable(ticket);
+}
+
+/**
+* Reads the fields of a waypoint object the way the json loader does,
+* with address spelled as toJSONObject writes it.
+*
+* @return NULL if it is a waypoint, otherwise what is wrong with it.
+*/
+static const char* fromJson(const Json::Value& object, Waypoint& aWaypoint){
+    if(!object.isObject()){
+        return "not an object";
+    }
+    static const char* NUMBERS[] = { "lat", "lon", "ele" };
+    double* fields[] = { &aWaypoint.lat, &aWaypoint.lon, &aWaypoint.ele };
+    for(int i = 0; i < 3; i++){
+        const Json::Value& value = object[NUMBERS[i]];
+        if(!value.isNull() && !value.isNumeric()){
+            return "lat, lon and ele must be numbers";
+        }
+        *fields[i] = value.isNull() ? 0.0 : value.asDouble();
+    }
+    const Json::Value& name = object["name"];
+    // older files spell it "adress", as Waypoint(const Json::Value&) reads.
+    const Json::Value& address = object.isMember("address")
+                                     ? object["address"] : object["adress"];
+    if(!name.isString() || name.asString().empty()){
+        return "missing name";
+    }
+    if(!address.isNull() && !address.isString()){
+        return "address must be a string";
+    }
+    aWaypoint.name = name.asString();
+    aWaypoint.address = address.isNull() ? string() : address.asString();
+    return NULL;
+}
+
+/**
+* Adds an array of waypoint objects, skipping the ones that are not
+* waypoints.
+*
+* @param  The json array of waypoints.
+* @return How many were added and which ones were skipped.
+*/
+Json::Value WaypointLibrary::addMany(const Json::Value& waypoints){
+    Json::Value ret(Json::objectValue);
+    Json::Value errors(Json::arrayValue);
+    vector<Waypoint> batch;
+    size_t failed = 0;
+    Json::ArrayIndex count = waypoints.isArray() ? waypoints.size() : 0;
+    batch.reserve(count);
+    for(Json::ArrayIndex i = 0; i < count; i++){
+        Waypoint aWaypoint;
+        const char* error = fromJson(waypoints[i], aWaypoint);
+        if(error != NULL){
+            if(failed++ < MAX_ERRORS){
+                Json::Value entry(Json::objectValue);
+                entry["record"] = i;
+                entry["error"] = error;
+                errors.append(entry);
+            }
+            continue;
+        }
+        batch.push_back(std::move(aWaypoint));
+    }
+    bool logged = this->addMany(batch);
+    LOG_INFO("Added " << batch.size() << " waypoints in bulk, skipped "
+             << failed);
+    ret["added"] = (Json::UInt64)batch.size();
+    ret["failed"] = (Json::UInt64)failed;
+    ret["errors"] = errors;
+    if(!logged){
+        ret["error"] = "not written to the log";
+    }
+    return ret;
 }
 
 /**
@@ -114,32 +330,24 @@ bool WaypointLibrary::add(const Json::Value& aWaypointJson){
 * @param A Waypoint object to be added to the library
 * @return True if successful and false if don't.
 */
-bool WaypointLibrary::addNew(string lat, string lon, string ele, string name, string address){
-    bool ret = false;
+bool WaypointLibrary::addNew(const string& lat, const string& lon,
+                             const string& ele, const string& name,
+                             const string& address){
     std::string::size_type sz;
     double latitude = std::stod (lat,&sz);
     double longitude = std::stod (lon,&sz);
     double elevation = std::stod (ele,&sz);
-    Waypoint temp(latitude, longitude, elevation, name, address);
-    
-    this->library.push_back(temp);
-    ret = true;
-    return true;
+    return this->emplace(latitude, longitude, elevation, name, address);
 }
 
-bool WaypointLibrary::updateWaypoint(string lat, string lon, string ele, string name, string address){
-    bool ret = false;
+bool WaypointLibrary::updateWaypoint(const string& lat, const string& lon,
+                                     const string& ele, const string& name,
+                                     const string& address){
     std::string::size_type sz;
     double latitude = std::stod (lat,&sz);
     double longitude = std::stod (lon,&sz);
     double elevation = std::stod (ele,&sz);
-    this->remove(name);
-    Waypoint temp(latitude,longitude,elevation,name,address);
-    this->library.push_back(temp); 
-    ret = true;
-
-    return ret;
-    
+    return this->emplace(latitude, longitude, elevation, name, address);
 }
 
 /**
@@ -148,16 +356,21 @@ bool WaypointLibrary::updateWaypoint(string lat, string lon, string ele, string
 * @param  The name of the waypoint that needs to be removed.
 * @return True if the waypoint was removed successfully, false if don't.
 */
-bool WaypointLibrary::remove(string name){
-    bool ret = false;
-    for(int i = 0; i < library.size(); i++){
-        Waypoint temp = library[i];
-        if(name.compare(temp.name) == 0){
-            library.erase(library.begin()+i);
-            bool ret = true;
+bool WaypointLibrary::remove(const string& name){
+    WaypointShard& shard = this->shardFor(name);
+    uint64_t ticket = 0;
+    {
+        unique_lock<shared_timed_mutex> lock(shard.mutex);
+        if(!shard.remove(name)){
+            return false;
+        }
+        changes.fetch_add(1, memory_order_release);
+        if(log){
+            ticket = log->appendRemove(name);
         }
     }
-    return ret;
+    // wait for the disk only after letting go of the shard.
+    return ticket == 0 || log->waitDurable(ticket);
 }
 
 /**
@@ -166,15 +379,87 @@ bool WaypointLibrary::remove(string name){
 * @param  The the name of the waypoint that needs to be returned.
 * @return The waypoint that has the name.
 */
-Json::Value  WaypointLibrary::get(string name){
+Json::Value  WaypointLibrary::get(const string& name){
     Waypoint toReturn;
-    for(int i = 0; i < library.size(); i++){
-        if(name.compare(library[i].name) == 0){
-            toReturn = library[i];
+    WaypointShard& shard = this->shardFor(name);
+    {
+        shared_lock<shared_timed_mutex> lock(shard.mutex);
+        shard.find(name, toReturn);
+    }
+    Json::Value ret = toReturn.toJSONObject();
+    LOG_DEBUG(ret.toStyledString());
+    return ret;
+}
+
+bool WaypointLibrary::appendJson(const string& name, string& out){
+    WaypointShard& shard = this->shardFor(name);
+    shared_lock<shared_timed_mutex> lock(shard.mutex);
+    return shard.appendJson(name, out);
+}
+
+/**
+* Appends the json array getNames returns, copying out the last one
+* written if the revision has not moved since.
+*
+* @param  Where the array is appended.
+* @return How many names the array holds.
+*/
+size_t WaypointLibrary::appendNamesJson(string& out){
+    // read before the shards, so a change made while they are walked
+    // leaves the array tagged older than it is and it is written again.
+    uint64_t now = changes.load(memory_order_acquire);
+    shared_ptr<const NamesJson> names;
+    {
+        lock_guard<mutex> guard(namesJsonMutex);
+        if(namesJson && namesJsonRevision == now){
+            names = namesJson;
+        }
+    }
+    if(!names){
+        shared_ptr<NamesJson> built = make_shared<NamesJson>();
+        built->text += '[';
+        built->count = 0;
+        for(int s = 0; s < SHARDS; s++){
+            shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+            if(shards[s].size() == 0){
+                continue;
+            }
+            if(built->count > 0){
+                built->text += ',';
+            }
+            shards[s].appendNamesJson(built->text);
+            built->count += shards[s].size();
+        }
+        built->text += ']';
+        names = built;
+        lock_guard<mutex> guard(namesJsonMutex);
+        if(!namesJson || namesJsonRevision < now){
+            namesJson = names;
+            namesJsonRevision = now;
         }
     }
-    std::cout << toReturn.toJSONObject() << endl;
-    return toReturn.toJSONObject();
+    // copied after letting go of the lock; the array itself never changes.
+    out += names->text;
+    return names->count;
+}
+
+uint64_t WaypointLibrary::revision() const{
+    return changes.load(memory_order_acquire);
+}
+
+size_t WaypointLibrary::size(){
+    size_t count = 0;
+    for(int s = 0; s < SHARDS; s++){
+        shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+        count += shards[s].size();
+    }
+    return count;
+}
+
+bool WaypointLibrary::position(const string& name, double& aLat, double& aLon){
+    WaypointShard& shard = this->shardFor(name);
+    shared_lock<shared_timed_mutex> lock(shard.mutex);
+    return shard.position(name, aLat, aLon);
 }
 
 /**
@@ -184,34 +469,16 @@ Json::Value  WaypointLibrary::get(string name){
 *          False if not.
 */
 bool WaypointLibrary::resetFromJsonFile(){
-    bool ret = false;
-    this->library.clear();
-    std::ifstream infile;
-    Json::Value root;
-    Json::Reader reader;
-    infile.open("waypoints.json");      
-    string data((std::istreambuf_iterator<char>(infile)),
-                 std::istreambuf_iterator<char>());  
-    // close the opened file.
-    infile.close();
-    bool parsingSuccessful = reader.parse( data, root );
-    if (parsingSuccessful){
-        // report to the user the failure and their locations in the document.
-        std::cout  << "Failed to parse configuration\n"
-                   << reader.getFormattedErrorMessages();
-        for(Json::Value::iterator i= root.begin(); i != root.end(); i++){
-        std::cout << (*i)["name"].asString() << endl;
-        }
-
-        for (Json::Value::iterator i= root.begin(); i != root.end(); i++){
-            Waypoint aWaypoint((*i));
-            this->library.push_back(aWaypoint);
-        }
-        ret = true;
-        std::cout << "Done importing waypoints in from waypoints.json" << endl;
+    lock_guard<mutex> lock(fileMutex);
+    bool ret = this->loadJsonFile();
+    if (ret && log){
+        // the reload is not in the log, so it has to be checkpointed.
+        ret = this->writeSnapshot();
+    }
+    if (ret){
+        LOG_INFO("Done importing waypoints in from " << fileName);
     }
-    
-    return ret;    
+    return ret;
 }
 
 /**
@@ -221,17 +488,50 @@ bool WaypointLibrary::resetFromJsonFile(){
 *          False if not.
 */
 bool WaypointLibrary::saveToJsonFile(){
-        
-        ofstream outfile;
-        outfile.open("waypoints.json");
+        lock_guard<mutex> lock(fileMutex);
+        Metrics::Call call(Metrics::PERSISTENCE, "save_json");
         string data = this->toJSONstring();
-        // write inputted data into the file.
-        outfile << data << endl;
-        outfile.close();
-        cout << "Done exporting library to waypoints.json" << endl;
+        data += "\n";
+        // write inputted data into a new file that replaces the old one,
+        // so a crash half way leaves the previous save intact.
+        string error;
+        if(!WaypointSnapshot::writeFile(fileName, data, error)){
+            LOG_ERROR("Failed to save " << fileName << ": " << error);
+            return false;
+        }
+        LOG_INFO("Done exporting library to " << fileName);
+        call.succeeded();
         return true;
 }
 
+/**
+* Replaces the library content with the binary snapshot.
+*
+* @return True if the snapshot was read, false if it is missing or
+*         damaged, in which case the library is left as it was.
+*/
+bool WaypointLibrary::resetFromSnapshot(){
+    lock_guard<mutex> lock(fileMutex);
+    bool ret = this->loadSnapshot();
+    if (ret && log){
+        ret = this->writeSnapshot();
+    }
+    if (ret){
+        LOG_INFO("Done importing waypoints in from " << snapshotName);
+    }
+    return ret;
+}
+
+/**
+* Writes every waypoint to the binary snapshot.
+*
+* @return True if the snapshot was written, false if not.
+*/
+bool WaypointLibrary::saveToSnapshot(){
+    lock_guard<mutex> lock(fileMutex);
+    return this->writeSnapshot();
+}
+
 /**
 * This method collects all the the waypoint names in the library and returns them.
 * 
@@ -241,8 +541,11 @@ Json::Value WaypointLibrary::getNames(){
     Json::Value ret(Json::arrayValue);
     vector<string> myVec;
 
-    for(int i = 0; i < library.size(); i++){
-        myVec.push_back(this->library[i].name);
+    for(int s = 0; s < SHARDS; s++){
+        shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+        for(size_t i = 0; i < shards[s].size(); i++){
+            myVec.push_back(shards[s].names[i].str());
+        }
     }
     for(std::vector<string>::iterator it = myVec.begin(); it!=myVec.end();++it) {
         ret.append(Json::Value(*it));
@@ -250,28 +553,715 @@ Json::Value WaypointLibrary::getNames(){
     return ret;
 }
 
-string WaypointLibrary::distanceAndBearing(string waypoint1, string waypoint2){
-    Waypoint * wpnt1 = new Waypoint(this->get(waypoint1));
-    Waypoint * wpnt2 = new Waypoint(this->get(waypoint2));
+/**
+* A cursor is the shard and the last name of a page, as "shard:name". A
+* page holds at least one waypoint, so there is always a last name.
+*/
+string WaypointLibrary::walkPage(const string& cursor, size_t limit,
+                                 const function<void(const WaypointShard&,
+                                                     size_t)>& visit,
+                                 bool& valid){
+    limit = std::max<size_t>(limit, 1);
+    int first = 0;
+    StringArena::Text after;
+    valid = true;
+    if(!cursor.empty()){
+        char* stop = NULL;
+        long shard = strtol(cursor.c_str(), &stop, 10);
+        valid = stop != cursor.c_str() && *stop == ':' &&
+                shard >= 0 && shard < SHARDS;
+        if(!valid){
+            return "";
+        }
+        first = shard;
+        after = StringArena::Text(stop + 1,
+                                  cursor.size() - (stop + 1 - cursor.c_str()));
+    }
+    vector<size_t> slots;
+    size_t count = 0;
+    for(int s = first; s < SHARDS; s++){
+        shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+        slots.clear();
+        shards[s].slotsAfter(s == first && !cursor.empty() ? &after : NULL,
+                             limit - count, slots);
+        for(size_t i = 0; i < slots.size(); i++){
+            visit(shards[s], slots[i]);
+        }
+        count += slots.size();
+        if(count >= limit){
+            return to_string(s) + ":" + shards[s].names[slots.back()].str();
+        }
+    }
+    return "";
+}
 
-    double distance = wpnt1->distanceGCTo(*wpnt2,0);
-    double bearing = wpnt1->bearingGCInitTo(*wpnt2,0);
+/**
+* Clamps a requested page size.
+*/
+static size_t pageLimit(int limit){
+    if(limit < 1){
+        return WaypointLibrary::DEFAULT_PAGE;
+    }
+    return std::min(limit, WaypointLibrary::MAX_PAGE);
+}
 
-    stringstream stream1, stream2;
-    string toReturn = "";
+Json::Value WaypointLibrary::getNamesPage(const string& cursor, int limit){
+    Json::Value ret(Json::objectValue);
+    Json::Value& names = ret["names"] = Json::Value(Json::arrayValue);
+    bool valid = true;
+    string next = this->walkPage(cursor, pageLimit(limit),
+        [&names](const WaypointShard& shard, size_t slot){
+            names.append(shard.names[slot].str());
+        }, valid);
+    ret["next"] = next.empty() ? Json::Value() : Json::Value(next);
+    if(!valid){
+        ret["error"] = "invalid cursor";
+    }
+    return ret;
+}
 
-    stream1 << fixed << std::setprecision(2) << distance;
+Json::Value WaypointLibrary::listWaypoints(const string& cursor, int limit,
+                                           const Json::Value& fields){
+    // which of lat, lon, ele, name and address to return.
+    static const char* FIELDS[] = { "lat", "lon", "ele", "name", "address" };
+    bool wanted[5] = { false, false, false, false, false };
+    bool any = false;
+    for(Json::ArrayIndex i = 0; fields.isArray() && i < fields.size(); i++){
+        for(int f = 0; f < 5; f++){
+            if(fields[i].isString() && fields[i].asString() == FIELDS[f]){
+                wanted[f] = any = true;
+            }
+        }
+    }
+    for(int f = 0; f < 5 && !any; f++){
+        wanted[f] = true;
+    }
+    Json::Value ret(Json::objectValue);
+    Json::Value& waypoints = ret["waypoints"] = Json::Value(Json::arrayValue);
+    bool valid = true;
+    string next = this->walkPage(cursor, pageLimit(limit),
+        [&waypoints, &wanted](const WaypointShard& shard, size_t slot){
+            Json::Value& object = waypoints.append(
+                Json::Value(Json::objectValue));
+            if(wanted[0]) object["lat"] = shard.lat[slot];
+            if(wanted[1]) object["lon"] = shard.lon[slot];
+            if(wanted[2]) object["ele"] = shard.ele[slot];
+            if(wanted[3]) object["name"] = shard.names[slot].str();
+            if(wanted[4]) object["address"] = shard.addresses[slot].str();
+        }, valid);
+    ret["next"] = next.empty() ? Json::Value() : Json::Value(next);
+    if(!valid){
+        ret["error"] = "invalid cursor";
+    }
+    return ret;
+}
 
-    toReturn += stream1.str() + " miles at ";
+string WaypointLibrary::appendJsonPage(const string& cursor, size_t limit,
+                                       string& out){
+    bool valid = true;
+    return this->walkPage(cursor, limit,
+        [&out](const WaypointShard& shard, size_t slot){
+            shard.appendJsonAt(slot, out);
+            out += '\n';
+        }, valid);
+}
 
-    stream2 << fixed << std::setprecision(2) << bearing;
+Json::Value WaypointLibrary::searchNames(const string& query, int limit){
+    size_t wanted = limit < 1 ? DEFAULT_SEARCH : std::min(limit, MAX_SEARCH);
+    string text = query.substr(0, MAX_QUERY);
+    // every shard's best, merged.
+    vector<string> found;
+    vector<size_t> slots;
+    for(int s = 0; s < SHARDS; s++){
+        shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+        slots.clear();
+        shards[s].slotsWithPrefix(text, wanted, slots);
+        for(size_t i = 0; i < slots.size(); i++){
+            found.push_back(shards[s].names[slots[i]].str());
+        }
+    }
+    sort(found.begin(), found.end(), [](const string& a, const string& b){
+        return WaypointNameIndex::compare(StringArena::Text(a),
+                                          StringArena::Text(b)) < 0;
+    });
+    if(found.size() > wanted){
+        found.resize(wanted);
+    }
+    if(found.size() < wanted && !text.empty()){
+        vector<pair<double, string> > similar;
+        vector<pair<double, size_t> > scored;
+        for(int s = 0; s < SHARDS; s++){
+            shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+            scored.clear();
+            shards[s].slotsSimilar(text, MIN_SIMILARITY, scored);
+            // no shard gives more than could be returned; some of them
+            // may be among the names found by prefix.
+            size_t keep = wanted + found.size();
+            if(scored.size() > keep){
+                nth_element(scored.begin(), scored.begin() + keep,
+                            scored.end(), greater<pair<double, size_t> >());
+                scored.resize(keep);
+            }
+            for(size_t i = 0; i < scored.size(); i++){
+                similar.push_back(make_pair(scored[i].first,
+                    shards[s].names[scored[i].second].str()));
+            }
+        }
+        // most similar first, then by name.
+        sort(similar.begin(), similar.end(),
+             [](const pair<double, string>& a, const pair<double, string>& b){
+                 return a.first != b.first ? a.first > b.first
+                                           : a.second < b.second;
+             });
+        size_t prefixed = found.size();
+        for(size_t i = 0; i < similar.size() && found.size() < wanted; i++){
+            // the names that start with the query are in already.
+            if(std::find(found.begin(), found.begin() + prefixed,
+                         similar[i].second) == found.begin() + prefixed){
+                found.push_back(similar[i].second);
+            }
+        }
+    }
+    Json::Value ret(Json::arrayValue);
+    for(size_t i = 0; i < found.size(); i++){
+        ret.append(found[i]);
+    }
+    return ret;
+}
 
-    toReturn += stream2.str() + " degrees ";
+Json::Value WaypointLibrary::searchAddress(const string& terms, int limit){
+    size_t wanted = limit < 1 ? DEFAULT_SEARCH : std::min(limit, MAX_SEARCH);
+    vector<string> words;
+    WaypointAddressIndex::termsOf(terms.data(),
+                                  std::min(terms.size(), MAX_QUERY), words);
+    vector<string> found;
+    vector<size_t> slots;
+    for(int s = 0; s < SHARDS; s++){
+        shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+        slots.clear();
+        // only the first names of each shard can be among the first.
+        shards[s].slotsWithAddress(words, wanted, slots);
+        for(size_t i = 0; i < slots.size(); i++){
+            found.push_back(shards[s].names[slots[i]].str());
+        }
+    }
+    sort(found.begin(), found.end(), [](const string& a, const string& b){
+        return WaypointNameIndex::compare(StringArena::Text(a),
+                                          StringArena::Text(b)) < 0;
+    });
+    Json::Value ret(Json::arrayValue);
+    for(size_t i = 0; i < found.size() && i < wanted; i++){
+        ret.append(found[i]);
+    }
+    return ret;
+}
+
+Json::Value WaypointLibrary::searchAddressWithin(const string& terms,
+                                                 double lat, double lon,
+                                                 double radius, int scale,
+                                                 int limit){
+    size_t wanted = limit < 1 ? DEFAULT_SEARCH : std::min(limit, MAX_SEARCH);
+    double radiusKm = Waypoint::fromScale(radius, scale);
+    vector<string> words;
+    WaypointAddressIndex::termsOf(terms.data(),
+                                  std::min(terms.size(), MAX_QUERY), words);
+    vector<pair<double, string> > found;
+    vector<pair<double, size_t> > slots;
+    Geodesic::Precision at = precision;
+    for(int s = 0; s < SHARDS; s++){
+        shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+        slots.clear();
+        shards[s].slotsWithAddressWithin(words, lat, lon, radiusKm, at, slots);
+        if(slots.size() > wanted){
+            nth_element(slots.begin(), slots.begin() + wanted, slots.end());
+            slots.resize(wanted);
+        }
+        for(size_t i = 0; i < slots.size(); i++){
+            found.push_back(make_pair(slots[i].first,
+                                      shards[s].names[slots[i].second].str()));
+        }
+    }
+    std::sort(found.begin(), found.end());
+    return toDistanceList(found, wanted, scale);
+}
+
+string WaypointLibrary::distanceAndBearing(const string& waypoint1,
+                                           const string& waypoint2){
+    // only the positions are needed; a missing waypoint stays at 0,0.
+    double lat1 = 0, lon1 = 0, lat2 = 0, lon2 = 0;
+    this->position(waypoint1, lat1, lon1);
+    this->position(waypoint2, lat2, lon2);
+    double distance = Waypoint::toScale(this->distanceKm(lat1, lon1,
+                                                         lat2, lon2),
+                                        Waypoint::STATUTE);
+    double bearing = Waypoint::bearingGC(lat1, lon1, lat2, lon2);
+    char text[128];
+    snprintf(text, sizeof(text), "%.2f miles at %.2f degrees ", distance,
+             bearing);
+    return text;
+}
+
+/**
+* Finds the waypoints closest to the named one, not counting itself.
+*
+* @param  The name of the waypoint to search around.
+* @param  How many waypoints to return at most.
+* @return An array of {name, distance} objects, closest first, with
+*         distances in statute miles.
+*/
+Json::Value WaypointLibrary::nearest(const string& name, int k){
+    double lat = 0.0;
+    double lon = 0.0;
+    WaypointShard& shard = this->shardFor(name);
+    {
+        shared_lock<shared_timed_mutex> lock(shard.mutex);
+        if(!shard.position(name, lat, lon)){
+            return Json::Value(Json::arrayValue);
+        }
+    }
+    if(k <= 0){
+        return Json::Value(Json::arrayValue);
+    }
+    vector<pair<double, string> > found =
+        this->nearestAll(lat, lon, (size_t)k + 1);
+    for(size_t i = 0; i < found.size(); i++){
+        if(found[i].second == name){
+            found.erase(found.begin() + i);
+            break;
+        }
+    }
+    return toDistanceList(found, k, Waypoint::STATUTE);
+}
+
+/**
+* Finds the waypoints closest to a position.
+*
+* @param  Latitude in degrees.
+* @param  Longitude in degrees.
+* @param  How many waypoints to return at most.
+* @return An array of {name, distance} objects, closest first, with
+*         distances in statute miles.
+*/
+Json::Value WaypointLibrary::nearestTo(double lat, double lon, int k){
+    if(k <= 0){
+        return Json::Value(Json::arrayValue);
+    }
+    vector<pair<double, string> > found = this->nearestAll(lat, lon, k);
+    return toDistanceList(found, k, Waypoint::STATUTE);
+}
+
+/**
+* Finds the waypoints within a radius of a position.
+*
+* @param  Latitude in degrees.
+* @param  Longitude in degrees.
+* @param  The radius, in the units selected by scale.
+* @param  Waypoint::STATUTE, Waypoint::NAUTICAL or Waypoint::KMETER.
+* @return An array of {name, distance} objects, closest first, with
+*         distances in the units selected by scale.
+*/
+Json::Value WaypointLibrary::withinRadius(double lat, double lon, double radius,
+                                          int scale){
+    double radiusKm = Waypoint::fromScale(radius, scale);
+    vector<pair<double, string> > found;
+    Geodesic::Precision at = precision;
+    for(int s = 0; s < SHARDS; s++){
+        shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+        shards[s].withinRadius(lat, lon, radiusKm, at, found);
+    }
+    std::sort(found.begin(), found.end());
+    return toDistanceList(found, found.size(), scale);
+}
+
+/**
+* Computes the great circle distance between every pair of the named
+* waypoints in a single pass.
+*
+* @param  A json array of waypoint names.
+* @param  Waypoint::STATUTE, Waypoint::NAUTICAL or Waypoint::KMETER.
+* @return A json array with one row per name, each holding the distance
+*         to every name in the same order. Rows and columns of names
+*         not in the library are null.
+*/
+Json::Value WaypointLibrary::distanceMatrix(const Json::Value& names, int scale){
+    Json::Value ret(Json::arrayValue);
+    if(!names.isArray()){
+        return ret;
+    }
+    // positions of the names that were found, and where each name landed.
+    DistanceKernel::Points points;
+    vector<pair<double, double> > positions;
+    vector<int> column(names.size(), -1);
+    for(Json::ArrayIndex i = 0; i < names.size(); i++){
+        // anything but a string names no waypoint, like an unknown name.
+        if(!names[i].isString()){
+            continue;
+        }
+        string name = names[i].asString();
+        double lat = 0.0;
+        double lon = 0.0;
+        WaypointShard& shard = this->shardFor(name);
+        shared_lock<shared_timed_mutex> lock(shard.mutex);
+        if(shard.position(name, lat, lon)){
+            column[i] = points.size();
+            points.add(lat, lon);
+            positions.push_back(make_pair(lat, lon));
+        }
+    }
+
+    // the kernel is the sphere, and already cheaper than the fast
+    // approximation; the ellipsoid has no shortcut and goes pair by pair.
+    vector<double> distances;
+    size_t found = points.size();
+    if(precision == Geodesic::ELLIPSOID){
+        distances.assign(found * found, 0.0);
+        for(size_t i = 0; i < found; i++){
+            for(size_t j = i + 1; j < found; j++){
+                double km = Geodesic::ellipsoidKm(positions[i].first,
+                                                  positions[i].second,
+                                                  positions[j].first,
+                                                  positions[j].second);
+                distances[i * found + j] = distances[j * found + i] =
+                    Waypoint::toScale(km, scale);
+            }
+        }
+    }else{
+        DistanceKernel::matrix(points, points, scale, distances);
+    }
+    for(Json::ArrayIndex i = 0; i < names.size(); i++){
+        Json::Value row(Json::arrayValue);
+        if(column[i] >= 0){
+            const double* from = &distances[0] + column[i] * found;
+            for(Json::ArrayIndex j = 0; j < names.size(); j++){
+                row.append(column[j] >= 0 ? Json::Value(from[column[j]])
+                                          : Json::Value(Json::nullValue));
+            }
+            ret.append(row);
+        }else{
+            ret.append(Json::Value(Json::nullValue));
+        }
+    }
+    return ret;
+}
+
+/**
+* Picks the shard that owns the given waypoint name.
+*
+* @param  The waypoint name.
+* @return The shard the name hashes to.
+*/
+size_t WaypointLibrary::shardOf(const string& name){
+    return std::hash<string>()(name) % SHARDS;
+}
+
+WaypointShard& WaypointLibrary::shardFor(const string& name){
+    return shards[shardOf(name)];
+}
+
+/**
+* Inserts a waypoint into its shard, replacing the one with the same
+* name if present.
+*
+* @param The waypoint to store in the library.
+*/
+bool WaypointLibrary::insert(const Waypoint& aWaypoint){
+    return this->emplace(aWaypoint.lat, aWaypoint.lon, aWaypoint.ele,
+                         aWaypoint.name, aWaypoint.address);
+}
+
+/**
+* Inserts a waypoint given by its fields into its shard.
+*
+* @param  The fields of the waypoint to store in the library.
+* @return False if the log could not be written, true otherwise.
+*/
+bool WaypointLibrary::emplace(double lat, double lon, double ele,
+                              const string& name, const string& address){
+    WaypointShard& shard = this->shardFor(name);
+    uint64_t ticket = 0;
+    {
+        unique_lock<shared_timed_mutex> lock(shard.mutex);
+        shard.emplace(lat, lon, ele, name, address);
+        changes.fetch_add(1, memory_order_release);
+        if(log){
+            ticket = log->appendPut(lat, lon, ele, name, address);
+        }
+    }
+    // wait for the disk only after letting go of the shard.
+    return ticket == 0 || log->waitDurable(ticket);
+}
+
+/**
+* Reads the waypoints of the json file, replacing the library content.
+* The file is parsed before any shard is locked, and the shards are then
+* swapped over while all of them are held, so no reader ever sees a half
+* loaded library.
+*
+* Parsing and filling the shards are both split between threads: the
+* loader hands back its waypoints already grouped by shard, one group per
+* chunk of the file, and each thread then builds its own set of shards
+* by walking the chunks in file order, so a name repeated in the file
+* keeps its last value just like a sequential load would.
+*
+* @return True if the file was parsed, false if not.
+*/
+bool WaypointLibrary::loadJsonFile(){
+    Metrics::Call call(Metrics::PERSISTENCE, "load_json");
+    unsigned threads = std::max(1u, thread::hardware_concurrency());
+    vector<WaypointJsonLoader::Buckets> chunks;
+    {
+        WaypointJsonLoader loader(fileName);
+        if(!loader.parse(threads, SHARDS, &WaypointLibrary::shardOf, chunks)){
+            LOG_ERROR("Failed to parse " << fileName << ": " << loader.error());
+            return false;
+        }
+    }
+
+    WaypointShard loaded[SHARDS];
+    auto fill = [&](unsigned first, unsigned step){
+        for(unsigned s = first; s < (unsigned)SHARDS; s += step){
+            // sized once, so the columns, the index and the strings of
+            // the shard are each allocated in one go.
+            size_t count = 0;
+            size_t bytes = 0;
+            for(size_t c = 0; c < chunks.size(); c++){
+                vector<Waypoint>& bucket = chunks[c][s];
+                count += bucket.size();
+                for(size_t i = 0; i < bucket.size(); i++){
+                    bytes += bucket[i].name.size() + bucket[i].address.size();
+                }
+            }
+            loaded[s].reserve(count, bytes);
+            for(size_t c = 0; c < chunks.size(); c++){
+                vector<Waypoint>& bucket = chunks[c][s];
+                for(size_t i = 0; i < bucket.size(); i++){
+                    loaded[s].insert(bucket[i]);
+                }
+                vector<Waypoint>().swap(bucket);
+            }
+        }
+    };
+    unsigned fillers = std::min(threads, (unsigned)SHARDS);
+    vector<thread> workers;
+    for(unsigned t = 1; t < fillers; t++){
+        workers.push_back(thread(fill, t, fillers));
+    }
+    fill(0, fillers);
+    for(size_t t = 0; t < workers.size(); t++){
+        workers[t].join();
+    }
 
-    delete wpnt2;
-    delete wpnt1;
+    if(Logger::instance().enabled(Logger::DEBUG)){
+        for(int s = 0; s < SHARDS; s++){
+            for(size_t slot = 0; slot < loaded[s].size(); slot++){
+                LOG_DEBUG(loaded[s].at(slot).name);
+            }
+        }
+    }
 
-    return toReturn;
+    this->replaceAll(loaded);
+    call.succeeded();
+    return true;
 }
 
+/**
+* Reads the waypoints of the binary snapshot, replacing the library
+* content. Every section is checked and copied out by its own thread.
+* A section normally belongs to the shard with the same index, but the
+* name hash is not guaranteed to be the same in the build that wrote the
+* file, so a waypoint that hashes elsewhere is set aside and placed once
+* the threads are done.
+*
+* @return True if the snapshot was read, false if not.
+*/
+bool WaypointLibrary::loadSnapshot(){
+    Metrics::Call call(Metrics::PERSISTENCE, "load_snapshot");
+    WaypointSnapshot snapshot(snapshotName);
+    if(!snapshot.isOpen()){
+        LOG_WARN("Cannot load snapshot: " << snapshot.error());
+        return false;
+    }
+    snapshotGeneration = snapshot.generation();
+    size_t sections = snapshot.sections();
+    WaypointShard loaded[SHARDS];
+    vector<vector<Waypoint> > strays(sections);
+    vector<char> damaged(sections, false);
+    auto fill = [&](size_t first, size_t step){
+        WaypointSnapshot::Record record;
+        Waypoint aWaypoint;
+        for(size_t section = first; section < sections; section += step){
+            if(!snapshot.check(section)){
+                damaged[section] = true;
+                continue;
+            }
+            if(section < (size_t)SHARDS){
+                loaded[section].reserve(snapshot.count(section),
+                                        snapshot.stringBytes(section));
+            }
+            for(size_t i = 0; i < snapshot.count(section); i++){
+                snapshot.record(section, i, record);
+                aWaypoint.lat = record.lat;
+                aWaypoint.lon = record.lon;
+                aWaypoint.ele = record.ele;
+                aWaypoint.name.assign(record.name, record.nameLength);
+                aWaypoint.address.assign(record.address, record.addressLength);
+                size_t s = shardOf(aWaypoint.name);
+                if(s == section){
+                    loaded[s].insert(aWaypoint);
+                }else{
+                    strays[section].push_back(aWaypoint);
+                }
+            }
+        }
+    };
+    size_t threads = std::max(1u, thread::hardware_concurrency());
+    size_t fillers = std::max((size_t)1, std::min(threads, sections));
+    vector<thread> workers;
+    for(size_t t = 1; t < fillers; t++){
+        workers.push_back(thread(fill, t, fillers));
+    }
+    fill(0, fillers);
+    for(size_t t = 0; t < workers.size(); t++){
+        workers[t].join();
+    }
+    for(size_t section = 0; section < sections; section++){
+        if(damaged[section]){
+            LOG_ERROR("Snapshot " << snapshotName << " section " << section
+                      << " is damaged");
+            return false;
+        }
+        for(size_t i = 0; i < strays[section].size(); i++){
+            Waypoint& aWaypoint = strays[section][i];
+            loaded[shardOf(aWaypoint.name)].insert(aWaypoint);
+        }
+    }
+    this->replaceAll(loaded);
+    call.succeeded();
+    return true;
+}
 
+/**
+* Writes the snapshot, rotating the log along with it when one is open.
+* Holding every shard shared keeps mutations out while the log is moved
+* to the next generation and the shards are copied, so the snapshot holds
+* exactly what the older generations logged.
+*
+* @return True if the snapshot was written, false if not.
+*/
+bool WaypointLibrary::writeSnapshot(){
+    Metrics::Call call(Metrics::PERSISTENCE, "save_snapshot");
+    string bytes;
+    uint64_t generation = 0;
+    {
+        shared_lock<shared_timed_mutex> locks[SHARDS];
+        for (int s = 0; s < SHARDS; s++){
+            locks[s] = shared_lock<shared_timed_mutex>(shards[s].mutex);
+        }
+        if(log){
+            generation = log->generation() + 1;
+            if(!log->rotate(generation)){
+                return false;
+            }
+        }
+        WaypointSnapshot::encode(shards, SHARDS, generation, bytes);
+    }
+    string error;
+    if(!WaypointSnapshot::writeFile(snapshotName, bytes, error)){
+        LOG_ERROR("Failed to save " << snapshotName << ": " << error);
+        return false;
+    }
+    if(log){
+        // only now is everything in the older generations safe elsewhere.
+        log->discardBefore(generation);
+    }
+    LOG_INFO("Done exporting library to " << snapshotName);
+    call.succeeded();
+    return true;
+}
+
+/**
+* Applies one replayed log record, without logging it again. Replaying a
+* record twice leaves the same result, so a log that overlaps the
+* snapshot is harmless.
+*/
+void WaypointLibrary::apply(bool remove, const Waypoint& aWaypoint){
+    WaypointShard& shard = this->shardFor(aWaypoint.name);
+    unique_lock<shared_timed_mutex> lock(shard.mutex);
+    if(remove){
+        shard.remove(aWaypoint.name);
+    }else{
+        shard.insert(aWaypoint);
+    }
+    changes.fetch_add(1, memory_order_release);
+}
+
+/**
+* Checks the size of the log every second and checkpoints once it grows
+* past checkpointBytes.
+*/
+void WaypointLibrary::checkpointLoop(){
+    unique_lock<mutex> guard(checkpointMutex);
+    while(!stopping){
+        checkpointWake.wait_for(guard, chrono::seconds(1));
+        if(stopping || log->bytes() < checkpointBytes){
+            continue;
+        }
+        guard.unlock();
+        {
+            lock_guard<mutex> lock(fileMutex);
+            LOG_INFO("Checkpointing " << log->bytes() << " bytes of log");
+            this->writeSnapshot();
+        }
+        guard.lock();
+    }
+}
+
+/**
+* Swaps freshly loaded shards in for the current ones.
+*
+* @param The loaded shards, left holding the old content.
+*/
+void WaypointLibrary::replaceAll(WaypointShard* loaded){
+    unique_lock<shared_timed_mutex> locks[SHARDS];
+    for (int s = 0; s < SHARDS; s++){
+        locks[s] = unique_lock<shared_timed_mutex>(shards[s].mutex);
+    }
+    for (int s = 0; s < SHARDS; s++){
+        shards[s].swap(loaded[s]);
+    }
+    changes.fetch_add(1, memory_order_release);
+}
+
+/**
+* Merges the k closest waypoints of every shard.
+*/
+vector<pair<double, string> > WaypointLibrary::nearestAll(double lat, double lon,
+                                                          size_t k){
+    vector<pair<double, string> > found;
+    Geodesic::Precision at = precision;
+    for(int s = 0; s < SHARDS; s++){
+        shared_lock<shared_timed_mutex> lock(shards[s].mutex);
+        shards[s].nearest(lat, lon, k, at, found);
+    }
+    std::sort(found.begin(), found.end());
+    if(found.size() > k){
+        found.resize(k);
+    }
+    return found;
+}
+
+/**
+* Turns (distance in kilometers, name) pairs into the json array the
+* spatial queries return.
+*/
+Json::Value WaypointLibrary::toDistanceList(vector<pair<double, string> >& found,
+                                            size_t limit, int scale){
+    Json::Value ret(Json::arrayValue);
+    for(size_t i = 0; i < found.size() && i < limit; i++){
+        Json::Value entry;
+        entry["name"] = found[i].second;
+        entry["distance"] = Waypoint::toScale(found[i].first, scale);
+        ret.append(entry);
+    }
+    return ret;
+}
@@ -1,10 +1,23 @@
+#ifndef WAYPOINTLIBRARY_HPP
+#define WAYPOINTLIBRARY_HPP
+
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
 
 #include <jsoncpp/json/json.h>
 #include "Waypoint.hpp"
+#include "WaypointShard.hpp"
+#include "Geodesic.hpp"
+#include "WaypointLog.hpp"
 
 using namespace std;
 
@@ -25,6 +38,11 @@ using namespace std;
  *
  * Purpose: Class tp act as a library of waypoints compatible with JSON
  *
+ * The library is safe to share between the server's worker threads. The
+ * waypoints are split across shards by name hash; reads take a shard's
+ * lock shared and writes take it exclusive, so lookups run in parallel
+ * and a write only blocks the one shard it touches.
+ *
  * Ser321 Foundations of Distributed Applications
  * see http://pooh.poly.asu.edu/Ser321
  * @author Jean Torres jctorre8@asu.edu
@@ -36,7 +54,8 @@ class WaypointLibrary{
 
     public:
 
-    vector<Waypoint> library;
+    static const int SHARDS = 16;
+
     vector<string> names;
 
     /**
@@ -49,14 +68,61 @@ class WaypointLibrary{
     *
     * @param An old list of waypoints to initialize the library.
     */
-    WaypointLibrary(vector<Waypoint> oldLibrary);
+    WaypointLibrary(const vector<Waypoint>& oldLibrary);
 
     /**
     * Waypoint Library constructor that gets populated by a json file.
     * 
     * @param The name of the json file.
     */
-    WaypointLibrary(string jsonFileName);
+    WaypointLibrary(const string& jsonFileName);
+
+    /**
+    * Waypoint Library constructor that starts from a binary snapshot when
+    * one can be read, and from the json file otherwise.
+    *
+    * @param The name of the json file.
+    * @param The name of the snapshot file.
+    */
+    WaypointLibrary(const string& jsonFileName,
+                    const string& snapshotFileName);
+
+    /**
+    * Stops the checkpoint thread and closes the log, if any.
+    */
+    ~WaypointLibrary();
+
+    /**
+    * Recovers the mutations logged since the snapshot the library was
+    * loaded from, then logs every mutation from here on. A mutation only
+    * returns once its log record is on disk. Once the current log
+    * generation grows past the given size it is compacted into a new
+    * snapshot.
+    *
+    * @param  The path the log generation numbers are appended to.
+    * @param  How many bytes of log trigger a checkpoint, 0 for never.
+    * @return True if the log was replayed and opened, false if not.
+    */
+    bool openLog(const string& prefix, uint64_t checkpointBytes);
+
+    /**
+    * Sets the precision the spatial queries, distanceAndBearing and
+    * distanceMatrix measure distances at; Geodesic::SPHERE, the haversine
+    * they always used, until set.
+    *
+    * @param The precision.
+    */
+    void setPrecision(Geodesic::Precision aPrecision);
+
+    /**
+    * The precision distances are measured at.
+    */
+    Geodesic::Precision getPrecision() const;
+
+    /**
+    * Distance in kilometers between two positions at the precision set.
+    */
+    double distanceKm(double lat1, double lon1, double lat2, double lon2) const;
 
     /**
     * Outputs the content of the library into a string representation of json.
@@ -73,14 +139,45 @@ class WaypointLibrary{
     */
     bool add(const Json::Value& aWaypointJson);
 
+    /**
+    * Adds many waypoints at once. Each shard is locked once for all of
+    * its waypoints and the log is waited on once for all of them, so a
+    * batch costs about as much as its slowest shard rather than one add
+    * per waypoint. A name given twice keeps its last value.
+    *
+    * @param  The waypoints to add.
+    * @return False if the log could not be written, true otherwise.
+    */
+    bool addMany(const vector<Waypoint>& waypoints);
+
+    /**
+    * Adds an array of waypoint objects, skipping the ones that are not
+    * waypoints: anything but an object, one without a name, or one whose
+    * fields have the wrong type.
+    *
+    * @param  The json array of waypoints.
+    * @return {"added": n, "failed": n, "errors": [{"record": i,
+    *         "error": text}]} with an entry per skipped waypoint, at
+    *         most MAX_ERRORS of them, i counting from 0.
+    */
+    Json::Value addMany(const Json::Value& waypoints);
+
+    /**
+    * How many failed records a bulk add lists; the rest are only counted.
+    */
+    static const size_t MAX_ERRORS = 100;
+
     /**
     * Adds a new waypoint to the library.
     * 
     * @param A Waypoint object to be added to the library
     * @return True if successful and false if don't.
     */
-    bool addNew(string lat, string lon, string ele, string name, string address);
-    bool updateWaypoint(string lat, string lon, string ele, string name, string address);
+    bool addNew(const string& lat, const string& lon, const string& ele,
+                const string& name, const string& address);
+    bool updateWaypoint(const string& lat, const string& lon,
+                        const string& ele, const string& name,
+                        const string& address);
     string serviceInfo();
 
     /**
@@ -89,14 +186,60 @@ class WaypointLibrary{
     * @param  The name of the waypoint that needs to be removed.
     * @return True if the waypoint was removed successfully, false if don't.
     */
-    bool remove(string name);
+    bool remove(const string& name);
     /**
     * Get the waypoint that matches the given name.
     * 
     * @param  The the name of the waypoint that needs to be returned.
     * @return The waypoint that has the name.
     */
-    Json::Value get(string name);
+    Json::Value get(const string& name);
+
+    /**
+    * Appends the waypoint that matches the given name as the json get
+    * returns, served from a cache once it has been written.
+    *
+    * @param  The name of the waypoint.
+    * @param  Where the json object is appended when found.
+    * @return True if the waypoint was found, false if not, in which case
+    *         nothing is appended.
+    */
+    bool appendJson(const string& name, string& out);
+
+    /**
+    * Appends the json array getNames returns. While nothing changes the
+    * whole array is kept and just copied out; after a change only the
+    * names of the shards that gained or lost one are written again.
+    *
+    * @param  Where the array is appended.
+    * @return How many names the array holds.
+    */
+    size_t appendNamesJson(string& out);
+
+    /**
+    * Counts the changes made to the waypoints; it moves on with every add,
+    * update, removal and reload, so two equal values mean nothing changed
+    * in between. Not to be confused with the log generation.
+    *
+    * @return The revision of the library content.
+    */
+    uint64_t revision() const;
+
+    /**
+    * @return How many waypoints the library holds; a change made while
+    *         the shards are counted may or may not be in it.
+    */
+    size_t size();
+
+    /**
+    * Looks up only the position of a waypoint.
+    *
+    * @param  The name of the waypoint.
+    * @param  Set to the latitude when found.
+    * @param  Set to the longitude when found.
+    * @return True if the waypoint was found, false if not.
+    */
+    bool position(const string& name, double& aLat, double& aLon);
 
     /**
     * Imports the waypoints from JSON file.
@@ -114,7 +257,35 @@ class WaypointLibrary{
     */
     bool saveToJsonFile();
 
-    string distanceAndBearing(string waypoint1, string waypoint2);
+    /**
+    * Replaces the library content with the binary snapshot.
+    *
+    * @return True if the snapshot was read, false if it is missing or
+    *         damaged, in which case the library is left as it was.
+    */
+    bool resetFromSnapshot();
+
+    /**
+    * Writes every waypoint to the binary snapshot. The shards are all
+    * held shared while they are copied out, so the snapshot is one point
+    * in time; the file is written after they are released. With a log
+    * open this is a checkpoint: the log moves on to a new generation at
+    * that same point and the older generations are deleted.
+    *
+    * @return True if the snapshot was written, false if not.
+    */
+    bool saveToSnapshot();
+
+    /**
+    * Distance in statute miles and initial bearing from one waypoint to
+    * another, a missing one counting as 0,0.
+    *
+    * @param  The name of the waypoint to start from.
+    * @param  The name of the waypoint to go to.
+    * @return The text "<miles> miles at <degrees> degrees ".
+    */
+    string distanceAndBearing(const string& waypoint1,
+                              const string& waypoint2);
 
     /**
     * This method collects all the the waypoint names in the library and returns them.
@@ -123,5 +294,317 @@ class WaypointLibrary{
     */
     Json::Value getNames();
 
+    /**
+    * How many waypoints a page holds when no limit is given, and at most.
+    */
+    static const int DEFAULT_PAGE = 1000;
+    static const int MAX_PAGE = 10000;
+
+    /**
+    * Returns the names a page at a time. The pages are in a fixed order,
+    * by shard then by name ignoring case, and a cursor is the place in
+    * that order after the last name of a page, so it stays valid however
+    * the library changes: walking every page lists each waypoint there
+    * all along exactly once, and each one added or removed meanwhile at
+    * most once.
+    *
+    * @param  The cursor returned with the previous page, empty for the
+    *         first page.
+    * @param  How many names at most, DEFAULT_PAGE if below 1 and no more
+    *         than MAX_PAGE.
+    * @return {"names": [...], "next": cursor}, next being null after the
+    *         last page; a full page may be followed by an empty one.
+    */
+    Json::Value getNamesPage(const string& cursor, int limit);
+
+    /**
+    * Returns the waypoints a page at a time, in the order of getNamesPage.
+    *
+    * @param  The cursor returned with the previous page, empty for the
+    *         first page.
+    * @param  How many waypoints at most, as for getNamesPage.
+    * @param  A json array of the fields to return, of lat, lon, ele, name
+    *         and address; every field when empty.
+    * @return {"waypoints": [...], "next": cursor}, as for getNamesPage.
+    */
+    Json::Value listWaypoints(const string& cursor, int limit,
+                              const Json::Value& fields);
+
+    /**
+    * Appends a page of waypoints as json objects, one per line, written
+    * as the get method writes them, for an export to send while it walks
+    * the library.
+    *
+    * @param  The cursor of the page, empty for the first.
+    * @param  How many waypoints at most, taken as 1 if 0.
+    * @param  Where the lines are appended.
+    * @return The cursor of the next page, empty after the last one.
+    */
+    string appendJsonPage(const string& cursor, size_t limit, string& out);
+
+    /**
+    * How many names a search returns when no limit is given, and at most.
+    */
+    static const int DEFAULT_SEARCH = 10;
+    static const int MAX_SEARCH = 1000;
+    /**
+    * How similar a name has to be to a query to be found by it, as the
+    * trigrams they share over the trigrams either has.
+    */
+    static constexpr double MIN_SIMILARITY = 0.3;
+    /**
+    * Longest query searched for; the rest is ignored.
+    */
+    static const size_t MAX_QUERY = 256;
+
+    /**
+    * Finds names for a name being typed: first the names that start with
+    * it, ignoring case, in name order, then if there are not enough of
+    * those, the names that look most like it, so a misspelled name still
+    * finds the right one.
+    *
+    * @param  The query, usually the start of a name.
+    * @param  How many names at most, DEFAULT_SEARCH if below 1 and no
+    *         more than MAX_SEARCH.
+    * @return A json array of names, best first.
+    */
+    Json::Value searchNames(const string& query, int limit);
+
+    /**
+    * Finds the waypoints whose address holds every word of a query,
+    * ignoring ASCII case and punctuation, using the address index of each
+    * shard rather than reading every address.
+    *
+    * @param  The words to look for, such as "mill ave tempe".
+    * @param  How many names at most, DEFAULT_SEARCH if below 1 and no
+    *         more than MAX_SEARCH.
+    * @return A json array of names, in name order ignoring case.
+    */
+    Json::Value searchAddress(const string& terms, int limit);
+
+    /**
+    * Finds the waypoints within a radius of a position whose address
+    * holds every word of a query.
+    *
+    * @param  The words to look for.
+    * @param  Latitude in degrees.
+    * @param  Longitude in degrees.
+    * @param  The radius, in the units selected by scale.
+    * @param  Waypoint::STATUTE, Waypoint::NAUTICAL or Waypoint::KMETER.
+    * @param  How many waypoints at most, as for searchAddress.
+    * @return An array of {name, distance} objects, closest first, with
+    *         distances in the units selected by scale.
+    */
+    Json::Value searchAddressWithin(const string& terms, double lat,
+                                    double lon, double radius, int scale,
+                                    int limit);
+
+    /**
+    * Finds the waypoints closest to the named one, not counting itself.
+    *
+    * @param  The name of the waypoint to search around.
+    * @param  How many waypoints to return at most.
+    * @return An array of {name, distance} objects, closest first, with
+    *         distances in statute miles.
+    */
+    Json::Value nearest(const string& name, int k);
+
+    /**
+    * Finds the waypoints closest to a position.
+    *
+    * @param  Latitude in degrees.
+    * @param  Longitude in degrees.
+    * @param  How many waypoints to return at most.
+    * @return An array of {name, distance} objects, closest first, with
+    *         distances in statute miles.
+    */
+    Json::Value nearestTo(double lat, double lon, int k);
+
+    /**
+    * Finds the waypoints within a radius of a position.
+    *
+    * @param  Latitude in degrees.
+    * @param  Longitude in degrees.
+    * @param  The radius, in the units selected by scale.
+    * @param  Waypoint::STATUTE, Waypoint::NAUTICAL or Waypoint::KMETER.
+    * @return An array of {name, distance} objects, closest first, with
+    *         distances in the units selected by scale.
+    */
+    Json::Value withinRadius(double lat, double lon, double radius, int scale);
+
+    /**
+    * Computes the great circle distance between every pair of the named
+    * waypoints in a single pass.
+    *
+    * @param  A json array of waypoint names.
+    * @param  Waypoint::STATUTE, Waypoint::NAUTICAL or Waypoint::KMETER.
+    * @return A json array with one row per name, each holding the distance
+    *         to every name in the same order. Rows and columns of names
+    *         not in the library, or not strings, are null.
+    */
+    Json::Value distanceMatrix(const Json::Value& names, int scale);
+
+    private:
+
+    WaypointShard shards[SHARDS];
+
+    /**
+    * Serializes saves and resets so two of them never interleave on the
+    * json file.
+    */
+    mutex fileMutex;
+
+    /**
+    * The json file loaded from and saved to.
+    */
+    string fileName;
+
+    /**
+    * The binary snapshot loaded from and saved to.
+    */
+    string snapshotName;
+
+    /**
+    * The log generation the loaded snapshot was taken at.
+    */
+    uint64_t snapshotGeneration;
+
+    /**
+    * The write-ahead log, null unless openLog was called.
+    */
+    unique_ptr<WaypointLog> log;
+
+    /**
+    * Compacts the log into a snapshot once it grows past checkpointBytes.
+    */
+    thread checkpointer;
+    mutex checkpointMutex;
+    condition_variable checkpointWake;
+    bool stopping;
+    uint64_t checkpointBytes;
+
+    /**
+    * See setPrecision.
+    */
+    atomic<Geodesic::Precision> precision;
+
+    /**
+    * Bumped under the shard lock by every change, see revision().
+    */
+    atomic<uint64_t> changes;
+
+    /**
+    * The last array appendNamesJson wrote, with its length, and the
+    * revision it was written at.
+    */
+    struct NamesJson {
+        string text;
+        size_t count;
+    };
+    shared_ptr<const NamesJson> namesJson;
+    uint64_t namesJsonRevision;
+    mutex namesJsonMutex;
+
+    /**
+    * Picks the shard index a waypoint name hashes to.
+    *
+    * @param  The waypoint name.
+    * @return The index of the shard that owns the name.
+    */
+    static size_t shardOf(const string& name);
+
+    /**
+    * Picks the shard that owns the given waypoint name.
+    *
+    * @param  The waypoint name.
+    * @return The shard the name hashes to.
+    */
+    WaypointShard& shardFor(const string& name);
+
+    /**
+    * Visits the waypoints of a page under the lock of their shard.
+    *
+    * @param  The cursor of the page, empty for the first.
+    * @param  How many waypoints at most.
+    * @param  Called with the shard and slot of each waypoint, in order.
+    * @param  Set to false if the cursor could not be read.
+    * @return The cursor of the next page, empty after the last one.
+    */
+    string walkPage(const string& cursor, size_t limit,
+                    const function<void(const WaypointShard&, size_t)>& visit,
+                    bool& valid);
+
+    /**
+    * Inserts a waypoint into its shard, replacing the one with the same
+    * name if present.
+    *
+    * @param  The waypoint to store in the library.
+    * @return False if the log could not be written, true otherwise.
+    */
+    bool insert(const Waypoint& aWaypoint);
+
+    /**
+    * Inserts a waypoint given by its fields, so no Waypoint has to be
+    * built to store one.
+    *
+    * @param  The fields of the waypoint to store in the library.
+    * @return False if the log could not be written, true otherwise.
+    */
+    bool emplace(double lat, double lon, double ele, const string& name,
+                 const string& address);
+
+    /**
+    * Reads the waypoints of the json file, replacing the library content.
+    *
+    * @return True if the file was parsed, false if not.
+    */
+    bool loadJsonFile();
+
+    /**
+    * Reads the waypoints of the binary snapshot, replacing the library
+    * content.
+    *
+    * @return True if the snapshot was read, false if not.
+    */
+    bool loadSnapshot();
+
+    /**
+    * Swaps freshly loaded shards in for the current ones while all of the
+    * current ones are held, so no reader ever sees a half loaded library.
+    *
+    * @param The loaded shards, left holding the old content.
+    */
+    void replaceAll(WaypointShard* loaded);
+
+    /**
+    * Writes the snapshot, rotating the log along with it when one is
+    * open. The caller holds fileMutex.
+    *
+    * @return True if the snapshot was written, false if not.
+    */
+    bool writeSnapshot();
+
+    /**
+    * Applies one replayed log record, without logging it again.
+    */
+    void apply(bool remove, const Waypoint& aWaypoint);
+
+    /**
+    * Body of the checkpoint thread.
+    */
+    void checkpointLoop();
+
+    /**
+    * Merges the k closest waypoints of every shard.
+    */
+    vector<pair<double, string> > nearestAll(double lat, double lon, size_t k);
+
+    /**
+    * Turns (distance in kilometers, name) pairs into the json array the
+    * spatial queries return.
+    */
+    static Json::Value toDistanceList(vector<pair<double, string> >& found,
+                                      size_t limit, int scale);
+};
 
-};
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,373 @@
+#include "WaypointLog.hpp"
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "WaypointSnapshot.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Write-ahead log of the library mutations.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+static const char PUT = 1;
+static const char REMOVE = 2;
+static const size_t RECORD_HEADER = 8;
+
+static void putBytes(string& out, const void* value, size_t length){
+    out.append((const char*)value, length);
+}
+
+static void putString(string& out, const string& value){
+    uint32_t length = value.size();
+    putBytes(out, &length, sizeof(length));
+    out += value;
+}
+
+/**
+* Starts a record in a buffer of the calling thread, which keeps its
+* capacity, leaving room for the length and crc32 that seal fills in.
+*
+* @param  The record type, the first byte of the payload.
+* @return The buffer, to append the rest of the payload to.
+*/
+static string& startRecord(char type){
+    thread_local string record;
+    record.assign(2 * sizeof(uint32_t), '\0');
+    record += type;
+    return record;
+}
+
+/**
+* Fills in the length and crc32 of a record started by startRecord.
+*/
+static const string& seal(string& record){
+    const char* payload = record.data() + 2 * sizeof(uint32_t);
+    uint32_t length = record.size() - 2 * sizeof(uint32_t);
+    uint32_t crc = WaypointSnapshot::crc32(payload, length);
+    memcpy(&record[0], &length, sizeof(length));
+    memcpy(&record[sizeof(length)], &crc, sizeof(crc));
+    return record;
+}
+
+static bool getBytes(const char*& p, const char* end, void* value,
+                     size_t length){
+    if((size_t)(end - p) < length){
+        return false;
+    }
+    memcpy(value, p, length);
+    p += length;
+    return true;
+}
+
+static bool getString(const char*& p, const char* end, string& value){
+    uint32_t length = 0;
+    if(!getBytes(p, end, &length, sizeof(length)) ||
+       (size_t)(end - p) < length){
+        return false;
+    }
+    value.assign(p, length);
+    p += length;
+    return true;
+}
+
+/**
+* Decodes one payload.
+*
+* @return True if the payload is a well formed record, false if not.
+*/
+static bool decode(const char* p, const char* end, bool& remove,
+                   Waypoint& aWaypoint){
+    char type = 0;
+    if(!getBytes(p, end, &type, 1)){
+        return false;
+    }
+    remove = type == REMOVE;
+    if(remove){
+        aWaypoint.lat = aWaypoint.lon = aWaypoint.ele = 0;
+        aWaypoint.address.clear();
+        return getString(p, end, aWaypoint.name) && p == end;
+    }
+    return type == PUT &&
+           getBytes(p, end, &aWaypoint.lat, sizeof(double)) &&
+           getBytes(p, end, &aWaypoint.lon, sizeof(double)) &&
+           getBytes(p, end, &aWaypoint.ele, sizeof(double)) &&
+           getString(p, end, aWaypoint.name) &&
+           getString(p, end, aWaypoint.address) && p == end;
+}
+
+static bool writeAll(int fd, const string& bytes){
+    size_t written = 0;
+    while(written < bytes.size()){
+        ssize_t n = write(fd, bytes.data() + written, bytes.size() - written);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+WaypointLog::WaypointLog(const string& prefix)
+    : prefix(prefix), appended(0), durable(0), fileBytes(0), current(0),
+      fd(-1), running(false), failed(false), failedGeneration(0){
+}
+
+WaypointLog::~WaypointLog(){
+    this->close();
+}
+
+string WaypointLog::fileFor(uint64_t generation) const{
+    return prefix + "." + to_string(generation);
+}
+
+bool WaypointLog::open(uint64_t generation){
+    string fileName = this->fileFor(generation);
+    int opened = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(opened < 0){
+        LOG_ERROR("Cannot open log " << fileName << ": " << strerror(errno));
+        return false;
+    }
+    struct stat info;
+    lock_guard<mutex> guard(lock);
+    fd = opened;
+    current = generation;
+    fileBytes = fstat(fd, &info) == 0 ? info.st_size : 0;
+    if(!running){
+        running = true;
+        writer = thread(&WaypointLog::run, this);
+    }
+    return true;
+}
+
+void WaypointLog::close(){
+    {
+        lock_guard<mutex> guard(lock);
+        if(!running){
+            return;
+        }
+        running = false;
+    }
+    wake.notify_one();
+    writer.join();
+    ::close(fd);
+    fd = -1;
+}
+
+/**
+* The writer thread: takes everything queued, writes it with one call and
+* syncs once, then wakes up every mutation that was waiting on it.
+*/
+void WaypointLog::run(){
+    unique_lock<mutex> guard(lock);
+    while(true){
+        wake.wait(guard, [this](){ return !pending.empty() || !running; });
+        if(pending.empty()){
+            break;
+        }
+        string batch;
+        batch.swap(pending);
+        uint64_t upTo = appended;
+        int out = fd;
+        uint64_t writing = current;
+        guard.unlock();
+        bool ok;
+        {
+            Metrics::Call call(Metrics::PERSISTENCE, "log_sync");
+            ok = writeAll(out, batch) && fdatasync(out) == 0;
+            if(ok){
+                call.succeeded();
+            }
+        }
+        if(!ok){
+            LOG_ERROR("Cannot write the log: " << strerror(errno));
+        }
+        guard.lock();
+        if(!ok){
+            failed = true;
+            failedGeneration = std::max(failedGeneration, writing);
+        }
+        durable = upTo;
+        flushed.notify_all();
+    }
+}
+
+uint64_t WaypointLog::append(const string& record){
+    uint64_t ticket;
+    {
+        lock_guard<mutex> guard(lock);
+        pending += record;
+        appended += record.size();
+        fileBytes += record.size();
+        ticket = appended;
+    }
+    wake.notify_one();
+    return ticket;
+}
+
+uint64_t WaypointLog::appendPut(double lat, double lon, double ele,
+                                const string& name, const string& address){
+    string& record = startRecord(PUT);
+    putBytes(record, &lat, sizeof(double));
+    putBytes(record, &lon, sizeof(double));
+    putBytes(record, &ele, sizeof(double));
+    putString(record, name);
+    putString(record, address);
+    return this->append(seal(record));
+}
+
+uint64_t WaypointLog::appendRemove(const string& name){
+    string& record = startRecord(REMOVE);
+    putString(record, name);
+    return this->append(seal(record));
+}
+
+bool WaypointLog::waitDurable(uint64_t ticket){
+    unique_lock<mutex> guard(lock);
+    flushed.wait(guard, [&](){ return durable >= ticket || !running; });
+    return durable >= ticket && !failed;
+}
+
+bool WaypointLog::rotate(uint64_t generation){
+    string fileName = this->fileFor(generation);
+    unique_lock<mutex> guard(lock);
+    wake.notify_one();
+    // once everything appended is durable the writer is idle and no longer
+    // touches the old descriptor.
+    flushed.wait(guard, [this](){ return durable == appended || !running; });
+    int opened = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(opened < 0){
+        LOG_ERROR("Cannot open log " << fileName << ": " << strerror(errno));
+        return false;
+    }
+    ::close(fd);
+    fd = opened;
+    current = generation;
+    fileBytes = 0;
+    return true;
+}
+
+void WaypointLog::discardBefore(uint64_t generation){
+    {
+        lock_guard<mutex> guard(lock);
+        if(failed && failedGeneration < generation){
+            LOG_INFO("Log recovered at generation " << generation);
+            failed = false;
+        }
+    }
+    vector<uint64_t> found = generations(prefix);
+    for(size_t i = 0; i < found.size() && found[i] < generation; i++){
+        unlink(this->fileFor(found[i]).c_str());
+    }
+}
+
+uint64_t WaypointLog::generation(){
+    lock_guard<mutex> guard(lock);
+    return current;
+}
+
+uint64_t WaypointLog::bytes(){
+    lock_guard<mutex> guard(lock);
+    return fileBytes;
+}
+
+vector<uint64_t> WaypointLog::generations(const string& prefix){
+    string directory = ".";
+    string base = prefix;
+    size_t slash = prefix.rfind('/');
+    if(slash != string::npos){
+        directory = slash == 0 ? "/" : prefix.substr(0, slash);
+        base = prefix.substr(slash + 1);
+    }
+    vector<uint64_t> found;
+    DIR* dir = opendir(directory.c_str());
+    if(dir == NULL){
+        return found;
+    }
+    while(struct dirent* entry = readdir(dir)){
+        string name(entry->d_name);
+        if(name.size() <= base.size() + 1 ||
+           name.compare(0, base.size(), base) != 0 ||
+           name[base.size()] != '.'){
+            continue;
+        }
+        string digits = name.substr(base.size() + 1);
+        if(digits.find_first_not_of("0123456789") == string::npos){
+            found.push_back(strtoull(digits.c_str(), NULL, 10));
+        }
+    }
+    closedir(dir);
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+size_t WaypointLog::replay(const string& prefix, uint64_t from,
+                           const Visitor& visit){
+    vector<uint64_t> found = generations(prefix);
+    size_t count = 0;
+    Waypoint aWaypoint;
+    for(size_t g = 0; g < found.size(); g++){
+        if(found[g] < from){
+            continue;
+        }
+        string fileName = prefix + "." + to_string(found[g]);
+        ifstream in(fileName.c_str(), ios::binary);
+        string data((istreambuf_iterator<char>(in)),
+                    istreambuf_iterator<char>());
+        const char* p = data.data();
+        const char* end = p + data.size();
+        while(p < end){
+            uint32_t length = 0;
+            uint32_t crc = 0;
+            bool remove = false;
+            const char* payload = p + RECORD_HEADER;
+            if((size_t)(end - p) < RECORD_HEADER){
+                payload = NULL;
+            }else{
+                memcpy(&length, p, sizeof(length));
+                memcpy(&crc, p + 4, sizeof(crc));
+            }
+            if(payload == NULL || (size_t)(end - payload) < length ||
+               WaypointSnapshot::crc32(payload, length) != crc ||
+               !decode(payload, payload + length, remove, aWaypoint)){
+                LOG_WARN("Log " << fileName << " ends with a torn record at byte "
+                         << (p - data.data()) << ", replay stops there");
+                return count;
+            }
+            visit(remove, aWaypoint);
+            count++;
+            p = payload + length;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,182 @@
+#ifndef WAYPOINTLOG_HPP
+#define WAYPOINTLOG_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+#include "Waypoint.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Write-ahead log of the library mutations. Every put or remove
+ * is appended to a buffer and a background thread writes out whatever
+ * has accumulated with a single write and fdatasync, so concurrent
+ * mutations share one disk flush (group commit). A mutation is appended
+ * while its shard is still held, which keeps the log in the same order
+ * the mutations were applied, and waits for the flush after letting go.
+ *
+ * The log is split into generations, stored as <prefix>.<generation>.
+ * A snapshot records the generation it was taken at; recovery loads the
+ * snapshot and replays every log generation from there on, and the older
+ * generations are deleted once the snapshot is safely written.
+ *
+ * Replay stops at the first damaged record, so once a write or sync fails
+ * nothing logged after it would be recovered: every mutation from then on
+ * is reported as not durable, though it is still applied in memory. The
+ * log recovers when a snapshot taken at a later generation than the
+ * failure is written, since recovery then starts past the damage.
+ *
+ * A record is a 4 byte length and a crc32 of the payload followed by the
+ * payload: a type byte, then for a put lat, lon and ele as doubles and
+ * the length prefixed name and address, or for a remove just the name.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WaypointLog {
+
+    public:
+
+    /**
+    * Called for each record found by replay: the waypoint put, or a
+    * waypoint holding only the name for a remove.
+    */
+    typedef function<void(bool remove, const Waypoint& aWaypoint)> Visitor;
+
+    /**
+    * @param The path the generation number is appended to.
+    */
+    WaypointLog(const string& prefix);
+    ~WaypointLog();
+
+    /**
+    * Opens a generation for appending and starts the writer thread.
+    *
+    * @param  The generation to append to.
+    * @return True if the file could be opened, false if not.
+    */
+    bool open(uint64_t generation);
+
+    /**
+    * Writes out whatever is queued and stops the writer thread.
+    */
+    void close();
+
+    /**
+    * Queues a put. Call while holding the waypoint's shard exclusively.
+    *
+    * @param  The fields of the waypoint stored.
+    * @return The ticket to pass to waitDurable.
+    */
+    uint64_t appendPut(double lat, double lon, double ele, const string& name,
+                       const string& address);
+
+    /**
+    * Queues a remove. Call while holding the waypoint's shard exclusively.
+    *
+    * @param  The name of the waypoint removed.
+    * @return The ticket to pass to waitDurable.
+    */
+    uint64_t appendRemove(const string& name);
+
+    /**
+    * Blocks until the record with the ticket is on disk.
+    *
+    * @param  A ticket from appendPut or appendRemove.
+    * @return True if it was written and synced, false if the disk failed.
+    */
+    bool waitDurable(uint64_t ticket);
+
+    /**
+    * Flushes the current generation and starts appending to a new one.
+    * The caller makes sure nothing is appended meanwhile.
+    *
+    * @param  The new generation.
+    * @return True if the new generation was opened, false if not.
+    */
+    bool rotate(uint64_t generation);
+
+    /**
+    * Deletes the files of every generation older than the given one, once
+    * a snapshot taken at it is written, and clears a failed write in them.
+    *
+    * @param The oldest generation to keep.
+    */
+    void discardBefore(uint64_t generation);
+
+    uint64_t generation();
+
+    /**
+    * @return How many bytes were appended to the current generation.
+    */
+    uint64_t bytes();
+
+    /**
+    * Lists the generations that have a file on disk, oldest first.
+    *
+    * @param The path the generation numbers are appended to.
+    */
+    static vector<uint64_t> generations(const string& prefix);
+
+    /**
+    * Reads back every record of the given generation and the later ones,
+    * in order. Replay stops at the first torn or damaged record, which is
+    * where the last run stopped writing.
+    *
+    * @param  The path the generation numbers are appended to.
+    * @param  The first generation to replay.
+    * @param  Called for every record.
+    * @return How many records were replayed.
+    */
+    static size_t replay(const string& prefix, uint64_t from,
+                         const Visitor& visit);
+
+    private:
+
+    string prefix;
+    mutex lock;
+    condition_variable wake;
+    condition_variable flushed;
+    string pending;
+    uint64_t appended;
+    uint64_t durable;
+    uint64_t fileBytes;
+    uint64_t current;
+    int fd;
+    bool running;
+    // set by a failed write or sync, in the generation failedGeneration.
+    bool failed;
+    uint64_t failedGeneration;
+    thread writer;
+
+    WaypointLog(const WaypointLog&) = delete;
+    WaypointLog& operator=(const WaypointLog&) = delete;
+
+    string fileFor(uint64_t generation) const;
+    uint64_t append(const string& record);
+    void run();
+};
+
+#endif
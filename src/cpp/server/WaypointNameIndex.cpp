@@ -0,0 +1,437 @@
+#include "WaypointNameIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Name index of a shard, for prefix and similar name searches.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+const size_t WaypointNameIndex::MERGE_AT;
+const size_t WaypointNameIndex::CHECK_COST;
+
+static inline unsigned char fold(char c){
+    unsigned char u = (unsigned char)c;
+    return u >= 'A' && u <= 'Z' ? u + ('a' - 'A') : u;
+}
+
+int WaypointNameIndex::compare(const StringArena::Text& a,
+                               const StringArena::Text& b){
+    size_t n = std::min(a.size, b.size);
+    for(size_t i = 0; i < n; i++){
+        unsigned char x = fold(a.data[i]);
+        unsigned char y = fold(b.data[i]);
+        if(x != y){
+            return x < y ? -1 : 1;
+        }
+    }
+    if(a.size != b.size){
+        return a.size < b.size ? -1 : 1;
+    }
+    return memcmp(a.data, b.data, n);
+}
+
+/**
+* Orders the slots by their names.
+*/
+struct ByName {
+    const WaypointNameIndex::Names& names;
+    bool operator()(uint32_t a, uint32_t b) const {
+        return WaypointNameIndex::compare(names[a], names[b]) < 0;
+    }
+    bool operator()(uint32_t a, const StringArena::Text& b) const {
+        return WaypointNameIndex::compare(names[a], b) < 0;
+    }
+    bool operator()(const StringArena::Text& a, uint32_t b) const {
+        return WaypointNameIndex::compare(a, names[b]) < 0;
+    }
+};
+
+/**
+* Orders the slots by their folded names against a folded prefix, so the
+* names starting with it are the ones from lower_bound on that it starts.
+*/
+struct ByPrefix {
+    const WaypointNameIndex::Names& names;
+    bool operator()(uint32_t a, const string& prefix) const {
+        const StringArena::Text& name = names[a];
+        size_t n = std::min(name.size, prefix.size());
+        for(size_t i = 0; i < n; i++){
+            unsigned char x = fold(name.data[i]);
+            unsigned char y = (unsigned char)prefix[i];
+            if(x != y){
+                return x < y;
+            }
+        }
+        return name.size < prefix.size();
+    }
+    bool starts(uint32_t a, const string& prefix) const {
+        const StringArena::Text& name = names[a];
+        if(name.size < prefix.size()){
+            return false;
+        }
+        for(size_t i = 0; i < prefix.size(); i++){
+            if(fold(name.data[i]) != (unsigned char)prefix[i]){
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+WaypointNameIndex::WaypointNameIndex()
+    : sortedBuilt(false), gramsBuilt(false){
+}
+
+void WaypointNameIndex::gramsOf(const char* text, size_t size,
+                                vector<uint32_t>& out){
+    out.clear();
+    // padded as "  text ", so short names and the start of names count.
+    uint32_t gram = (uint32_t)' ' << 8 | ' ';
+    for(size_t i = 0; i <= size; i++){
+        unsigned char c = i < size ? fold(text[i]) : ' ';
+        gram = (gram << 8 | c) & 0xFFFFFF;
+        out.push_back(gram);
+    }
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+void WaypointNameIndex::buildSorted(const Names& names) const{
+    lock_guard<std::mutex> guard(buildLock);
+    if(sortedBuilt.load(memory_order_relaxed)){
+        return;
+    }
+    // sorted by the first 8 folded bytes of each name packed in a number,
+    // which settles most comparisons without looking at the names.
+    vector<pair<uint64_t, uint32_t> > keyed(names.size());
+    for(size_t slot = 0; slot < names.size(); slot++){
+        uint64_t key = 0;
+        for(size_t i = 0; i < 8; i++){
+            key = key << 8 |
+                  (i < names[slot].size ? fold(names[slot].data[i]) : 0);
+        }
+        keyed[slot] = make_pair(key, slot);
+    }
+    sort(keyed.begin(), keyed.end(),
+         [&names](const pair<uint64_t, uint32_t>& a,
+                  const pair<uint64_t, uint32_t>& b){
+             if(a.first != b.first){
+                 return a.first < b.first;
+             }
+             return compare(names[a.second], names[b.second]) < 0;
+         });
+    sorted.resize(keyed.size());
+    for(size_t i = 0; i < keyed.size(); i++){
+        sorted[i] = keyed[i].second;
+    }
+    recent.clear();
+    sortedBuilt.store(true, memory_order_release);
+}
+
+void WaypointNameIndex::buildGrams(const Names& names) const{
+    lock_guard<std::mutex> guard(buildLock);
+    if(gramsBuilt.load(memory_order_relaxed)){
+        return;
+    }
+    vector<uint32_t> found;
+    for(size_t slot = 0; slot < names.size(); slot++){
+        gramsOf(names[slot].data, names[slot].size, found);
+        for(size_t g = 0; g < found.size(); g++){
+            grams[found[g]].push_back(slot);
+        }
+    }
+    gramsBuilt.store(true, memory_order_release);
+}
+
+void WaypointNameIndex::merge(const Names& names){
+    ByName less = { names };
+    vector<uint32_t> merged;
+    merged.reserve(sorted.size() + recent.size());
+    std::merge(sorted.begin(), sorted.end(), recent.begin(), recent.end(),
+               back_inserter(merged), less);
+    sorted.swap(merged);
+    recent.clear();
+}
+
+void WaypointNameIndex::add(size_t slot, const Names& names){
+    // nothing to keep up to date until a search builds it.
+    if(sortedBuilt.load(memory_order_relaxed)){
+        ByName less = { names };
+        recent.insert(upper_bound(recent.begin(), recent.end(),
+                                  (uint32_t)slot, less), slot);
+        if(recent.size() >= MERGE_AT){
+            this->merge(names);
+        }
+    }
+    if(gramsBuilt.load(memory_order_relaxed)){
+        vector<uint32_t> found;
+        gramsOf(names[slot].data, names[slot].size, found);
+        for(size_t g = 0; g < found.size(); g++){
+            grams[found[g]].push_back(slot);
+        }
+    }
+}
+
+/**
+* Removes a slot from one of the sorted arrays.
+*
+* @return False if it is not in that one.
+*/
+bool WaypointNameIndex::forget(vector<uint32_t>& slots, size_t slot,
+                               const Names& names){
+    ByName less = { names };
+    vector<uint32_t>::iterator found =
+        lower_bound(slots.begin(), slots.end(), names[slot], less);
+    if(found == slots.end() || *found != slot){
+        return false;
+    }
+    slots.erase(found);
+    return true;
+}
+
+void WaypointNameIndex::remove(size_t slot, const Names& names){
+    if(sortedBuilt.load(memory_order_relaxed) &&
+       !this->forget(recent, slot, names)){
+        this->forget(sorted, slot, names);
+    }
+    if(gramsBuilt.load(memory_order_relaxed)){
+        vector<uint32_t> found;
+        gramsOf(names[slot].data, names[slot].size, found);
+        for(size_t g = 0; g < found.size(); g++){
+            unordered_map<uint32_t, vector<uint32_t> >::iterator list =
+                grams.find(found[g]);
+            if(list == grams.end()){
+                continue;
+            }
+            vector<uint32_t>& slots = list->second;
+            vector<uint32_t>::iterator at =
+                std::find(slots.begin(), slots.end(), (uint32_t)slot);
+            if(at != slots.end()){
+                *at = slots.back();
+                slots.pop_back();
+            }
+            if(slots.empty()){
+                grams.erase(list);
+            }
+        }
+    }
+}
+
+void WaypointNameIndex::move(size_t from, size_t to, const Names& names){
+    if(sortedBuilt.load(memory_order_relaxed)){
+        ByName less = { names };
+        vector<uint32_t>* lists[] = { &recent, &sorted };
+        for(int l = 0; l < 2; l++){
+            vector<uint32_t>::iterator found =
+                lower_bound(lists[l]->begin(), lists[l]->end(), names[from],
+                            less);
+            if(found != lists[l]->end() && *found == from){
+                *found = to;
+                break;
+            }
+        }
+    }
+    if(gramsBuilt.load(memory_order_relaxed)){
+        vector<uint32_t> found;
+        gramsOf(names[from].data, names[from].size, found);
+        for(size_t g = 0; g < found.size(); g++){
+            vector<uint32_t>& slots = grams[found[g]];
+            vector<uint32_t>::iterator at =
+                std::find(slots.begin(), slots.end(), (uint32_t)from);
+            if(at != slots.end()){
+                *at = to;
+            }
+        }
+    }
+}
+
+void WaypointNameIndex::clear(){
+    vector<uint32_t>().swap(sorted);
+    vector<uint32_t>().swap(recent);
+    sortedBuilt.store(false, memory_order_relaxed);
+    unordered_map<uint32_t, vector<uint32_t> >().swap(grams);
+    gramsBuilt.store(false, memory_order_relaxed);
+}
+
+void WaypointNameIndex::swap(WaypointNameIndex& other){
+    sorted.swap(other.sorted);
+    recent.swap(other.recent);
+    grams.swap(other.grams);
+    bool built = sortedBuilt.load(memory_order_relaxed);
+    sortedBuilt.store(other.sortedBuilt.load(memory_order_relaxed),
+                      memory_order_relaxed);
+    other.sortedBuilt.store(built, memory_order_relaxed);
+    built = gramsBuilt.load(memory_order_relaxed);
+    gramsBuilt.store(other.gramsBuilt.load(memory_order_relaxed),
+                     memory_order_relaxed);
+    other.gramsBuilt.store(built, memory_order_relaxed);
+}
+
+void WaypointNameIndex::after(const Names& names,
+                              const StringArena::Text* name, size_t limit,
+                              vector<size_t>& out) const{
+    if(!sortedBuilt.load(memory_order_acquire)){
+        this->buildSorted(names);
+    }
+    ByName less = { names };
+    vector<uint32_t>::const_iterator a = sorted.begin();
+    vector<uint32_t>::const_iterator b = recent.begin();
+    if(name != NULL){
+        a = upper_bound(sorted.begin(), sorted.end(), *name, less);
+        b = upper_bound(recent.begin(), recent.end(), *name, less);
+    }
+    for(size_t n = 0; n < limit; n++){
+        if(a != sorted.end() && (b == recent.end() || less(*a, *b))){
+            out.push_back(*a++);
+        }else if(b != recent.end()){
+            out.push_back(*b++);
+        }else{
+            break;
+        }
+    }
+}
+
+void WaypointNameIndex::withPrefix(const Names& names, const string& prefix,
+                                   size_t limit, vector<size_t>& out) const{
+    if(!sortedBuilt.load(memory_order_acquire)){
+        this->buildSorted(names);
+    }
+    string folded(prefix);
+    for(size_t i = 0; i < folded.size(); i++){
+        folded[i] = fold(folded[i]);
+    }
+    ByName less = { names };
+    ByPrefix byPrefix = { names };
+    vector<uint32_t>::const_iterator a =
+        lower_bound(sorted.begin(), sorted.end(), folded, byPrefix);
+    vector<uint32_t>::const_iterator b =
+        lower_bound(recent.begin(), recent.end(), folded, byPrefix);
+    bool moreA = a != sorted.end() && byPrefix.starts(*a, folded);
+    bool moreB = b != recent.end() && byPrefix.starts(*b, folded);
+    for(size_t n = 0; n < limit && (moreA || moreB); n++){
+        if(moreA && (!moreB || less(*a, *b))){
+            out.push_back(*a++);
+            moreA = a != sorted.end() && byPrefix.starts(*a, folded);
+        }else{
+            out.push_back(*b++);
+            moreB = b != recent.end() && byPrefix.starts(*b, folded);
+        }
+    }
+}
+
+void WaypointNameIndex::similar(const Names& names, const string& query,
+                                double minScore,
+                                vector<pair<double, size_t> >& out) const{
+    if(!gramsBuilt.load(memory_order_acquire)){
+        this->buildGrams(names);
+    }
+    vector<uint32_t> wanted;
+    gramsOf(query.data(), query.size(), wanted);
+    // a name can score no more than the share of the query it holds, so
+    // it holds at least this many of its trigrams, and so at least one of
+    // any others - least + 1 of them: the candidates only have to be taken
+    // from that many of the shortest lists, missing trigrams first.
+    size_t least = std::max(1.0, ceil(minScore * wanted.size()));
+    if(least > wanted.size()){
+        return;
+    }
+    size_t from = wanted.size() - least + 1;
+    vector<const vector<uint32_t>*> lists;
+    for(size_t g = 0; g < wanted.size(); g++){
+        unordered_map<uint32_t, vector<uint32_t> >::const_iterator list =
+            grams.find(wanted[g]);
+        if(list == grams.end()){
+            from--;
+        }else{
+            lists.push_back(&list->second);
+        }
+    }
+    if(from == 0){
+        return;
+    }
+    sort(lists.begin(), lists.end(),
+         [](const vector<uint32_t>* a, const vector<uint32_t>* b){
+             return a->size() < b->size();
+         });
+    // the trigrams of the query each name holds, reused by every search
+    // the thread makes and cleared after each. Only the shortest lists
+    // add names; the longer ones either count for the names already there
+    // or, when there are few of those, are left for the names to be
+    // checked against the query one by one.
+    thread_local vector<uint16_t> shared;
+    thread_local vector<uint32_t> touched;
+    if(shared.size() < names.size()){
+        shared.resize(names.size(), 0);
+    }
+    touched.clear();
+    for(size_t l = 0; l < from && l < lists.size(); l++){
+        const vector<uint32_t>& slots = *lists[l];
+        for(size_t i = 0; i < slots.size(); i++){
+            if(shared[slots[i]]++ == 0){
+                touched.push_back(slots[i]);
+            }
+        }
+    }
+    size_t rest = 0;
+    for(size_t l = from; l < lists.size(); l++){
+        rest += lists[l]->size();
+    }
+    bool counted = rest < touched.size() * CHECK_COST;
+    for(size_t l = from; counted && l < lists.size(); l++){
+        const vector<uint32_t>& slots = *lists[l];
+        for(size_t i = 0; i < slots.size(); i++){
+            if(shared[slots[i]] != 0){
+                shared[slots[i]]++;
+            }
+        }
+    }
+    vector<uint32_t> own;
+    for(size_t i = 0; i < touched.size(); i++){
+        size_t slot = touched[i];
+        size_t common = shared[slot];
+        shared[slot] = 0;
+        if(common + (counted ? 0 : lists.size() - from) < least){
+            continue;
+        }
+        gramsOf(names[slot].data, names[slot].size, own);
+        if(!counted){
+            // both sorted, so the trigrams shared are counted in one pass.
+            common = 0;
+            for(size_t a = 0, b = 0; a < wanted.size() && b < own.size();){
+                if(wanted[a] == own[b]){
+                    common++;
+                    a++;
+                    b++;
+                }else if(wanted[a] < own[b]){
+                    a++;
+                }else{
+                    b++;
+                }
+            }
+        }
+        double score = (double)common / (wanted.size() + own.size() - common);
+        if(score >= minScore){
+            out.push_back(make_pair(score, slot));
+        }
+    }
+}
@@ -0,0 +1,170 @@
+#ifndef WAYPOINTNAMEINDEX_HPP
+#define WAYPOINTNAMEINDEX_HPP
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "StringArena.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Name index of a shard, for looking waypoints up by part of
+ * their name. It keeps two structures, each built the first time it is
+ * asked for and kept up to date from then on:
+ *
+ * The slots in name order, ignoring ASCII case, for prefix searches and
+ * for walking the shard a page at a time. Most of them sit in one sorted
+ * array; the latest additions go to a small sorted array of their own,
+ * merged into the big one once it holds MERGE_AT of them, so an add
+ * costs a short copy and a merge now and then rather than a copy of the
+ * whole array. A search looks at both.
+ *
+ * The slots of the names holding each trigram, three bytes of the name
+ * folded to lower case and padded with two spaces before and one after,
+ * for finding names that look like a query even when it is misspelled.
+ *
+ * Slots are 32 bits, 4 bytes per name per structure, and names are read
+ * from the shard rather than copied. Every call takes the names of the
+ * shard as they are when it is made; the caller holds the shard the way
+ * WaypointGrid's callers do, exclusive to change it and shared to search.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WaypointNameIndex {
+
+    public:
+
+    typedef vector<StringArena::Text> Names;
+
+    /**
+    * How many additions the small array holds before it is merged.
+    */
+    static const size_t MERGE_AT = 512;
+
+    /**
+    * How many slots of a trigram list cost about as much to go through as
+    * checking one name against a query.
+    */
+    static const size_t CHECK_COST = 16;
+
+    WaypointNameIndex();
+
+    /**
+    * Records the name at slot, which names already holds.
+    */
+    void add(size_t slot, const Names& names);
+
+    /**
+    * Forgets the name at slot, which names still holds.
+    */
+    void remove(size_t slot, const Names& names);
+
+    /**
+    * Records that the name at one slot is moving to another, the name at
+    * the new slot having been removed; names still holds it at from.
+    */
+    void move(size_t from, size_t to, const Names& names);
+
+    /**
+    * Drops everything; the structures are built again when next needed.
+    */
+    void clear();
+
+    /**
+    * Exchanges the content of this index with another one.
+    */
+    void swap(WaypointNameIndex& other);
+
+    /**
+    * Finds the slots of the names that come after a name, in the order of
+    * compare.
+    *
+    * @param The names of the shard.
+    * @param The name to start after, NULL to start from the first.
+    * @param How many slots at most.
+    * @param Where the slots are appended, in order.
+    */
+    void after(const Names& names, const StringArena::Text* name,
+               size_t limit, vector<size_t>& out) const;
+
+    /**
+    * Finds the slots of the names that start with a prefix, ignoring
+    * ASCII case.
+    *
+    * @param The names of the shard.
+    * @param The prefix.
+    * @param How many slots at most.
+    * @param Where the slots are appended, in the order of compare.
+    */
+    void withPrefix(const Names& names, const string& prefix, size_t limit,
+                    vector<size_t>& out) const;
+
+    /**
+    * Finds the names sharing enough trigrams with a query, scored by the
+    * trigrams they share over the trigrams either of them has.
+    *
+    * @param The names of the shard.
+    * @param The query.
+    * @param The lowest score kept, between 0 and 1.
+    * @param Where (score, slot) pairs are appended, in no order.
+    */
+    void similar(const Names& names, const string& query, double minScore,
+                 vector<pair<double, size_t> >& out) const;
+
+    /**
+    * Orders names by their bytes with ASCII letters folded to lower case,
+    * then by their bytes as they are, so that no two names are equal.
+    *
+    * @return Below 0, 0 or above 0 as a comes before, with or after b.
+    */
+    static int compare(const StringArena::Text& a, const StringArena::Text& b);
+
+    private:
+
+    /**
+    * The sorted slots, most of them in sorted and the latest in recent.
+    * Guarded by the shard lock once built; built under buildLock.
+    */
+    mutable vector<uint32_t> sorted;
+    mutable vector<uint32_t> recent;
+    mutable atomic<bool> sortedBuilt;
+
+    /**
+    * The slots of each trigram, in no order.
+    */
+    mutable unordered_map<uint32_t, vector<uint32_t> > grams;
+    mutable atomic<bool> gramsBuilt;
+
+    mutable std::mutex buildLock;
+
+    void buildSorted(const Names& names) const;
+    void buildGrams(const Names& names) const;
+    void merge(const Names& names);
+    bool forget(vector<uint32_t>& slots, size_t slot, const Names& names);
+
+    static void gramsOf(const char* text, size_t size, vector<uint32_t>& out);
+};
+
+#endif
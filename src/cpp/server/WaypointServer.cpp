@@ -32,16 +32,32 @@
 #include <stdlib.h>
 #include <cstdlib>
 #include <csignal>
+#include <pthread.h>
+#include <memory>
+#include <unistd.h>
 
 #include "waypointserverstub.h"
 #include "WaypointLibrary.hpp"
+#include "Logger.hpp"
+#include "WorkerPool.hpp"
+#include "RequestDispatcher.hpp"
+#include "TypedMethods.hpp"
+#include "EpollHttpServer.hpp"
+#include "FramedSocketServer.hpp"
+#include "MetricsServer.hpp"
+#include "Metrics.hpp"
+#include "WaypointImport.hpp"
 
 using namespace jsonrpc;
 using namespace std;
 
 class WaypointServer : public waypointserverstub {
 public:
-   WaypointServer(AbstractServerConnector &connector, int port);
+   WaypointServer(AbstractServerConnector &connector, int port,
+                  const string& snapshotFile);
+   virtual ~WaypointServer();
+   virtual void HandleMethodCall(Procedure& proc, const Json::Value& input,
+                                 Json::Value& output);
    virtual std::string serviceInfo();
    virtual bool saveToJsonFile();
    virtual bool resetFromJsonFile();
@@ -52,119 +68,461 @@ public:
    virtual bool updateWaypoint(const string&  lat, const string&  lon, const string&  ele, const string&  name, const string&  address);
    virtual bool addNew(const string& lat, const string& lon, const string&  ele, const string&  name, const string&  address);
    virtual string distanceAndBearing(const string& waypoint1, const string& waypoint2);
+   virtual Json::Value nearest(const string& name, int k);
+   virtual Json::Value nearestTo(double lat, double lon, int k);
+   virtual Json::Value withinRadius(double lat, double lon, double radius, int scale);
+   virtual Json::Value distanceMatrix(const Json::Value& names, int scale);
+   virtual Json::Value getNamesPage(const string& cursor, int limit);
+   virtual Json::Value listWaypoints(const string& cursor, int limit,
+                                     const Json::Value& fields);
+   virtual Json::Value searchNames(const string& query, int limit);
+   virtual Json::Value searchAddress(const string& terms, int limit);
+   virtual Json::Value searchAddressWithin(const string& terms, double lat,
+                                           double lon, double radius,
+                                           int scale, int limit);
+   virtual Json::Value addMany(const Json::Value& waypoints);
+   virtual bool saveToSnapshot();
+   virtual bool resetFromSnapshot();
+   bool openLog(const string& prefix, uint64_t checkpointBytes);
+   WaypointLibrary& getLibrary();
 private:
    WaypointLibrary * library;
    int portNum;
 };
 
-WaypointServer::WaypointServer(AbstractServerConnector &connector, int port) :
+WaypointServer::WaypointServer(AbstractServerConnector &connector, int port,
+                               const string& snapshotFile) :
                              waypointserverstub(connector){
-   library = new WaypointLibrary("waypoints.json");
+   if(snapshotFile.empty()){
+      library = new WaypointLibrary("waypoints.json");
+   }else{
+      library = new WaypointLibrary("waypoints.json", snapshotFile);
+   }
    portNum = port;
 }
 
+WaypointServer::~WaypointServer(){
+   delete library;
+}
+
+/**
+* Every method of the stub is dispatched from here, so this is where each
+* call is counted and timed; one that throws counts as an error.
+*/
+void WaypointServer::HandleMethodCall(Procedure& proc, const Json::Value& input,
+                                      Json::Value& output){
+   Metrics::Call call(Metrics::METHOD, proc.GetProcedureName());
+   waypointserverstub::HandleMethodCall(proc, input, output);
+   call.succeeded();
+}
+
 string WaypointServer::serviceInfo(){
    std::string msg =
                 "Waypoint Library management service.";
    stringstream ss;
    ss << portNum;
-   cout << "serviceInfo called. Returning: Waypoint Library management service."
-        << endl;
+   LOG_SAMPLED(Logger::INFO,
+               "serviceInfo called. Returning: Waypoint Library management service.");
    return  msg.append(ss.str());
 }
 
 bool WaypointServer::saveToJsonFile(){
-   cout << "saving collection to waypoints.json" << endl;
+   LOG_INFO("saving collection to waypoints.json");
    bool ret = library->saveToJsonFile();
    return ret;
 }
 
 bool WaypointServer::resetFromJsonFile(){
-   cout << "restoring collection from waypoints.json" << endl;
+   LOG_INFO("restoring collection from waypoints.json");
    bool ret = library->resetFromJsonFile();
    return ret;
 }
 
 bool WaypointServer::add(const Json::Value& aWaypoint) {
-   cout << "Adding " << aWaypoint << endl;
+   LOG_SAMPLED(Logger::INFO, "Adding " << aWaypoint.get("name", "").asString());
    bool ret = library->add(aWaypoint);
    return ret;
 }
 
 bool WaypointServer::remove(const string& aWaypoint) {
-   cout << "Removing " << aWaypoint << endl;
+   LOG_SAMPLED(Logger::INFO, "Removing " << aWaypoint);
    bool ret = library->remove(aWaypoint);
    return ret;
 }
 
 Json::Value WaypointServer::get(const string& aWaypoint){
-   cout << "Getting " << aWaypoint << endl;
+   LOG_SAMPLED(Logger::INFO, "Getting " << aWaypoint);
    Json::Value toReturn = library->get(aWaypoint);
-   cout << toReturn<< endl;
    return toReturn;
 }
 
 Json::Value WaypointServer::getNames(){
-   Json::FastWriter fw;
-   std::string names = fw.write(library->getNames());
-   cout << "Get names returning: " << names  << endl;
-   return library->getNames();
+   Json::Value names = library->getNames();
+   LOG_SAMPLED(Logger::INFO, "Get names returning " << names.size() << " names");
+   return names;
 }
 
 string WaypointServer::distanceAndBearing(const string& waypoint1, const string& waypoint2){
    std::string distBear(this->library->distanceAndBearing(waypoint1,waypoint2));
-   cout << "Calculating distance and waypoint between: " << waypoint1;
-   cout << " and " << waypoint2 << endl;
+   LOG_SAMPLED(Logger::INFO, "Calculating distance and waypoint between: "
+               << waypoint1 << " and " << waypoint2);
    return distBear;
 }
 
 bool WaypointServer::addNew(const string& lat, const string& lon, const string&  ele, const string&  name, const string&  address){
-   cout << "Adding the following waypoint: " << name << endl;
+   LOG_SAMPLED(Logger::INFO, "Adding the following waypoint: " << name);
    bool ret = library->addNew(lat, lon, ele, name, address);
    return ret;
 }
 
 bool WaypointServer::updateWaypoint(const string&  lat, const string&  lon, const string&  ele, const string&  name, const string&  address){
-   cout << "updating the following waypoint: " << name << endl;
+   LOG_SAMPLED(Logger::INFO, "updating the following waypoint: " << name);
    bool ret = library->updateWaypoint(lat, lon, ele, name, address);
    return ret;
 }
 
+Json::Value WaypointServer::nearest(const string& name, int k){
+   LOG_SAMPLED(Logger::INFO,
+               "Finding the " << k << " waypoints nearest to " << name);
+   return library->nearest(name, k);
+}
+
+Json::Value WaypointServer::nearestTo(double lat, double lon, int k){
+   LOG_SAMPLED(Logger::INFO, "Finding the " << k << " waypoints nearest to "
+               << lat << "," << lon);
+   return library->nearestTo(lat, lon, k);
+}
+
+Json::Value WaypointServer::withinRadius(double lat, double lon, double radius, int scale){
+   LOG_SAMPLED(Logger::INFO, "Finding the waypoints within " << radius
+               << " of " << lat << "," << lon);
+   return library->withinRadius(lat, lon, radius, scale);
+}
+Json::Value WaypointServer::distanceMatrix(const Json::Value& names, int scale){
+   LOG_SAMPLED(Logger::INFO, "Calculating the distance matrix of "
+               << names.size() << " waypoints");
+   return library->distanceMatrix(names, scale);
+}
+
+Json::Value WaypointServer::getNamesPage(const string& cursor, int limit){
+   LOG_SAMPLED(Logger::INFO, "Getting a page of names after '" << cursor
+               << "'");
+   return library->getNamesPage(cursor, limit);
+}
+
+Json::Value WaypointServer::listWaypoints(const string& cursor, int limit,
+                                          const Json::Value& fields){
+   LOG_SAMPLED(Logger::INFO, "Listing a page of waypoints after '" << cursor
+               << "'");
+   return library->listWaypoints(cursor, limit, fields);
+}
+
+Json::Value WaypointServer::searchNames(const string& query, int limit){
+   LOG_SAMPLED(Logger::INFO, "Searching for names like '" << query << "'");
+   return library->searchNames(query, limit);
+}
+
+Json::Value WaypointServer::searchAddress(const string& terms, int limit){
+   LOG_SAMPLED(Logger::INFO, "Searching for addresses with '" << terms << "'");
+   return library->searchAddress(terms, limit);
+}
+
+Json::Value WaypointServer::searchAddressWithin(const string& terms,
+                                                double lat, double lon,
+                                                double radius, int scale,
+                                                int limit){
+   LOG_SAMPLED(Logger::INFO, "Searching for addresses with '" << terms
+               << "' within " << radius << " of " << lat << "," << lon);
+   return library->searchAddressWithin(terms, lat, lon, radius, scale, limit);
+}
+
+Json::Value WaypointServer::addMany(const Json::Value& waypoints){
+   LOG_SAMPLED(Logger::INFO, "Adding " << waypoints.size()
+               << " waypoints in bulk");
+   return library->addMany(waypoints);
+}
+
+bool WaypointServer::saveToSnapshot(){
+   LOG_INFO("saving collection to the binary snapshot");
+   return library->saveToSnapshot();
+}
+
+bool WaypointServer::resetFromSnapshot(){
+   LOG_INFO("restoring collection from the binary snapshot");
+   return library->resetFromSnapshot();
+}
+
+bool WaypointServer::openLog(const string& prefix, uint64_t checkpointBytes){
+   return library->openLog(prefix, checkpointBytes);
+}
+
+WaypointLibrary& WaypointServer::getLibrary(){
+   return *library;
+}
+
+/**
+* Reads the resident set size of the process from /proc, 0 where there is
+* none.
+*/
+static double residentBytes(){
+   double bytes = 0;
+   FILE* statm = fopen("/proc/self/statm", "r");
+   if(statm != NULL){
+      unsigned long long size = 0, resident = 0;
+      if(fscanf(statm, "%llu %llu", &size, &resident) == 2){
+         bytes = (double)resident * sysconf(_SC_PAGESIZE);
+      }
+      fclose(statm);
+   }
+   return bytes;
+}
+
+#ifdef __linux__
+/**
+* Streams the body of a POST to /import into the library, counted and
+* timed as the importStream method from the first byte to the reply.
+*/
+class ImportBody : public EpollHttpServer::BodyHandler {
+public:
+   ImportBody(WaypointLibrary& library)
+      : call(Metrics::METHOD, "importStream"), import(library) {}
+   virtual void data(const char* bytes, size_t size){
+      import.feed(bytes, size);
+   }
+   virtual string end(){
+      import.finish();
+      if(!import.stopped()){
+         call.succeeded();
+      }
+      string report;
+      import.appendReport(report);
+      return report;
+   }
+private:
+   Metrics::Call call;
+   WaypointImport import;
+};
+
+/**
+* Streams every waypoint to a GET of /export, one json object per line as
+* /import takes them, a page at a time as the client reads them. Counted
+* and timed as the exportStream method.
+*/
+class ExportBody : public EpollHttpServer::BodySource {
+public:
+   ExportBody(WaypointLibrary& library)
+      : call(Metrics::METHOD, "exportStream"), library(library) {}
+   virtual bool next(string& out){
+      cursor = library.appendJsonPage(cursor, WaypointLibrary::DEFAULT_PAGE,
+                                      out);
+      if(cursor.empty()){
+         call.succeeded();
+         return false;
+      }
+      return true;
+   }
+private:
+   Metrics::Call call;
+   WaypointLibrary& library;
+   string cursor;
+};
+#endif
 
 void exiting(){
    std::cout << "Server has been terminated. Exiting normally" << endl;
-   //ss.StopListening();
 }
 
 int main(int argc, char * argv[]) {
-   // invoke with ./bin/waypointsRPCServer 8080
+   // invoke with ./bin/waypointsRPCServer 8080 [--save-on-exit]
+   //            [--log-level=debug|info|warn|error|off] [--log-sample=N]
+   //            [--snapshot=waypoints.snap]
+   //            [--wal=waypoints.wal] [--checkpoint-bytes=N] [--workers=N]
+   //            [--connector=epoll|mhd|tcp|unix] [--socket=waypoints.sock]
+   //            [--framing=length|line] [--metrics-port=N]
+   //            [--geodesic=fast|sphere|ellipsoid]
+   // With --snapshot the library starts from that binary snapshot when it
+   // can be read, and --save-on-exit writes the snapshot too. With --wal
+   // every mutation is logged before it returns, the log is replayed over
+   // the snapshot at startup and compacted into it every N bytes.
+   // --workers sets how many threads batch requests are spread over, and
+   // how many serve connections on the epoll connector. The epoll
+   // connector keeps connections alive; it is the default on Linux, mhd
+   // is the libmicrohttpd server of json-rpc-cpp. tcp on the port and unix
+   // on the --socket path skip HTTP and carry framed JSON-RPC, each
+   // request prefixed by its length or on a line of its own.
+   // --metrics-port serves the Prometheus metrics on a port of its own,
+   // off unless given. On the epoll connector a POST to /import adds the
+   // waypoints of its body, a json array or one object per line, read as
+   // it arrives; see sampleCurlImport.sh. A GET of /export streams every
+   // waypoint back in the same form.
+   // --geodesic sets what distances are measured on: sphere, the haversine,
+   // is the default; ellipsoid is exact on WGS-84 and fast is a flat
+   // approximation within 2% up to 1000 km outside the polar regions.
    int port = 8080;
-   if(argc > 1){
-      port = atoi(argv[1]);
+   bool saveOnExit = false;
+   string snapshotFile;
+   string logPrefix;
+   uint64_t checkpointBytes = 64 << 20;
+   unsigned workers = 0;
+#ifdef __linux__
+   string connectorName = "epoll";
+#else
+   string connectorName = "mhd";
+#endif
+   string socketPath = "waypoints.sock";
+   FramedSocketServer::Framing framing = FramedSocketServer::LENGTH_PREFIXED;
+   Logger::Level logLevel = Logger::INFO;
+   unsigned logSample = 1;
+   int metricsPort = 0;
+   Geodesic::Precision precision = Geodesic::SPHERE;
+   for(int i = 1; i < argc; i++){
+      string arg(argv[i]);
+      if(arg == "--save-on-exit"){
+         saveOnExit = true;
+      }else if(arg.compare(0, 12, "--log-level=") == 0){
+         if(!Logger::parseLevel(arg.substr(12), logLevel)){
+            cout << "Unknown log level " << arg.substr(12) << endl;
+            return 1;
+         }
+      }else if(arg.compare(0, 13, "--log-sample=") == 0){
+         logSample = atoi(arg.substr(13).c_str());
+      }else if(arg.compare(0, 11, "--snapshot=") == 0){
+         snapshotFile = arg.substr(11);
+      }else if(arg.compare(0, 6, "--wal=") == 0){
+         logPrefix = arg.substr(6);
+      }else if(arg.compare(0, 19, "--checkpoint-bytes=") == 0){
+         checkpointBytes = strtoull(arg.substr(19).c_str(), NULL, 10);
+      }else if(arg.compare(0, 10, "--workers=") == 0){
+         workers = atoi(arg.substr(10).c_str());
+      }else if(arg.compare(0, 12, "--connector=") == 0){
+         connectorName = arg.substr(12);
+      }else if(arg.compare(0, 9, "--socket=") == 0){
+         socketPath = arg.substr(9);
+      }else if(arg.compare(0, 10, "--framing=") == 0){
+         if(!FramedSocketServer::parseFraming(arg.substr(10), framing)){
+            cout << "Unknown framing " << arg.substr(10) << endl;
+            return 1;
+         }
+      }else if(arg.compare(0, 15, "--metrics-port=") == 0){
+         metricsPort = atoi(arg.substr(15).c_str());
+      }else if(arg.compare(0, 11, "--geodesic=") == 0){
+         if(!Geodesic::parse(arg.substr(11), precision)){
+            cout << "Unknown geodesic " << arg.substr(11) << endl;
+            return 1;
+         }
+      }else{
+         port = atoi(argv[i]);
+      }
    }
-   HttpServer httpserver(port);
-   WaypointServer ws(httpserver, port);
-   std::atexit(exiting);
-   auto ex = [] (int i) {cout << "server terminating with signal " << i << endl;
-                         // ss.StopListening();
-                         exit(0);
-                         //return 0;
-                        };
+   // Block the shutdown signals before the logger and the connector start
+   // their threads, so they all inherit the mask and the signals are only
+   // ever taken by the sigwait below, where it is safe to stop the server.
+   sigset_t shutdownSignals;
+   sigemptyset(&shutdownSignals);
    // ^C
-   std::signal(SIGINT, ex);
-   // abort()
-   std::signal(SIGABRT, ex);
+   sigaddset(&shutdownSignals, SIGINT);
    // sent by kill command
-   std::signal(SIGTERM, ex);
-   // ^Z
-   std::signal(SIGTSTP, ex);
-   cout << "Waypoint Library Server listening on port " << port
-      //<< " press return/enter to quit." << endl;
-        << " use ps to get pid. To quit: kill -9 pid " << endl;
-   ws.StartListening();
-   while(true){
+   sigaddset(&shutdownSignals, SIGTERM);
+   // terminal closed
+   sigaddset(&shutdownSignals, SIGHUP);
+   pthread_sigmask(SIG_BLOCK, &shutdownSignals, NULL);
+   Logger::instance().configure(logLevel, logSample);
+   Logger::instance().start();
+
+   unique_ptr<AbstractServerConnector> connector;
+#ifdef __linux__
+   EpollHttpServer* http = NULL;
+#endif
+   if(connectorName == "mhd"){
+      connector.reset(new HttpServer(port));
+#ifdef __linux__
+   }else if(connectorName == "epoll"){
+      http = new EpollHttpServer(port, workers);
+      connector.reset(http);
+   }else if(connectorName == "tcp"){
+      connector.reset(new FramedSocketServer(port, framing, workers));
+   }else if(connectorName == "unix"){
+      connector.reset(new FramedSocketServer(socketPath, framing, workers));
+#endif
+   }else{
+      cout << "Unknown connector " << connectorName << endl;
+      Logger::instance().stop();
+      return 1;
+   }
+   if(!logPrefix.empty() && snapshotFile.empty()){
+      // the log is compacted into a snapshot, so it needs one.
+      snapshotFile = "waypoints.snap";
+   }
+   WaypointServer ws(*connector, port, snapshotFile);
+   if(!logPrefix.empty() && !ws.openLog(logPrefix, checkpointBytes)){
+      LOG_ERROR("Could not recover the log " << logPrefix);
+      Logger::instance().stop();
+      return 1;
    }
-   //int c = getchar();
+   // batches are split up before they reach the server's handler, and the
+   // hot methods are answered without it.
+   WorkerPool pool(workers);
+   TypedMethods typed(ws.getLibrary());
+   RequestDispatcher dispatcher(*connector->GetHandler(), pool, &typed);
+   connector->SetHandler(&dispatcher);
+   std::atexit(exiting);
+
+   WaypointLibrary& library = ws.getLibrary();
+   library.setPrecision(precision);
+#ifdef __linux__
+   if(http != NULL){
+      http->streamPath("/import",
+         [&library](){ return new ImportBody(library); });
+      http->sourcePath("/export", "application/x-ndjson",
+         [&library](){ return new ExportBody(library); });
+   }
+#endif
+   Metrics::instance().addReading("waypoint_library_waypoints", "gauge",
+      "Waypoints in the library.",
+      [&library](){ return (double)library.size(); });
+   Metrics::instance().addReading("waypoint_library_changes_total", "counter",
+      "Changes made to the library.",
+      [&library](){ return (double)library.revision(); });
+   Metrics::instance().addReading("process_resident_memory_bytes", "gauge",
+      "Resident memory size in bytes.", residentBytes);
+   unique_ptr<AbstractServerConnector> metrics;
+   if(metricsPort > 0){
+#ifdef __linux__
+      metrics.reset(new MetricsServer(metricsPort));
+      if(!metrics->StartListening()){
+         LOG_ERROR("Could not serve metrics on port " << metricsPort);
+         Logger::instance().stop();
+         return 1;
+      }
+      LOG_INFO("Metrics served on port " << metricsPort);
+#else
+      LOG_WARN("Metrics are only served on Linux");
+#endif
+   }
+   string where = connectorName == "unix" ? socketPath
+                                          : "port " + to_string(port);
+   LOG_INFO("Waypoint Library Server listening on " << where
+            << " use ps to get pid. To quit: kill pid ");
+   if(!ws.StartListening()){
+      LOG_ERROR("Could not listen on " << where);
+      Logger::instance().stop();
+      return 1;
+   }
+   // Sleeps until a shutdown signal arrives instead of spinning.
+   int received = 0;
+   sigwait(&shutdownSignals, &received);
+   LOG_INFO("server terminating with signal " << received);
+   // Stops accepting connections and waits for the requests in flight.
    ws.StopListening();
+   if(metrics){
+      metrics->StopListening();
+   }
+   if(saveOnExit){
+      ws.saveToJsonFile();
+      if(!snapshotFile.empty()){
+         ws.saveToSnapshot();
+      }
+   }
+   Logger::instance().stop();
    return 0;
 }
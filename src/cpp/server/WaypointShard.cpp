@@ -0,0 +1,560 @@
+#include "WaypointShard.hpp"
+#include <algorithm>
+
+#include "JsonText.hpp"
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: One partition of the waypoint library.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+const size_t WaypointShard::WALK_SHARE;
+const size_t WaypointShard::WALK_PAGE;
+
+/**
+* Builds the waypoint stored at a slot.
+*
+* @param  The slot, below size().
+* @return A copy of the waypoint.
+*/
+Waypoint WaypointShard::at(size_t slot) const{
+    return Waypoint(lat[slot], lon[slot], ele[slot], names[slot].str(),
+                    addresses[slot].str());
+}
+
+/**
+* Inserts a waypoint, replacing the one with the same name if present.
+*
+* @param The waypoint to store in the shard.
+*/
+void WaypointShard::insert(const Waypoint& aWaypoint){
+    this->emplace(aWaypoint.lat, aWaypoint.lon, aWaypoint.ele, aWaypoint.name,
+                  aWaypoint.address);
+}
+
+/**
+* Inserts a waypoint given by its fields, replacing the one with the same
+* name if present.
+*
+* @param The fields of the waypoint to store in the shard.
+*/
+void WaypointShard::emplace(double aLat, double aLon, double anEle,
+                            const string& aName, const string& anAddress){
+    auto found = index.find(StringArena::Text(aName));
+    if(found != index.end()){
+        size_t slot = found->second;
+        grid.remove(slot, lat[slot], lon[slot]);
+        lat[slot] = aLat;
+        lon[slot] = aLon;
+        ele[slot] = anEle;
+        if(addresses[slot] != StringArena::Text(anAddress)){
+            addressIndex.remove(slot, addresses);
+            StringArena::Text old = addresses[slot];
+            addresses[slot] = strings.add(anAddress);
+            addressIndex.add(slot, addresses);
+            strings.drop(old);
+            this->compactStrings();
+        }
+        json[slot].reset();
+        grid.add(slot, aLat, aLon);
+    }else{
+        size_t slot = names.size();
+        StringArena::Text name = strings.add(aName);
+        index.emplace(name, slot);
+        lat.push_back(aLat);
+        lon.push_back(aLon);
+        ele.push_back(anEle);
+        names.push_back(name);
+        addresses.push_back(strings.add(anAddress));
+        json.emplace_back();
+        namesJson.reset();
+        nameIndex.add(slot, names);
+        addressIndex.add(slot, addresses);
+        grid.add(slot, aLat, aLon);
+    }
+}
+
+/**
+* Removes the waypoint with the matching name.
+*
+* @param  The name of the waypoint that needs to be removed.
+* @return True if the waypoint was in the shard, false if not.
+*/
+bool WaypointShard::remove(const string& name){
+    auto found = index.find(StringArena::Text(name));
+    if(found == index.end()){
+        return false;
+    }
+    this->eraseAt(found->second);
+    return true;
+}
+
+/**
+* Copies out the waypoint with the matching name.
+*
+* @param  The name of the waypoint to look for.
+* @param  Where the waypoint is copied when found.
+* @return True if the waypoint was found, false if not.
+*/
+bool WaypointShard::find(const string& name, Waypoint& aWaypoint) const{
+    auto found = index.find(StringArena::Text(name));
+    if(found == index.end()){
+        return false;
+    }
+    // assigned field by field so the strings reuse the caller's capacity.
+    size_t slot = found->second;
+    aWaypoint.lat = lat[slot];
+    aWaypoint.lon = lon[slot];
+    aWaypoint.ele = ele[slot];
+    aWaypoint.name.assign(names[slot].data, names[slot].size);
+    aWaypoint.address.assign(addresses[slot].data, addresses[slot].size);
+    return true;
+}
+
+/**
+* Appends the json of the waypoint with the matching name, from the cache
+* when it was written before.
+*
+* @param  The name of the waypoint to look for.
+* @param  Where the json object is appended when found.
+* @return True if the waypoint was found, false if not.
+*/
+bool WaypointShard::appendJson(const string& name, string& out) const{
+    auto found = index.find(StringArena::Text(name));
+    if(found == index.end()){
+        return false;
+    }
+    size_t slot = found->second;
+    shared_ptr<const string> text = std::atomic_load(&json[slot]);
+    if(!text){
+        shared_ptr<string> written = make_shared<string>();
+        this->writeJson(slot, *written);
+        text = written;
+        std::atomic_store(&json[slot], text);
+    }
+    out += *text;
+    return true;
+}
+
+/**
+* Appends the json of the waypoint in a slot, from the cache when it is
+* there. It is not cached otherwise, so walking the whole shard does not
+* keep the json of every waypoint.
+*
+* @param The slot.
+* @param Where the json object is appended.
+*/
+void WaypointShard::appendJsonAt(size_t slot, string& out) const{
+    shared_ptr<const string> text = std::atomic_load(&json[slot]);
+    if(!text){
+        this->writeJson(slot, out);
+    }else{
+        out += *text;
+    }
+}
+
+void WaypointShard::writeJson(size_t slot, string& out) const{
+    // the keys in the order jsoncpp writes them.
+    out += "{\"address\":";
+    JsonText::appendQuoted(out, addresses[slot].data, addresses[slot].size);
+    out += ",\"ele\":";
+    JsonText::appendDouble(out, ele[slot]);
+    out += ",\"lat\":";
+    JsonText::appendDouble(out, lat[slot]);
+    out += ",\"lon\":";
+    JsonText::appendDouble(out, lon[slot]);
+    out += ",\"name\":";
+    JsonText::appendQuoted(out, names[slot].data, names[slot].size);
+    out += '}';
+}
+
+/**
+* Appends the names of the shard as quoted json strings separated by
+* commas, from the cache when nothing was added or removed since they
+* were last written.
+*
+* @param Where the names are appended.
+*/
+void WaypointShard::appendNamesJson(string& out) const{
+    shared_ptr<const string> text = std::atomic_load(&namesJson);
+    if(!text){
+        shared_ptr<string> written = make_shared<string>();
+        for(size_t i = 0; i < names.size(); i++){
+            if(i > 0){
+                *written += ',';
+            }
+            JsonText::appendQuoted(*written, names[i].data, names[i].size);
+        }
+        text = written;
+        std::atomic_store(&namesJson, text);
+    }
+    out += *text;
+}
+
+/**
+* Finds the slots of the waypoints that follow a name in name order.
+*
+* @param The name to start after, NULL to start from the first.
+* @param How many slots at most.
+* @param Where the slots are appended.
+*/
+void WaypointShard::slotsAfter(const StringArena::Text* after, size_t limit,
+                               vector<size_t>& out) const{
+    nameIndex.after(names, after, limit, out);
+}
+
+void WaypointShard::slotsWithPrefix(const string& prefix, size_t limit,
+                                    vector<size_t>& out) const{
+    nameIndex.withPrefix(names, prefix, limit, out);
+}
+
+void WaypointShard::slotsSimilar(const string& query, double minScore,
+                                 vector<pair<double, size_t> >& out) const{
+    nameIndex.similar(names, query, minScore, out);
+}
+
+/**
+* Looks up only the position of a waypoint, without copying strings.
+*
+* @param  The name of the waypoint to look for.
+* @param  Set to the latitude when found.
+* @param  Set to the longitude when found.
+* @return True if the waypoint was found, false if not.
+*/
+bool WaypointShard::position(const string& name, double& aLat,
+                             double& aLon) const{
+    auto found = index.find(StringArena::Text(name));
+    if(found == index.end()){
+        return false;
+    }
+    aLat = lat[found->second];
+    aLon = lon[found->second];
+    return true;
+}
+
+/**
+* Collects the waypoints within a radius of a position.
+*
+* @param Latitude of the center in degrees.
+* @param Longitude of the center in degrees.
+* @param Radius in kilometers.
+* @param The precision distances are measured at.
+* @param Where the (distance in kilometers, name) pairs are appended.
+*/
+void WaypointShard::withinRadius(double centerLat, double centerLon,
+                                 double radiusKm,
+                                 Geodesic::Precision precision,
+                                 vector<pair<double, string> >& out) const{
+    vector<pair<double, size_t> > found;
+    this->slotsWithin(centerLat, centerLon, radiusKm, precision, found);
+    for(size_t i = 0; i < found.size(); i++){
+        out.push_back(make_pair(found[i].first,
+                               names[found[i].second].str()));
+    }
+}
+
+/**
+* Collects the k waypoints of this shard closest to a position,
+* closest first. The search radius starts small and grows until it holds
+* k waypoints; anything outside that radius is farther than all of them.
+*
+* @param Latitude of the center in degrees.
+* @param Longitude of the center in degrees.
+* @param How many waypoints to return at most.
+* @param The precision distances are measured at.
+* @param Where the (distance in kilometers, name) pairs are appended.
+*/
+void WaypointShard::nearest(double centerLat, double centerLon, size_t k,
+                            Geodesic::Precision precision,
+                            vector<pair<double, string> >& out) const{
+    // half of the earth's circumference reaches every point.
+    const double farthest = Waypoint::pi * Waypoint::radiusE;
+    vector<pair<double, size_t> > found;
+    double radiusKm = 50.0;
+    while(true){
+        found.clear();
+        this->slotsWithin(centerLat, centerLon, radiusKm, precision, found);
+        if(found.size() >= k || radiusKm >= farthest){
+            break;
+        }
+        radiusKm = std::min(radiusKm * 4, farthest);
+    }
+    size_t count = std::min(k, found.size());
+    std::partial_sort(found.begin(), found.begin() + count, found.end());
+    for(size_t i = 0; i < count; i++){
+        out.push_back(make_pair(found[i].first,
+                               names[found[i].second].str()));
+    }
+}
+
+/**
+* Makes room for a number of waypoints up front, for bulk loads.
+*
+* @param How many waypoints the shard is about to hold.
+* @param How many bytes their names and addresses take, if known.
+*/
+void WaypointShard::reserve(size_t count, size_t stringBytes){
+    lat.reserve(count);
+    lon.reserve(count);
+    ele.reserve(count);
+    names.reserve(count);
+    addresses.reserve(count);
+    json.reserve(count);
+    index.reserve(count);
+    strings.reserve(stringBytes);
+}
+
+/**
+* Makes room for a number of waypoints more than the shard holds.
+*
+* @param How many waypoints are about to be added.
+*/
+void WaypointShard::grow(size_t more){
+    size_t wanted = names.size() + more;
+    if(wanted > names.capacity()){
+        this->reserve(std::max(wanted, 2 * names.capacity()));
+    }
+}
+
+/**
+* Drops every waypoint in the shard.
+*/
+void WaypointShard::clear(){
+    lat.clear();
+    lon.clear();
+    ele.clear();
+    names.clear();
+    addresses.clear();
+    json.clear();
+    namesJson.reset();
+    nameIndex.clear();
+    addressIndex.clear();
+    index.clear();
+    strings.clear();
+    grid.clear();
+}
+
+/**
+* Exchanges the waypoints of this shard with another one. The lock is
+* not exchanged.
+*
+* @param The shard to swap content with.
+*/
+void WaypointShard::swap(WaypointShard& other){
+    lat.swap(other.lat);
+    lon.swap(other.lon);
+    ele.swap(other.ele);
+    names.swap(other.names);
+    addresses.swap(other.addresses);
+    json.swap(other.json);
+    namesJson.swap(other.namesJson);
+    nameIndex.swap(other.nameIndex);
+    addressIndex.swap(other.addressIndex);
+    index.swap(other.index);
+    strings.swap(other.strings);
+    grid.swap(other.grid);
+}
+
+/**
+* Removes the waypoint at the given slot by moving the last waypoint
+* into its place, keeping the index in sync.
+*
+* @param The slot to remove.
+*/
+void WaypointShard::eraseAt(size_t slot){
+    size_t last = names.size() - 1;
+    StringArena::Text name = names[slot];
+    StringArena::Text address = addresses[slot];
+    // while names still holds both of them.
+    nameIndex.remove(slot, names);
+    addressIndex.remove(slot, addresses);
+    if(slot != last){
+        nameIndex.move(last, slot, names);
+        addressIndex.move(last, slot, addresses);
+    }
+    index.erase(name);
+    grid.remove(slot, lat[slot], lon[slot]);
+    if(slot != last){
+        lat[slot] = lat[last];
+        lon[slot] = lon[last];
+        ele[slot] = ele[last];
+        names[slot] = names[last];
+        addresses[slot] = addresses[last];
+        json[slot].swap(json[last]);
+        index[names[slot]] = slot;
+        grid.move(last, slot, lat[slot], lon[slot]);
+    }
+    lat.pop_back();
+    lon.pop_back();
+    ele.pop_back();
+    names.pop_back();
+    addresses.pop_back();
+    json.pop_back();
+    namesJson.reset();
+    // both go before compacting, which leaves neither in the arena.
+    strings.drop(name);
+    strings.drop(address);
+    this->compactStrings();
+}
+
+/**
+* Copies the live strings to a fresh arena when the dead outweigh them.
+* Every Text moves, so the index is built again; it costs as much as the
+* strings dropped since the last time, so it adds a constant to each.
+*/
+void WaypointShard::compactStrings(){
+    if(strings.deadBytes() <= strings.liveBytes() ||
+       strings.deadBytes() < StringArena::FIRST_BLOCK){
+        return;
+    }
+    StringArena packed;
+    for(size_t i = 0; i < names.size(); i++){
+        names[i] = packed.add(names[i]);
+        addresses[i] = packed.add(addresses[i]);
+    }
+    strings.swap(packed);
+    index.clear();
+    index.reserve(names.size());
+    for(size_t i = 0; i < names.size(); i++){
+        index[names[i]] = i;
+    }
+}
+
+/**
+* Finds the first slots in name order of the waypoints whose address
+* holds every one of some terms. When most names could match, the first
+* names are walked and their addresses read, giving up after WALK_SHARE
+* of the most there could be; otherwise, or after that, the lists are
+* intersected and the matches ordered.
+*
+* @param The terms, as WaypointAddressIndex::termsOf gives them.
+* @param How many slots at most.
+* @param Where the slots are appended, in name order.
+*/
+void WaypointShard::slotsWithAddress(const vector<string>& terms,
+                                     size_t limit, vector<size_t>& out) const{
+    size_t most = terms.empty() ? 0 : addressIndex.fewest(addresses, terms);
+    if(most == 0 || limit == 0){
+        return;
+    }
+    size_t start = out.size();
+    size_t budget = most / WALK_SHARE;
+    if(budget >= limit){
+        vector<size_t> slots;
+        const StringArena::Text* after = NULL;
+        for(size_t read = 0; read < budget; read += slots.size()){
+            slots.clear();
+            nameIndex.after(names, after, std::min(WALK_PAGE, budget - read),
+                            slots);
+            if(slots.empty()){
+                return;
+            }
+            for(size_t i = 0; i < slots.size(); i++){
+                if(WaypointAddressIndex::holdsAll(addresses[slots[i]],
+                                                  terms)){
+                    out.push_back(slots[i]);
+                    if(out.size() - start == limit){
+                        return;
+                    }
+                }
+            }
+            after = &names[slots.back()];
+        }
+        out.resize(start);
+    }
+    vector<size_t> matched;
+    addressIndex.matching(addresses, terms, matched);
+    auto byName = [this](size_t a, size_t b){
+        return WaypointNameIndex::compare(names[a], names[b]) < 0;
+    };
+    if(matched.size() > limit){
+        nth_element(matched.begin(), matched.begin() + limit, matched.end(),
+                    byName);
+        matched.resize(limit);
+    }
+    sort(matched.begin(), matched.end(), byName);
+    out.insert(out.end(), matched.begin(), matched.end());
+}
+
+/**
+* Finds the slots of the waypoints within a radius of a position whose
+* address holds every one of some terms. When the grid has fewer
+* candidates than the rarest term has slots, their distances are checked
+* and then the addresses of those close enough read, rather than the
+* lists.
+*
+* @param The terms, as WaypointAddressIndex::termsOf gives them.
+* @param Latitude of the center in degrees.
+* @param Longitude of the center in degrees.
+* @param Radius in kilometers.
+* @param The precision distances are measured at.
+* @param Where the (distance in kilometers, slot) pairs are appended.
+*/
+void WaypointShard::slotsWithAddressWithin(const vector<string>& terms,
+                                           double centerLat,
+                                           double centerLon,
+                                           double radiusKm,
+                                           Geodesic::Precision precision,
+                                           vector<pair<double, size_t> >& out)
+                                           const{
+    if(terms.empty()){
+        return;
+    }
+    Geodesic::Circle circle(centerLat, centerLon, radiusKm, precision);
+    vector<size_t> candidates;
+    grid.candidates(centerLat, centerLon, circle.reachKm(), candidates);
+    bool byGrid = candidates.size() < addressIndex.fewest(addresses, terms);
+    if(!byGrid){
+        candidates.clear();
+        addressIndex.matching(addresses, terms, candidates);
+    }
+    for(size_t i = 0; i < candidates.size(); i++){
+        size_t slot = candidates[i];
+        double distance = 0.0;
+        if(circle.contains(lat[slot], lon[slot], distance) &&
+           (!byGrid ||
+            WaypointAddressIndex::holdsAll(addresses[slot], terms))){
+            out.push_back(make_pair(distance, slot));
+        }
+    }
+}
+
+/**
+* Collects the slots of the waypoints within a radius of a position,
+* measured at a precision. The grid gives the cells the circle touches;
+* the candidates in them are cut down with the fast distance where its
+* error is bounded, and only the rest measured at the precision asked for.
+*/
+void WaypointShard::slotsWithin(double centerLat, double centerLon,
+                                double radiusKm,
+                                Geodesic::Precision precision,
+                                vector<pair<double, size_t> >& out) const{
+    Geodesic::Circle circle(centerLat, centerLon, radiusKm, precision);
+    vector<size_t> candidates;
+    grid.candidates(centerLat, centerLon, circle.reachKm(), candidates);
+    for(size_t i = 0; i < candidates.size(); i++){
+        size_t slot = candidates[i];
+        double distance = 0.0;
+        if(circle.contains(lat[slot], lon[slot], distance)){
+            out.push_back(make_pair(distance, candidates[i]));
+        }
+    }
+}
@@ -0,0 +1,363 @@
+#ifndef WAYPOINTSHARD_HPP
+#define WAYPOINTSHARD_HPP
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <memory>
+
+#include "Waypoint.hpp"
+#include "WaypointGrid.hpp"
+#include "Geodesic.hpp"
+#include "WaypointNameIndex.hpp"
+#include "WaypointAddressIndex.hpp"
+#include "StringArena.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: One partition of the waypoint library. Each shard owns the
+ * waypoints whose names hash to it, together with the lock guarding them,
+ * so readers of different names never contend and writers only block the
+ * shard they touch.
+ *
+ * Waypoints are stored as columns rather than as Waypoint objects: the
+ * coordinates sit in their own contiguous arrays, apart from the name and
+ * address strings, so a scan over positions only reads the 24 bytes of
+ * coordinates per waypoint. Waypoint objects are only built when one is
+ * handed out.
+ *
+ * The names and addresses are held end to end in an arena of the shard
+ * rather than in strings of their own, and the index is keyed by the
+ * same bytes as the name column, so a waypoint costs no allocation of
+ * its own but its index entry. Strings replaced or removed stay in the
+ * arena until it is more dead than live, and then the live ones are
+ * copied to a fresh arena; a reload builds new shards, packed.
+ *
+ * The methods here do no locking of their own: callers hold mutex shared
+ * for the const methods and exclusive for the others.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WaypointShard {
+
+    public:
+
+    /**
+    * An address search reads the addresses of the first names in order
+    * rather than the index while they are fewer than one WALK_SHARE-th of
+    * the addresses that could match, WALK_PAGE names at a time.
+    */
+    static const size_t WALK_SHARE = 8;
+    static const size_t WALK_PAGE = 256;
+
+    mutable shared_timed_mutex mutex;
+
+    /**
+    * The waypoint at slot i is made of the i-th entry of each column.
+    */
+    vector<double> lat;
+    vector<double> lon;
+    vector<double> ele;
+    vector<StringArena::Text> names;
+    vector<StringArena::Text> addresses;
+
+    /**
+    * Holds the bytes of names and addresses.
+    */
+    StringArena strings;
+
+    /**
+    * Maps each waypoint name to its slot, so lookups by name don't have
+    * to scan the columns. The keys are the Texts of the name column.
+    */
+    unordered_map<StringArena::Text, size_t, StringArena::Hash> index;
+
+    /**
+    * Spatial index over the positions of the waypoints.
+    */
+    WaypointGrid grid;
+
+    /**
+    * Index over the names, for prefix and similar name searches and for
+    * walking the names in order.
+    */
+    WaypointNameIndex nameIndex;
+
+    /**
+    * Inverted index over the words of the addresses.
+    */
+    WaypointAddressIndex addressIndex;
+
+    /**
+    * The json of each waypoint, as get answers it, written the first time
+    * it is asked for and dropped whenever the waypoint changes. Null until
+    * then. Readers fill it in while holding the shard shared, so an entry
+    * is only ever replaced whole, through atomic_load and atomic_store,
+    * and the text it points to is copied out without any lock; readers
+    * racing to fill the same entry write the same text.
+    */
+    mutable vector<shared_ptr<const string> > json;
+
+    /**
+    * The names of the shard as quoted json strings separated by commas,
+    * written the first time they are asked for and dropped whenever a
+    * name is added or removed. Published the same way as json.
+    */
+    mutable shared_ptr<const string> namesJson;
+
+    /**
+    * @return How many waypoints the shard holds.
+    */
+    size_t size() const { return names.size(); }
+
+    /**
+    * Builds the waypoint stored at a slot.
+    *
+    * @param  The slot, below size().
+    * @return A copy of the waypoint.
+    */
+    Waypoint at(size_t slot) const;
+
+    /**
+    * Inserts a waypoint, replacing the one with the same name if present.
+    *
+    * @param The waypoint to store in the shard.
+    */
+    void insert(const Waypoint& aWaypoint);
+
+    /**
+    * Inserts a waypoint given by its fields, replacing the one with the
+    * same name if present. The strings are copied straight into the
+    * arena.
+    *
+    * @param The fields of the waypoint to store in the shard.
+    */
+    void emplace(double aLat, double aLon, double anEle, const string& aName,
+                 const string& anAddress);
+
+    /**
+    * Removes the waypoint with the matching name.
+    *
+    * @param  The name of the waypoint that needs to be removed.
+    * @return True if the waypoint was in the shard, false if not.
+    */
+    bool remove(const string& name);
+
+    /**
+    * Copies out the waypoint with the matching name.
+    *
+    * @param  The name of the waypoint to look for.
+    * @param  Where the waypoint is copied when found.
+    * @return True if the waypoint was found, false if not.
+    */
+    bool find(const string& name, Waypoint& aWaypoint) const;
+
+    /**
+    * Appends the json of the waypoint with the matching name, from the
+    * cache when it was written before. The caller holds the shard shared.
+    *
+    * @param  The name of the waypoint to look for.
+    * @param  Where the json object is appended when found.
+    * @return True if the waypoint was found, false if not.
+    */
+    bool appendJson(const string& name, string& out) const;
+
+    /**
+    * Appends the json of the waypoint in a slot, the same as appendJson
+    * but without caching it. The caller holds the shard shared.
+    *
+    * @param The slot.
+    * @param Where the json object is appended.
+    */
+    void appendJsonAt(size_t slot, string& out) const;
+
+    /**
+    * Appends the names of the shard as quoted json strings separated by
+    * commas, from the cache when nothing was added or removed since they
+    * were last written. The caller holds the shard shared.
+    *
+    * @param Where the names are appended.
+    */
+    void appendNamesJson(string& out) const;
+
+    /**
+    * Finds the slots of the waypoints that follow a name in the order of
+    * WaypointNameIndex::compare, so the shard can be walked a page at a
+    * time while it changes. The caller holds the shard shared.
+    *
+    * @param The name to start after, NULL to start from the first.
+    * @param How many slots at most.
+    * @param Where the slots are appended, in name order.
+    */
+    void slotsAfter(const StringArena::Text* after, size_t limit,
+                    vector<size_t>& out) const;
+
+    /**
+    * Finds the slots of the names starting with a prefix, ignoring ASCII
+    * case. The caller holds the shard shared.
+    *
+    * @param The prefix.
+    * @param How many slots at most.
+    * @param Where the slots are appended, in name order.
+    */
+    void slotsWithPrefix(const string& prefix, size_t limit,
+                         vector<size_t>& out) const;
+
+    /**
+    * Finds the slots of the names that look like a query, see
+    * WaypointNameIndex::similar. The caller holds the shard shared.
+    *
+    * @param The query.
+    * @param The lowest similarity kept, between 0 and 1.
+    * @param Where (similarity, slot) pairs are appended.
+    */
+    void slotsSimilar(const string& query, double minScore,
+                      vector<pair<double, size_t> >& out) const;
+
+    /**
+    * Finds the first slots in name order of the waypoints whose address
+    * holds every one of some terms. The caller holds the shard shared.
+    *
+    * @param The terms, as WaypointAddressIndex::termsOf gives them.
+    * @param How many slots at most.
+    * @param Where the slots are appended, in name order.
+    */
+    void slotsWithAddress(const vector<string>& terms, size_t limit,
+                          vector<size_t>& out) const;
+
+    /**
+    * Finds the slots of the waypoints within a radius of a position whose
+    * address holds every one of some terms, starting from whichever of
+    * the two narrows them down most. The caller holds the shard shared.
+    *
+    * @param The terms, as WaypointAddressIndex::termsOf gives them.
+    * @param Latitude of the center in degrees.
+    * @param Longitude of the center in degrees.
+    * @param Radius in kilometers.
+    * @param The precision distances are measured at.
+    * @param Where the (distance in kilometers, slot) pairs are appended.
+    */
+    void slotsWithAddressWithin(const vector<string>& terms,
+                                double centerLat, double centerLon,
+                                double radiusKm, Geodesic::Precision precision,
+                                vector<pair<double, size_t> >& out) const;
+
+    /**
+    * Looks up only the position of a waypoint, without copying strings.
+    *
+    * @param  The name of the waypoint to look for.
+    * @param  Set to the latitude when found.
+    * @param  Set to the longitude when found.
+    * @return True if the waypoint was found, false if not.
+    */
+    bool position(const string& name, double& aLat, double& aLon) const;
+
+    /**
+    * Collects the waypoints within a radius of a position.
+    *
+    * @param Latitude of the center in degrees.
+    * @param Longitude of the center in degrees.
+    * @param Radius in kilometers.
+    * @param The precision distances are measured at.
+    * @param Where the (distance in kilometers, name) pairs are appended.
+    */
+    void withinRadius(double centerLat, double centerLon, double radiusKm,
+                      Geodesic::Precision precision,
+                      vector<pair<double, string> >& out) const;
+
+    /**
+    * Collects the k waypoints of this shard closest to a position,
+    * closest first.
+    *
+    * @param Latitude of the center in degrees.
+    * @param Longitude of the center in degrees.
+    * @param How many waypoints to return at most.
+    * @param The precision distances are measured at.
+    * @param Where the (distance in kilometers, name) pairs are appended.
+    */
+    void nearest(double centerLat, double centerLon, size_t k,
+                 Geodesic::Precision precision,
+                 vector<pair<double, string> >& out) const;
+
+    /**
+    * Makes room for a number of waypoints up front, for bulk loads.
+    *
+    * @param How many waypoints the shard is about to hold.
+    * @param How many bytes their names and addresses take, if known.
+    */
+    void reserve(size_t count, size_t stringBytes = 0);
+
+    /**
+    * Makes room for a number of waypoints more than the shard holds, at
+    * least doubling what it has room for when it has to grow, so adding
+    * batch after batch stays linear.
+    *
+    * @param How many waypoints are about to be added.
+    */
+    void grow(size_t more);
+
+    /**
+    * Drops every waypoint in the shard.
+    */
+    void clear();
+
+    /**
+    * Exchanges the waypoints of this shard with another one. The lock is
+    * not exchanged.
+    *
+    * @param The shard to swap content with.
+    */
+    void swap(WaypointShard& other);
+
+    private:
+
+    /**
+    * Removes the waypoint at the given slot by moving the last waypoint
+    * into its place, keeping the index in sync.
+    *
+    * @param The slot to remove.
+    */
+    void eraseAt(size_t slot);
+
+    /**
+    * Writes the json of the waypoint in a slot.
+    */
+    void writeJson(size_t slot, string& out) const;
+
+    /**
+    * Copies the live strings to a fresh arena when the dead outweigh them.
+    * Called once the strings of a change are all dropped, as every Text
+    * of the old arena is stale after.
+    */
+    void compactStrings();
+
+    /**
+    * Collects the slots of the waypoints within a radius of a position,
+    * measured at a precision.
+    */
+    void slotsWithin(double centerLat, double centerLon, double radiusKm,
+                     Geodesic::Precision precision,
+                     vector<pair<double, size_t> >& out) const;
+};
+
+#endif
@@ -0,0 +1,301 @@
+#include "WaypointSnapshot.hpp"
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Binary snapshot of the waypoint library.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+static const char MAGIC[8] = { 'W', 'A', 'Y', 'P', 'O', 'I', 'N', 'T' };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+static const size_t HEADER_SIZE = 40;
+static const size_t ENTRY_SIZE = 32;
+// where the header crc sits, it is zero while the crc is computed.
+static const size_t CRC_AT = 20;
+
+static void put32(string& out, size_t at, uint32_t value){
+    memcpy(&out[at], &value, sizeof(value));
+}
+
+static void put64(string& out, size_t at, uint64_t value){
+    memcpy(&out[at], &value, sizeof(value));
+}
+
+static uint32_t get32(const char* p){
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t get64(const char* p){
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void putColumn(string& out, const vector<double>& column){
+    if(!column.empty()){
+        out.append((const char*)&column[0], column.size() * sizeof(double));
+    }
+}
+
+uint32_t WaypointSnapshot::crc32(const void* data, size_t length,
+                                 uint32_t crc){
+    static uint32_t table[256];
+    static bool built = [](){
+        for(uint32_t i = 0; i < 256; i++){
+            uint32_t c = i;
+            for(int k = 0; k < 8; k++){
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)built;
+    const unsigned char* p = (const unsigned char*)data;
+    crc = ~crc;
+    for(size_t i = 0; i < length; i++){
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void WaypointSnapshot::encode(const WaypointShard* shards, size_t count,
+                              uint64_t generation, string& out){
+    out.assign(HEADER_SIZE + ENTRY_SIZE * count, '\0');
+    uint64_t total = 0;
+    for(size_t s = 0; s < count; s++){
+        const WaypointShard& shard = shards[s];
+        size_t n = shard.size();
+        // sections start 8 byte aligned so the columns are aligned too.
+        out.append((8 - out.size() % 8) % 8, '\0');
+        size_t begin = out.size();
+        putColumn(out, shard.lat);
+        putColumn(out, shard.lon);
+        putColumn(out, shard.ele);
+        size_t offsets = out.size();
+        out.append((2 * n + 1) * sizeof(uint64_t), '\0');
+        size_t strings = out.size();
+        for(size_t i = 0; i < n; i++){
+            put64(out, offsets + 16 * i, out.size() - strings);
+            out.append(shard.names[i].data, shard.names[i].size);
+            put64(out, offsets + 16 * i + 8, out.size() - strings);
+            out.append(shard.addresses[i].data, shard.addresses[i].size);
+        }
+        put64(out, offsets + 16 * n, out.size() - strings);
+
+        size_t entry = HEADER_SIZE + ENTRY_SIZE * s;
+        put64(out, entry, begin);
+        put64(out, entry + 8, n);
+        put64(out, entry + 16, out.size() - begin);
+        put32(out, entry + 24, crc32(&out[begin], out.size() - begin));
+        total += n;
+    }
+    memcpy(&out[0], MAGIC, sizeof(MAGIC));
+    put32(out, 8, VERSION);
+    put32(out, 12, BYTE_ORDER_MARK);
+    put32(out, 16, count);
+    put64(out, 24, total);
+    put64(out, 32, generation);
+    put32(out, CRC_AT, crc32(&out[0], HEADER_SIZE + ENTRY_SIZE * count));
+}
+
+bool WaypointSnapshot::writeFile(const string& fileName, const string& bytes,
+                                 string& error){
+    string temporary = fileName + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        error = "cannot create " + temporary + ": " + strerror(errno);
+        return false;
+    }
+    size_t written = 0;
+    while(written < bytes.size()){
+        ssize_t n = write(fd, bytes.data() + written, bytes.size() - written);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            error = "cannot write " + temporary + ": " + strerror(errno);
+            close(fd);
+            unlink(temporary.c_str());
+            return false;
+        }
+        written += n;
+    }
+    if(fsync(fd) != 0){
+        error = "cannot sync " + temporary + ": " + strerror(errno);
+        close(fd);
+        unlink(temporary.c_str());
+        return false;
+    }
+    close(fd);
+    if(rename(temporary.c_str(), fileName.c_str()) != 0){
+        error = "cannot rename " + temporary + ": " + strerror(errno);
+        unlink(temporary.c_str());
+        return false;
+    }
+    // the rename itself is only durable once the directory is synced.
+    vector<char> path(fileName.begin(), fileName.end());
+    path.push_back('\0');
+    int dir = open(dirname(&path[0]), O_RDONLY);
+    if(dir >= 0){
+        fsync(dir);
+        close(dir);
+    }
+    return true;
+}
+
+WaypointSnapshot::WaypointSnapshot(const string& fileName)
+    : data(NULL), size(0), valid(false), logGeneration(0){
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0){
+        message = "cannot open " + fileName;
+        return;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < (off_t)HEADER_SIZE){
+        message = fileName + " is not a snapshot";
+        close(fd);
+        return;
+    }
+    size = info.st_size;
+    void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the descriptor is closed.
+    close(fd);
+    if(mapped == MAP_FAILED){
+        message = "cannot map " + fileName;
+        size = 0;
+        return;
+    }
+    data = (const char*)mapped;
+    madvise(mapped, size, MADV_WILLNEED);
+    valid = this->readHeader();
+    if(!valid){
+        message = fileName + ": " + message;
+    }
+}
+
+WaypointSnapshot::~WaypointSnapshot(){
+    if(data != NULL){
+        munmap((void*)data, size);
+    }
+}
+
+/**
+* Checks the header and directory and loads the directory.
+*/
+bool WaypointSnapshot::readHeader(){
+    if(memcmp(data, MAGIC, sizeof(MAGIC)) != 0){
+        message = "not a snapshot";
+        return false;
+    }
+    if(get32(data + 12) != BYTE_ORDER_MARK){
+        message = "snapshot written with another byte order";
+        return false;
+    }
+    if(get32(data + 8) != VERSION){
+        message = "unsupported snapshot version";
+        return false;
+    }
+    uint64_t count = get32(data + 16);
+    if(count > (size - HEADER_SIZE) / ENTRY_SIZE){
+        message = "truncated directory";
+        return false;
+    }
+    string header(data, HEADER_SIZE + ENTRY_SIZE * count);
+    put32(header, CRC_AT, 0);
+    if(crc32(header.data(), header.size()) != get32(data + CRC_AT)){
+        message = "header checksum mismatch";
+        return false;
+    }
+    logGeneration = get64(data + 32);
+    directory.resize(count);
+    for(size_t s = 0; s < count; s++){
+        const char* p = data + HEADER_SIZE + ENTRY_SIZE * s;
+        Entry& entry = directory[s];
+        entry.offset = get64(p);
+        entry.count = get64(p + 8);
+        entry.length = get64(p + 16);
+        entry.crc = get32(p + 24);
+        // every waypoint takes three doubles and two string offsets.
+        if(entry.offset > size || entry.length > size - entry.offset ||
+           entry.length < 8 || entry.count > (entry.length - 8) / 40){
+            stringstream error;
+            error << "section " << s << " out of bounds";
+            message = error.str();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WaypointSnapshot::check(size_t section) const{
+    const Entry& entry = directory[section];
+    const char* begin = data + entry.offset;
+    if(crc32(begin, entry.length) != entry.crc){
+        return false;
+    }
+    const char* offsets = begin + 24 * entry.count;
+    uint64_t strings = entry.length - 24 * entry.count -
+                       8 * (2 * entry.count + 1);
+    uint64_t previous = 0;
+    for(size_t i = 0; i <= 2 * entry.count; i++){
+        uint64_t at = get64(offsets + 8 * i);
+        if(at < previous || at > strings){
+            return false;
+        }
+        previous = at;
+    }
+    return true;
+}
+
+void WaypointSnapshot::record(size_t section, size_t i, Record& out) const{
+    const Entry& entry = directory[section];
+    size_t n = entry.count;
+    const char* begin = data + entry.offset;
+    memcpy(&out.lat, begin + 8 * i, sizeof(double));
+    memcpy(&out.lon, begin + 8 * (n + i), sizeof(double));
+    memcpy(&out.ele, begin + 8 * (2 * n + i), sizeof(double));
+    const char* offsets = begin + 24 * n;
+    const char* strings = offsets + 8 * (2 * n + 1);
+    uint64_t name = get64(offsets + 16 * i);
+    uint64_t address = get64(offsets + 16 * i + 8);
+    uint64_t next = get64(offsets + 16 * i + 16);
+    out.name = strings + name;
+    out.nameLength = address - name;
+    out.address = strings + address;
+    out.addressLength = next - address;
+}
+
+size_t WaypointSnapshot::stringBytes(size_t section) const{
+    const Entry& entry = directory[section];
+    size_t n = entry.count;
+    return get64(data + entry.offset + 24 * n + 16 * n);
+}
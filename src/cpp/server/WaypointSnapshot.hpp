@@ -0,0 +1,172 @@
+#ifndef WAYPOINTSNAPSHOT_HPP
+#define WAYPOINTSNAPSHOT_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "WaypointShard.hpp"
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Binary snapshot of the waypoint library. The file holds one
+ * section per shard, laid out the way the shards keep their waypoints:
+ * fixed width lat, lon and ele columns followed by a string table with
+ * the names and addresses. Reading it back is a matter of copying
+ * columns out of the mapped file; there is nothing to parse.
+ *
+ * Layout, in host byte order:
+ *   header     magic "WAYPOINT", version, byte order mark, section count,
+ *              crc32 of the header and directory, waypoint count, and
+ *              the first write-ahead log generation not included
+ *   directory  per section: offset, waypoint count, length, crc32
+ *   sections   lat[n], lon[n], ele[n] doubles, then 2n+1 string offsets
+ *              into the string bytes, name i at 2i and address i at 2i+1
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WaypointSnapshot {
+
+    public:
+
+    static const uint32_t VERSION = 1;
+
+    /**
+    * One waypoint as stored in the file. The strings point into the
+    * mapping and are not zero terminated.
+    */
+    struct Record {
+        double lat;
+        double lon;
+        double ele;
+        const char* name;
+        size_t nameLength;
+        const char* address;
+        size_t addressLength;
+    };
+
+    /**
+    * Serializes shards into the snapshot format. The caller holds every
+    * shard's lock, at least shared.
+    *
+    * @param The shards.
+    * @param How many shards there are.
+    * @param The first log generation written after the snapshot.
+    * @param Set to the bytes of the snapshot.
+    */
+    static void encode(const WaypointShard* shards, size_t count,
+                       uint64_t generation, string& out);
+
+    /**
+    * Replaces a file so that a crash leaves either the old or the new
+    * content: the bytes go to a temporary file which is synced and then
+    * renamed over the old one.
+    *
+    * @param  The file to replace.
+    * @param  The new content.
+    * @param  Set to what went wrong when the write fails.
+    * @return True if the file was replaced, false if not.
+    */
+    static bool writeFile(const string& fileName, const string& bytes,
+                          string& error);
+
+    /**
+    * Standard crc32, as used by zip and ethernet.
+    *
+    * @param  The bytes to checksum.
+    * @param  How many bytes.
+    * @param  The crc of the bytes before these, to checksum in pieces.
+    * @return The crc of everything so far.
+    */
+    static uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+
+    /**
+    * Maps a snapshot file and checks its header. Check isOpen() before
+    * reading sections.
+    *
+    * @param The name of the snapshot file.
+    */
+    WaypointSnapshot(const string& fileName);
+    ~WaypointSnapshot();
+
+    bool isOpen() const { return valid; }
+
+    /**
+    * @return What went wrong opening or checking the file.
+    */
+    const string& error() const { return message; }
+
+    size_t sections() const { return directory.size(); }
+
+    /**
+    * @return The first log generation to replay over the snapshot.
+    */
+    uint64_t generation() const { return logGeneration; }
+
+    size_t count(size_t section) const { return directory[section].count; }
+
+    /**
+    * Checks the crc and string offsets of a section. Sections are checked
+    * separately so they can be checked in parallel.
+    *
+    * @param  The section.
+    * @return True if the section is intact, false if not.
+    */
+    bool check(size_t section) const;
+
+    /**
+    * Reads one waypoint of a section that passed check().
+    *
+    * @param The section.
+    * @param The waypoint, below count(section).
+    * @param Set to the waypoint.
+    */
+    void record(size_t section, size_t i, Record& out) const;
+
+    /**
+    * @param  A section that passed check().
+    * @return How many bytes the names and addresses of the section take.
+    */
+    size_t stringBytes(size_t section) const;
+
+    private:
+
+    struct Entry {
+        uint64_t offset;
+        uint64_t count;
+        uint64_t length;
+        uint32_t crc;
+    };
+
+    const char* data;
+    size_t size;
+    bool valid;
+    uint64_t logGeneration;
+    string message;
+    vector<Entry> directory;
+
+    WaypointSnapshot(const WaypointSnapshot&) = delete;
+    WaypointSnapshot& operator=(const WaypointSnapshot&) = delete;
+
+    bool readHeader();
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "WorkerPool.hpp"
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Fixed set of threads that run queued tasks.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+
+WorkerPool::WorkerPool(unsigned threads) : stopping(false){
+    if(threads == 0){
+        threads = std::max(1u, thread::hardware_concurrency());
+    }
+    for(unsigned i = 0; i < threads; i++){
+        workers.push_back(thread(&WorkerPool::run, this));
+    }
+}
+
+WorkerPool::~WorkerPool(){
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(size_t i = 0; i < workers.size(); i++){
+        workers[i].join();
+    }
+}
+
+void WorkerPool::run(){
+    unique_lock<mutex> guard(lock);
+    while(true){
+        wake.wait(guard, [this](){ return stopping || !tasks.empty(); });
+        if(tasks.empty()){
+            return;
+        }
+        function<void()> task = std::move(tasks.front());
+        tasks.pop_front();
+        guard.unlock();
+        task();
+        guard.lock();
+    }
+}
+
+void WorkerPool::submit(function<void()> task){
+    {
+        lock_guard<mutex> guard(lock);
+        tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+/**
+* Indexes are handed out from a shared counter. A helper that only gets to
+* run after the caller has returned finds the counter exhausted and never
+* touches the body, which is why the state is shared and the body is not.
+*/
+void WorkerPool::parallelFor(size_t count,
+                             const function<void(size_t)>& body){
+    struct State {
+        atomic<size_t> next;
+        size_t count;
+        const function<void(size_t)>* body;
+        mutex lock;
+        condition_variable finished;
+        size_t done;
+    };
+    shared_ptr<State> state = make_shared<State>();
+    state->next = 0;
+    state->count = count;
+    state->body = &body;
+    state->done = 0;
+
+    auto work = [state](){
+        size_t ran = 0;
+        size_t i;
+        while((i = state->next.fetch_add(1)) < state->count){
+            (*state->body)(i);
+            ran++;
+        }
+        if(ran > 0){
+            lock_guard<mutex> guard(state->lock);
+            state->done += ran;
+            if(state->done == state->count){
+                state->finished.notify_one();
+            }
+        }
+    };
+    size_t helpers = std::min(count > 0 ? count - 1 : 0, workers.size());
+    for(size_t h = 0; h < helpers; h++){
+        this->submit(work);
+    }
+    work();
+    unique_lock<mutex> guard(state->lock);
+    state->finished.wait(guard, [&](){ return state->done == state->count; });
+}
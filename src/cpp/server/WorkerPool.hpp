@@ -0,0 +1,86 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+/**
+ * Copyright 2018 Jean Torres,
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Purpose: Fixed set of threads that run queued tasks, started once
+ * instead of a thread per job.
+ *
+ * Ser321 Foundations of Distributed Applications
+ * see http://pooh.poly.asu.edu/Ser321
+ * @author Jean Torres jctorre8@asu.edu
+ * @version February 2018
+ */
+class WorkerPool {
+
+    public:
+
+    /**
+    * Starts the threads.
+    *
+    * @param How many threads, 0 for one per cpu.
+    */
+    WorkerPool(unsigned threads);
+
+    /**
+    * Runs whatever is still queued and stops the threads.
+    */
+    ~WorkerPool();
+
+    unsigned size() const { return workers.size(); }
+
+    /**
+    * Queues a task for one of the threads.
+    *
+    * @param The task.
+    */
+    void submit(function<void()> task);
+
+    /**
+    * Calls body(i) for every i below count, spread over the pool, and
+    * returns once all calls are done. The calling thread takes its share
+    * of the work, so this finishes even when every pool thread is busy,
+    * including when it is called from a pool thread.
+    *
+    * @param How many calls.
+    * @param The work for one index.
+    */
+    void parallelFor(size_t count, const function<void(size_t)>& body);
+
+    private:
+
+    vector<thread> workers;
+    deque<function<void()> > tasks;
+    mutex lock;
+    condition_variable wake;
+    bool stopping;
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void run();
+};
+
+#endif
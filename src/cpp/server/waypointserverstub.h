@@ -21,6 +21,18 @@ class waypointserverstub : public jsonrpc::AbstractServer<waypointserverstub>
             this->bindAndAddMethod(jsonrpc::Procedure("distanceAndBearing", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_STRING, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_STRING, NULL), &waypointserverstub::distanceAndBearingI);
             this->bindAndAddMethod(jsonrpc::Procedure("updateWaypoint", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_BOOLEAN, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_STRING,"param3",jsonrpc::JSON_STRING,"param4",jsonrpc::JSON_STRING,"param5",jsonrpc::JSON_STRING, NULL), &waypointserverstub::updateWaypointI);
             this->bindAndAddMethod(jsonrpc::Procedure("addNew", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_BOOLEAN, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_STRING,"param3",jsonrpc::JSON_STRING,"param4",jsonrpc::JSON_STRING,"param5",jsonrpc::JSON_STRING, NULL), &waypointserverstub::addNewI);
+            this->bindAndAddMethod(jsonrpc::Procedure("nearest", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_ARRAY, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_INTEGER, NULL), &waypointserverstub::nearestI);
+            this->bindAndAddMethod(jsonrpc::Procedure("nearestTo", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_ARRAY, "param1",jsonrpc::JSON_REAL,"param2",jsonrpc::JSON_REAL,"param3",jsonrpc::JSON_INTEGER, NULL), &waypointserverstub::nearestToI);
+            this->bindAndAddMethod(jsonrpc::Procedure("withinRadius", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_ARRAY, "param1",jsonrpc::JSON_REAL,"param2",jsonrpc::JSON_REAL,"param3",jsonrpc::JSON_REAL,"param4",jsonrpc::JSON_INTEGER, NULL), &waypointserverstub::withinRadiusI);
+            this->bindAndAddMethod(jsonrpc::Procedure("distanceMatrix", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_ARRAY, "param1",jsonrpc::JSON_ARRAY,"param2",jsonrpc::JSON_INTEGER, NULL), &waypointserverstub::distanceMatrixI);
+            this->bindAndAddMethod(jsonrpc::Procedure("getNamesPage", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_OBJECT, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_INTEGER, NULL), &waypointserverstub::getNamesPageI);
+            this->bindAndAddMethod(jsonrpc::Procedure("listWaypoints", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_OBJECT, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_INTEGER,"param3",jsonrpc::JSON_ARRAY, NULL), &waypointserverstub::listWaypointsI);
+            this->bindAndAddMethod(jsonrpc::Procedure("searchNames", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_ARRAY, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_INTEGER, NULL), &waypointserverstub::searchNamesI);
+            this->bindAndAddMethod(jsonrpc::Procedure("searchAddress", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_ARRAY, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_INTEGER, NULL), &waypointserverstub::searchAddressI);
+            this->bindAndAddMethod(jsonrpc::Procedure("searchAddressWithin", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_ARRAY, "param1",jsonrpc::JSON_STRING,"param2",jsonrpc::JSON_REAL,"param3",jsonrpc::JSON_REAL,"param4",jsonrpc::JSON_REAL,"param5",jsonrpc::JSON_INTEGER,"param6",jsonrpc::JSON_INTEGER, NULL), &waypointserverstub::searchAddressWithinI);
+            this->bindAndAddMethod(jsonrpc::Procedure("addMany", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_OBJECT, "param1",jsonrpc::JSON_ARRAY, NULL), &waypointserverstub::addManyI);
+            this->bindAndAddMethod(jsonrpc::Procedure("saveToSnapshot", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_BOOLEAN,  NULL), &waypointserverstub::saveToSnapshotI);
+            this->bindAndAddMethod(jsonrpc::Procedure("resetFromSnapshot", jsonrpc::PARAMS_BY_POSITION, jsonrpc::JSON_BOOLEAN,  NULL), &waypointserverstub::resetFromSnapshotI);
         }
 
         inline virtual void saveToJsonFileI(const Json::Value &request, Json::Value &response)
@@ -62,6 +74,56 @@ class waypointserverstub : public jsonrpc::AbstractServer<waypointserverstub>
         {
             response = this->addNew(request[0u].asString(), request[1u].asString(), request[2u].asString(), request[3u].asString(), request[4u].asString());
         }
+        inline virtual void nearestI(const Json::Value &request, Json::Value &response)
+        {
+            response = this->nearest(request[0u].asString(), request[1u].asInt());
+        }
+        inline virtual void nearestToI(const Json::Value &request, Json::Value &response)
+        {
+            response = this->nearestTo(request[0u].asDouble(), request[1u].asDouble(), request[2u].asInt());
+        }
+        inline virtual void withinRadiusI(const Json::Value &request, Json::Value &response)
+        {
+            response = this->withinRadius(request[0u].asDouble(), request[1u].asDouble(), request[2u].asDouble(), request[3u].asInt());
+        }
+        inline virtual void distanceMatrixI(const Json::Value &request, Json::Value &response)
+        {
+            response = this->distanceMatrix(request[0u], request[1u].asInt());
+        }
+        inline virtual void getNamesPageI(const Json::Value &request, Json::Value &response)
+        {
+            response = this->getNamesPage(request[0u].asString(), request[1u].asInt());
+        }
+        inline virtual void listWaypointsI(const Json::Value &request, Json::Value &response)
+        {
+            response = this->listWaypoints(request[0u].asString(), request[1u].asInt(), request[2u]);
+        }
+        inline virtual void searchNamesI(const Json::Value &request, Json::Value &response)
+        {
+            response = this->searchNames(request[0u].asString(), request[1u].asInt());
+        }
+        inline virtual void searchAddressI(const Json::Value &request, Json::Value &response)
+        {
+            response = this->searchAddress(request[0u].asString(), request[1u].asInt());
+        }
+        inline virtual void searchAddressWithinI(const Json::Value &request, Json::Value &response)
+        {
+            response = this->searchAddressWithin(request[0u].asString(), request[1u].asDouble(), request[2u].asDouble(), request[3u].asDouble(), request[4u].asInt(), request[5u].asInt());
+        }
+        inline virtual void addManyI(const Json::Value &request, Json::Value &response)
+        {
+            response = this->addMany(request[0u]);
+        }
+        inline virtual void saveToSnapshotI(const Json::Value &request, Json::Value &response)
+        {
+            (void)request;
+            response = this->saveToSnapshot();
+        }
+        inline virtual void resetFromSnapshotI(const Json::Value &request, Json::Value &response)
+        {
+            (void)request;
+            response = this->resetFromSnapshot();
+        }
         virtual bool saveToJsonFile() = 0;
         virtual bool resetFromJsonFile() = 0;
         virtual bool add(const Json::Value& param1) = 0;
@@ -71,6 +133,18 @@ class waypointserverstub : public jsonrpc::AbstractServer<waypointserverstub>
         virtual std::string distanceAndBearing(const std::string& param1, const std::string& param2) = 0;
         virtual bool updateWaypoint(const std::string& param1, const std::string& param2, const std::string& param3, const std::string& param4, const std::string& param5) = 0;
         virtual bool addNew(const std::string& param1, const std::string& param2, const std::string& param3, const std::string& param4, const std::string& param5) = 0;
+        virtual Json::Value nearest(const std::string& param1, int param2) = 0;
+        virtual Json::Value nearestTo(double param1, double param2, int param3) = 0;
+        virtual Json::Value withinRadius(double param1, double param2, double param3, int param4) = 0;
+        virtual Json::Value distanceMatrix(const Json::Value& param1, int param2) = 0;
+        virtual Json::Value getNamesPage(const std::string& param1, int param2) = 0;
+        virtual Json::Value listWaypoints(const std::string& param1, int param2, const Json::Value& param3) = 0;
+        virtual Json::Value searchNames(const std::string& param1, int param2) = 0;
+        virtual Json::Value searchAddress(const std::string& param1, int param2) = 0;
+        virtual Json::Value searchAddressWithin(const std::string& param1, double param2, double param3, double param4, int param5, int param6) = 0;
+        virtual Json::Value addMany(const Json::Value& param1) = 0;
+        virtual bool saveToSnapshot() = 0;
+        virtual bool resetFromSnapshot() = 0;
 };
 
 #endif //JSONRPC_CPP_STUB_WAYPOINTSERVERSTUB_H_
@@ -14,6 +14,7 @@ import java.util.*;
 import java.text.NumberFormat;
 import java.net.HttpURLConnection;
 import java.net.URL;
+import java.net.URI;
 
 /**
  * Copyright (c) 2018 Tim Lindquist,
@@ -79,7 +80,14 @@ public class WaypointClient extends WaypointGUI implements
       nf.setMaximumFractionDigits(2);
       try{
          System.out.println("Opening connection to: "+url);
-         this.waypoints = new WaypointLibraryHttpProxy(new URL(url));
+         if(url.startsWith("tcp://")){
+            // framed json-rpc, the server runs with --connector=tcp
+            URI uri = new URI(url);
+            this.waypoints = new WaypointLibraryHttpProxy(uri.getHost(),
+                                                          uri.getPort());
+         }else{
+            this.waypoints = new WaypointLibraryHttpProxy(new URL(url));
+         }
       }catch (Exception e) {
          e.printStackTrace();
          System.out.println("Oops, you didn't enter the right stuff");
@@ -153,11 +161,15 @@ public class WaypointClient extends WaypointGUI implements
       String name = "Ser321";
       
       try {
+         String scheme = "http";
          if(args.length >= 2){
             host = args[0];
             port = args[1];
          }
-         String url = "http://"+host+":"+port+"/";         
+         if(args.length >= 3 && args[2].equals("tcp")){
+            scheme = "tcp";
+         }
+         String url = scheme+"://"+host+":"+port+"/";         
          WaypointClient sa2 = new WaypointClient(name, url);
       }catch (Exception ex){
          ex.printStackTrace();
@@ -16,6 +16,11 @@ import java.io.BufferedInputStream;
 import java.io.ByteArrayOutputStream;
 import java.io.InputStream;
 import java.io.OutputStream;
+import java.io.DataInputStream;
+import java.io.DataOutputStream;
+import java.io.BufferedOutputStream;
+import java.nio.charset.StandardCharsets;
+import java.net.Socket;
 import org.json.JSONString;
 import org.json.JSONObject;
 import org.json.JSONTokener;
@@ -54,6 +59,11 @@ public class WaypointLibraryHttpProxy  extends Object implements JSONString, Ser
     private URL url;
     private String requestData;
     private static int callid =0;
+    private String host;
+    private int port;
+    private Socket socket;
+    private DataInputStream socketIn;
+    private DataOutputStream socketOut;
 
     /**
     * No parameter constructor. Just creates an empty Vector.
@@ -63,6 +73,20 @@ public class WaypointLibraryHttpProxy  extends Object implements JSONString, Ser
       this.headers = new HashMap<String, String>();
     }
 
+    /**
+    * Talks to a server started with --connector=tcp instead of HTTP. Each
+    * request and reply is framed by its length, 4 bytes big endian, over
+    * one connection kept open between calls.
+    *
+    * @param The host of the server.
+    * @param The port of the server.
+    */
+    public WaypointLibraryHttpProxy(String host, int port) {
+      this.host = host;
+      this.port = port;
+      this.headers = new HashMap<String, String>();
+    }
+
     private JSONObject buildCall(String method){
       JSONObject jobj = new JSONObject("{\"jsonrpc\":\"2.0\",\"method\":\""+method+"\",\"id\":"+callid+"}");
       return jobj;
@@ -175,6 +199,51 @@ public class WaypointLibraryHttpProxy  extends Object implements JSONString, Ser
       return ret;
     }
 
+    /**
+    * Gets several waypoints with a single JSON-RPC batch request, one
+    * round trip instead of one per name.
+    * 
+    * @param  The names of the waypoints that need to be returned.
+    * @return The waypoints, in the order of the names. A name that could
+    *         not be fetched gets an "unknown" waypoint, as get does.
+    */
+    public Waypoint[] getMany(String[] names){
+        Waypoint[] ret = new Waypoint[names.length];
+        for(int i=0; i<names.length; i++){
+            ret[i] = new Waypoint(0,0,0,"unknown","unknown");
+        }
+        if(names.length == 0){
+            return ret;
+        }
+        try{
+            JSONArray batch = new JSONArray();
+            for(int i=0; i<names.length; i++){
+                JSONObject jobj = new JSONObject();
+                jobj.put("jsonrpc","2.0");
+                jobj.put("method","get");
+                jobj.put("id",i);
+                JSONArray params = new JSONArray();
+                params.put(names[i]);
+                jobj.put("params",params);
+                batch.put(jobj);
+            }
+            String response = this.call(batch.toString());
+            debug("getMany returned: "+response);
+            JSONArray replies = new JSONArray(response);
+            // replies may come back in any order, the id says which is which.
+            for(int i=0; i<replies.length(); i++){
+                JSONObject respObj = replies.getJSONObject(i);
+                int id = respObj.optInt("id", -1);
+                if(!respObj.has("error") && id >= 0 && id < names.length){
+                    ret[id] = new Waypoint(respObj.getJSONObject("result"));
+                }
+            }
+        }catch(Exception ex){
+            System.out.println("exception in getMany error: "+ex.getMessage());
+        }
+        return ret;
+    }
+
     /**
     * Imports the waypoints from JSON file.
     * 
@@ -286,11 +355,39 @@ public class WaypointLibraryHttpProxy  extends Object implements JSONString, Ser
     }
 
     public String call(String requestData) throws Exception {
+        if(url == null){
+            debug("in call, tcp: "+host+":"+port+" requestData: "+requestData);
+            return frame(requestData);
+        }
         debug("in call, url: "+url.toString()+" requestData: "+requestData);
         String respData = post(url, headers, requestData);
         return respData;
     }
 
+    private synchronized String frame(String data) throws Exception {
+        if(socket == null){
+            socket = new Socket(host, port);
+            socket.setTcpNoDelay(true);
+            socketIn = new DataInputStream(socket.getInputStream());
+            socketOut = new DataOutputStream(
+                new BufferedOutputStream(socket.getOutputStream()));
+        }
+        try{
+            byte[] request = data.getBytes(StandardCharsets.UTF_8);
+            socketOut.writeInt(request.length);
+            socketOut.write(request);
+            socketOut.flush();
+            byte[] response = new byte[socketIn.readInt()];
+            socketIn.readFully(response);
+            return new String(response, StandardCharsets.UTF_8);
+        }catch(Exception ex){
+            // opened again on the next call.
+            socket.close();
+            socket = null;
+            throw ex;
+        }
+    }
+
     private String post(URL url, Map<String, String> headers, String data) throws Exception {
         HttpURLConnection connection = (HttpURLConnection) url.openConnection();
         this.requestData = data;